@@ -63,12 +63,14 @@ class Matcher:
         if self._matcher:
             raise MatcherError("Matcher is already initialized.")
         if isinstance(keywords, list) or isinstance(keywords, set):
-            # for utf-8 '\n' is 0x0a, in other words, utf-8 is ascii compatible.
-            # but in python3, str.join is only accept str as argument
-            keywords = "\n".join([convert2pass(keyword) for keyword in keywords if convert2pass(keyword)])
+            # keywords are passed to native without join, every item is split in place
+            keywords = [convert2pass(keyword) for keyword in keywords if convert2pass(keyword)]
         else:
             raise MatcherError("Keywords should be list or set.")
-        return self.load_from_string(keywords, all_as_plain, ignore_bad_pattern, bad_as_plain, deduplicate_extra)
+        self._matcher = _actrie.ConstructByArray(
+            keywords, all_as_plain, ignore_bad_pattern, bad_as_plain, deduplicate_extra
+        )
+        return self._matcher != 0
 
     @classmethod
     def create_by_collection(
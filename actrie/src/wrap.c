@@ -60,6 +60,108 @@ PyObject* wrap_construct_by_string(PyObject* dummy, PyObject* args) {
   return Py_BuildValue("K", matcher);
 }
 
+static bool wrap_as_utf8(PyObject* item, char** ptr, Py_ssize_t* len) {
+#ifdef IS_PY3K
+  if (PyUnicode_Check(item)) {
+    // utf-8 buffer is cached in unicode object
+    *ptr = (char*)PyUnicode_AsUTF8AndSize(item, len);
+    return *ptr != NULL;
+  }
+  return PyBytes_AsStringAndSize(item, ptr, len) == 0;
+#else
+  return PyString_AsStringAndSize(item, ptr, len) == 0;
+#endif
+}
+
+/**
+ * every item of collection is same as lines of vocabulary, 'keyword[\textra]'.
+ */
+PyObject* wrap_construct_by_array(PyObject* dummy, PyObject* args) {
+  PyObject* collection;
+  PyObject* all_as_plain;
+  PyObject* ignore_bad_pattern;
+  PyObject* bad_as_plain;
+  PyObject* deduplicate_extra;
+  matcher_t matcher = NULL;
+
+  if (!PyArg_ParseTuple(args, "OOOOO", &collection, &all_as_plain, &ignore_bad_pattern, &bad_as_plain,
+                        &deduplicate_extra)) {
+    return Py_BuildValue("K", matcher);
+  }
+
+  PyObject* seq = PySequence_Fast(collection, "keywords should be sequence");
+  if (seq == NULL) {
+    return NULL;
+  }
+
+  Py_ssize_t size = PySequence_Fast_GET_SIZE(seq);
+  size_t n = 0, capacity = size > 0 ? (size_t)size : 1;
+  strlen_s* words = PyMem_Malloc(capacity * 2 * sizeof(strlen_s));
+  if (words == NULL) {
+    Py_DECREF(seq);
+    return PyErr_NoMemory();
+  }
+
+  bool success = true;
+  for (Py_ssize_t i = 0; i < size && success; i++) {
+    char* ptr;
+    Py_ssize_t len;
+    if (!wrap_as_utf8(PySequence_Fast_GET_ITEM(seq, i), &ptr, &len)) {
+      success = false;
+      break;
+    }
+
+    // split lines in place, keywords are words[0..n), and extras are words[capacity..capacity+n)
+    char* end = ptr + len;
+    while (ptr < end) {
+      char* eol = memchr(ptr, '\n', end - ptr);
+      char* line_end = eol != NULL ? eol : end;
+      if (line_end > ptr && line_end[-1] == '\r') {
+        line_end--;
+      }
+
+      if (n == capacity) {
+        strlen_s* grown = PyMem_Malloc(capacity * 4 * sizeof(strlen_s));
+        if (grown == NULL) {
+          success = false;
+          break;
+        }
+        memcpy(grown, words, n * sizeof(strlen_s));
+        memcpy(grown + capacity * 2, words + capacity, n * sizeof(strlen_s));
+        PyMem_Free(words);
+        words = grown;
+        capacity *= 2;
+      }
+
+      char* tab = memchr(ptr, '\t', line_end - ptr);
+      if (tab != NULL) {
+        words[n] = (strlen_s){.ptr = ptr, .len = tab - ptr};
+        words[capacity + n] = (strlen_s){.ptr = tab + 1, .len = line_end - tab - 1};
+      } else {
+        words[n] = (strlen_s){.ptr = ptr, .len = line_end - ptr};
+        words[capacity + n] = strlen_empty;
+      }
+      n++;
+
+      ptr = eol != NULL ? eol + 1 : end;
+    }
+  }
+
+  if (success) {
+    matcher = matcher_construct_by_array(words, words + capacity, n, PyObject_IsTrue(all_as_plain),
+                                         PyObject_IsTrue(ignore_bad_pattern), PyObject_IsTrue(bad_as_plain),
+                                         PyObject_IsTrue(deduplicate_extra));
+  }
+
+  PyMem_Free(words);
+  Py_DECREF(seq);
+
+  if (!success) {
+    return PyErr_Occurred() ? NULL : PyErr_NoMemory();
+  }
+  return Py_BuildValue("K", matcher);
+}
+
 PyObject* wrap_destroy(PyObject* dummy, PyObject* args) {
   unsigned long long temp;
   matcher_t matcher;
@@ -167,7 +269,9 @@ PyObject* wrap_find_all0(PyObject* dummy, PyObject* args, utf8ctx_next_f utf8ctx
     Py_RETURN_NONE;
   }
 
-  if (!utf8ctx_reset_context(utf8ctx, content, length, PyObject_IsTrue(return_byte_pos))) {
+  // content is held by args during the call, match it in place
+  if (!utf8ctx_reset_context_borrowed(utf8ctx, content, length, PyObject_IsTrue(return_byte_pos))) {
+    utf8ctx_free_context(utf8ctx);
     Py_RETURN_NONE;
   }
 
@@ -204,6 +308,7 @@ PyObject* wrap_find_all_prefix(PyObject* dummy, PyObject* args) {
 static PyMethodDef wrapMethods[] = {
     {"ConstructByFile", wrap_construct_by_file, METH_VARARGS, "construct matcher by file"},
     {"ConstructByString", wrap_construct_by_string, METH_VARARGS, "construct matcher by string"},
+    {"ConstructByArray", wrap_construct_by_array, METH_VARARGS, "construct matcher by collection of keywords"},
     {"Destruct", wrap_destroy, METH_VARARGS, "destruct matcher"},
     {"AllocContext", wrap_alloc_context, METH_VARARGS, "alloc iterator context"},
     {"FreeContext", wrap_free_context, METH_VARARGS, "free iterator context"},
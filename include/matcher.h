@@ -21,6 +21,8 @@ typedef struct _actrie_matcher_* matcher_t;
 struct _actrie_context_;
 typedef struct _actrie_context_* context_t;
 
+struct _actrie_utf8_context_;
+
 matcher_t matcher_construct_by_file(const char* path,
                                     bool all_as_plain,
                                     bool ignore_bad_pattern,
@@ -31,8 +33,130 @@ matcher_t matcher_construct_by_string(strlen_t string,
                                       bool ignore_bad_pattern,
                                       bool bad_as_plain,
                                       bool deduplicate_extra);
+/**
+ * matcher_construct_by_array - construct matcher by keyword/extra pairs without joining them,
+ * extras can be NULL.
+ */
+matcher_t matcher_construct_by_array(const strlen_s* keywords,
+                                     const strlen_s* extras,
+                                     size_t n,
+                                     bool all_as_plain,
+                                     bool ignore_bad_pattern,
+                                     bool bad_as_plain,
+                                     bool deduplicate_extra);
+
+#define MATCHER_ENCODING_UTF8 0
+#define MATCHER_ENCODING_GBK 1 /* GBK and GB18030 */
+#define MATCHER_ENCODING_BIG5 2
+
+#define MATCHER_NORMALIZE_CASE 0x01  /* A-Z to a-z */
+#define MATCHER_NORMALIZE_WIDTH 0x02 /* full-width forms of ASCII and ideographic space to half-width */
+
+/**
+ * matcher_options - normalization is applied to keywords when matcher is built, and to documents
+ * while scanning, positions of matched words still refer to the original document.
+ *
+ * ignore_chars are dropped by normalization, so "b a-d" is matched by keyword "bad" if space and '-' are ignored.
+ * position of such match starts at its first character and ends at its last one that is not ignored.
+ *
+ * char_automaton is ignored if some keyword is not valid UTF-8, and the byte automaton is built instead.
+ *
+ * with word_boundary, keyword is dropped while scanning if it starts or ends inside a word of document, only
+ * sides of keyword that are word characters are checked. every keyword of pattern is anchored alone.
+ *
+ * with legacy encoding, dictionary must be in the same encoding as documents, and keyword which starts at trail
+ * byte of a character is dropped while scanning. normalization is not supported, and char_automaton is ignored.
+ */
+typedef struct _actrie_matcher_options_ {
+  bool all_as_plain;
+  bool ignore_bad_pattern;
+  bool bad_as_plain;
+  bool deduplicate_extra;
+  unsigned normalize;       /* MATCHER_NORMALIZE_* */
+  strlen_t normalize_table; /* lines of "from\tto", e.g. traditional to simplified, can be NULL */
+  strlen_t ignore_chars;    /* characters skipped in keywords and documents, "x-y" is range, can be NULL */
+  bool char_automaton;      /* one transition per character instead of per byte, for CJK dictionaries */
+  bool word_boundary;
+  strlen_t word_chars; /* characters of words, "x-y" is range, "0-9A-Za-z_" if NULL */
+  unsigned encoding;   /* MATCHER_ENCODING_* of dictionary and documents */
+} matcher_options_s, *matcher_options_t;
+
+matcher_t matcher_construct_by_file_with_options(const char* path, matcher_options_t options);
+matcher_t matcher_construct_by_string_with_options(strlen_t string, matcher_options_t options);
+matcher_t matcher_construct_by_array_with_options(const strlen_s* keywords,
+                                                  const strlen_s* extras,
+                                                  size_t n,
+                                                  matcher_options_t options);
+
+/**
+ * matcher_construct_by_file_with_cache - compiled matcher is kept in cache_dir, keyed by hash of dictionary
+ * and flags. Matcher is loaded from the image if hit, otherwise it is built and the image is written.
+ */
+matcher_t matcher_construct_by_file_with_cache(const char* path,
+                                               const char* cache_dir,
+                                               bool all_as_plain,
+                                               bool ignore_bad_pattern,
+                                               bool bad_as_plain,
+                                               bool deduplicate_extra);
 void matcher_destruct(matcher_t matcher);
 
+/**
+ * matcher_encoding - MATCHER_ENCODING_* of documents, positions are counted by characters of it.
+ */
+unsigned matcher_encoding(matcher_t matcher);
+
+/**
+ * matcher_build_memory - bytes held by construction after datrie is built and before builder is freed, it is
+ * growth of amalloc_used_memory, which is process-wide, so allocations of other threads meanwhile are counted too.
+ * 0 if matcher is loaded from image.
+ */
+size_t matcher_build_memory(matcher_t matcher);
+
+/**
+ * matcher_build_peak_memory - high-water mark of amalloc_used_memory during construction, minus the usage before
+ * it. it is sampled after every pattern is added and after every stage, so buffers which live inside parse of one
+ * pattern or inside datrie build are not seen. 0 if matcher is loaded from image.
+ */
+size_t matcher_build_peak_memory(matcher_t matcher);
+
+/**
+ * matcher_loaded_from_image - true if matcher_construct_by_file_with_cache hit the cache.
+ */
+bool matcher_loaded_from_image(matcher_t matcher);
+
+#define MATCHER_STATS_DEPTH_BUCKETS 64
+
+typedef struct _actrie_matcher_stats_ {
+  // datrie
+  size_t node_count; /* slots of node_array */
+  size_t node_used;
+  size_t node_pad; /* slots reserved as padding, never used */
+  size_t node_bytes;
+  double fill_ratio; /* node_used / node_count */
+  size_t value_count;
+  double failed_chain_avg;
+  size_t failed_chain_max;
+  size_t depth_histogram[MATCHER_STATS_DEPTH_BUCKETS]; /* by transitions, the last bucket counts deeper nodes */
+
+  // expressions
+  size_t expr_text;
+  size_t expr_dist;
+  size_t expr_ambi;
+  size_t expr_anto;
+  size_t expr_pass;
+  size_t expr_output;
+  size_t expr_bytes;
+
+  // extras
+  size_t extra_used;
+  size_t extra_bytes;
+
+  size_t build_memory;
+  size_t build_peak_memory;
+} matcher_stats_s, *matcher_stats_t;
+
+void matcher_stats(matcher_t matcher, matcher_stats_t stats);
+
 context_t matcher_alloc_context(matcher_t matcher);
 void matcher_free_context(context_t context);
 
@@ -40,7 +164,30 @@ typedef size_t (*fix_pos_f)(size_t pos, size_t diff, bool plus_or_subtract, void
 
 void matcher_fix_pos(context_t context, fix_pos_f fix_pos_func, void* fix_pos_arg);
 
-void matcher_reset_context(context_t context, char content[], size_t len);
+/**
+ * matcher_reset_context - false if memory of context can not be allocated for content, and context must be reset
+ * again before next match.
+ */
+bool matcher_reset_context(context_t context, char content[], size_t len);
+
+/**
+ * matcher_scan_utf16 - whether documents can be scanned as UTF-16 code units by matcher_reset_context_utf16, it
+ * needs char automaton, and documents are neither normalized nor anchored at word boundary.
+ */
+bool matcher_scan_utf16(matcher_t matcher);
+
+/**
+ * matcher_reset_context_utf16 - scan UTF-16 code units without transcoding, positions of words are counted by units
+ * and keyword of word is units of content, its len is in bytes. surrogate pair is one character, or two characters
+ * with cesu, as keywords of dictionary are in UTF-8 or in CESU-8. false if matcher can not scan units.
+ */
+bool matcher_reset_context_utf16(context_t context, const uint16_t content[], size_t len, bool cesu);
+
+/**
+ * matcher_char_map - map of characters of content which is kept by context for legacy encoding, and is reset with
+ * context. NULL for UTF-8.
+ */
+struct _actrie_utf8_context_* matcher_char_map(context_t context);
 
 typedef struct _actrie_matched_word_ {
   strlen_s keyword;
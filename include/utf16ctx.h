@@ -0,0 +1,52 @@
+/**
+ * utf16ctx.h
+ *
+ * @author James Yin <ywhjames@hotmail.com>
+ */
+#ifndef __ACTRIE_UTF16CTX_H__
+#define __ACTRIE_UTF16CTX_H__
+
+#include <matcher.h>
+#include <utf8helper.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * utf16ctx - match UTF-16 code units, e.g. chars of Java string, and report positions in code units. keyword of
+ * word is units of content, and its len is in bytes.
+ *
+ * content is copied into context on reset, so caller can release content right after reset. if matcher can scan
+ * units (see matcher_scan_utf16), units are matched in place, otherwise they are transcoded to UTF-8 once per
+ * reset. unpaired surrogate is a character of its own, it matches only keyword of the surrogate alone in CESU-8.
+ *
+ * with cesu, surrogate pair is two characters, same as modified UTF-8 of Java, for dictionary that is built from
+ * GetStringUTFChars. otherwise it is one character, for dictionary in standard UTF-8.
+ */
+typedef struct _actrie_utf16_context_ {
+  uint16_t* units; /* copy of content */
+  size_t unit_capacity;
+  char* buffer; /* UTF-8 of content, unused if native */
+  size_t len;
+  size_t capacity;
+  size_t* pairs; /* byte offsets in buffer of characters that take two units, ascending, unused with cesu */
+  size_t pair_count;
+  size_t pair_capacity;
+  bool cesu;
+  bool native; /* units are scanned without transcoding */
+  context_t matcher_ctx;
+  utf8_ctx_s utf8_ctx; /* chars of buffer, or chars of units if native */
+} utf16ctx_s, *utf16ctx_t;
+
+utf16ctx_t utf16ctx_alloc_context(matcher_t matcher, bool cesu);
+void utf16ctx_free_context(utf16ctx_t utf16ctx);
+bool utf16ctx_reset_context(utf16ctx_t utf16ctx, const uint16_t* content, size_t len);
+word_t utf16ctx_next(utf16ctx_t utf16ctx);
+word_t utf16ctx_next_prefix(utf16ctx_t utf16ctx);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif  // __ACTRIE_UTF16CTX_H__
@@ -14,15 +14,23 @@ extern "C" {
 #endif /* __cplusplus */
 
 typedef struct context_wrapper {
-  strlen_s content;
+  strlen_s content; /* points to buffer, or to memory of caller if borrowed */
+  char* buffer;     /* owned copy of content */
   context_t matcher_ctx;
   utf8_ctx_s utf8_ctx;
+  utf8_ctx_t char_map; /* utf8_ctx, or map kept by matcher_ctx for legacy encoding */
   bool return_byte_pos;
 } utf8ctx_s, *utf8ctx_t;
 
 utf8ctx_t utf8ctx_alloc_context(matcher_t matcher);
 void utf8ctx_free_context(utf8ctx_t utf8ctx);
 bool utf8ctx_reset_context(utf8ctx_t utf8ctx, char* content, int length, bool return_byte_pos);
+
+/**
+ * utf8ctx_reset_context_borrowed - match content in place without copy,
+ * content must be kept alive and unchanged until next reset or free of context.
+ */
+bool utf8ctx_reset_context_borrowed(utf8ctx_t utf8ctx, char* content, int length, bool return_byte_pos);
 word_t utf8ctx_next(utf8ctx_t utf8ctx);
 word_t utf8ctx_next_prefix(utf8ctx_t utf8ctx);
 
@@ -12,9 +12,35 @@
 extern "C" {
 #endif /* __cplusplus */
 
+#define UTF8_BLOCK_SHIFT 6
+#define UTF8_BLOCK_SIZE (1 << UTF8_BLOCK_SHIFT)
+
+/* content is UTF-16 code units and offsets are counted by units, surrogate pair is one char */
+#define UTF8_ENCODING_UTF16 0x100
+
+/**
+ * utf8_block - checkpoint of every 64 bytes, takes 1/32 memory of one size_t per byte
+ */
+typedef struct _actrie_utf8_block_ {
+  size_t chars;   /* count of chars start before this block */
+  uint64_t leads; /* bit i is set if byte i of block starts a char */
+} utf8_block_s, *utf8_block_t;
+
+/**
+ * utf8_ctx - map byte offset to char offset, the map is built lazily and only covers offsets used by matches.
+ * chars are split by encoding, which is UTF-8 unless it is set to MATCHER_ENCODING_* of a legacy encoding, or to
+ * UTF8_ENCODING_UTF16.
+ */
 typedef struct _actrie_utf8_context_ {
-  size_t* pos;
+  const char* content;
   size_t len;
+  unsigned encoding;
+  size_t next_lead;     /* offset of char after built blocks, legacy encodings are split forward only */
+  utf8_block_t blocks;
+  size_t built;         /* blocks[0, built) are valid */
+  size_t* char_blocks;  /* char_blocks[j] is the block where char 64*j starts */
+  size_t indexed;       /* char_blocks[0, indexed) are valid */
+  size_t capacity;      /* slots of blocks and char_blocks */
 } utf8_ctx_s, *utf8_ctx_t;
 
 utf8_ctx_t alloc_utf8_context(void);
@@ -22,6 +48,47 @@ void free_utf8_context(utf8_ctx_t context);
 
 bool reset_utf8_context(utf8_ctx_t context, char content[], size_t len);
 
+void build_utf8_pos(utf8_ctx_t context, size_t block);
+
+static inline size_t utf8_popcount(uint64_t x) {
+#if defined(__POPCNT__)
+  return (size_t)__builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (size_t)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/**
+ * map_utf8_pos - count of chars start before byte pos, O(1) after block of pos is built
+ */
+static inline size_t map_utf8_pos(utf8_ctx_t context, size_t pos) {
+  size_t block = pos >> UTF8_BLOCK_SHIFT;
+  if (block >= context->built) {
+    build_utf8_pos(context, block);
+  }
+  uint64_t below = ((uint64_t)1 << (pos & (UTF8_BLOCK_SIZE - 1))) - 1;
+  return context->blocks[block].chars + utf8_popcount(context->blocks[block].leads & below);
+}
+
+/**
+ * is_utf8_lead - whether a char starts at byte pos
+ */
+static inline bool is_utf8_lead(utf8_ctx_t context, size_t pos) {
+  size_t block = pos >> UTF8_BLOCK_SHIFT;
+  if (block >= context->built) {
+    build_utf8_pos(context, block);
+  }
+  return (context->blocks[block].leads >> (pos & (UTF8_BLOCK_SIZE - 1))) & 1;
+}
+
+/**
+ * seek_utf8_pos - byte offset where the char starts, or len if content is shorter
+ */
+size_t seek_utf8_pos(utf8_ctx_t context, size_t chars);
+
 size_t fix_utf8_pos(size_t pos, size_t diff, bool plus_or_subtract, void* arg);
 
 #ifdef __cplusplus
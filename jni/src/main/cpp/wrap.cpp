@@ -4,8 +4,25 @@
 #include <psn_ifplusor_actrie_Matcher.h>
 
 #include <matcher.h>
+#include <utf16ctx.h>
 #include <utf8ctx.h>
 
+/**
+ * matcher_jni_options - java strings are UTF-16, char automaton lets utf16 context scan chars without transcoding.
+ */
+static inline matcher_options_s matcher_jni_options(jboolean all_as_plain,
+                                                    jboolean ignore_bad_pattern,
+                                                    jboolean bad_as_plain,
+                                                    jboolean deduplicate_extra) {
+  matcher_options_s options = {};
+  options.all_as_plain = all_as_plain;
+  options.ignore_bad_pattern = ignore_bad_pattern;
+  options.bad_as_plain = bad_as_plain;
+  options.deduplicate_extra = deduplicate_extra;
+  options.char_automaton = true;
+  return options;
+}
+
 /*
  * Class:     psn_ifplusor_actrie_Matcher
  * Method:    ConstructByFile
@@ -25,7 +42,8 @@ JNIEXPORT jlong JNICALL Java_psn_ifplusor_actrie_Matcher_ConstructByFile(JNIEnv*
   const char* utf = env->GetStringUTFChars(filepath, JNI_FALSE);
   // jsize len = env->GetStringUTFLength(filepath);
 
-  matcher_t matcher = matcher_construct_by_file(utf, all_as_plain, ignore_bad_pattern, bad_as_plain, deduplicate_extra);
+  matcher_options_s options = matcher_jni_options(all_as_plain, ignore_bad_pattern, bad_as_plain, deduplicate_extra);
+  matcher_t matcher = matcher_construct_by_file_with_options(utf, &options);
 
   env->ReleaseStringUTFChars(filepath, utf);
 
@@ -52,14 +70,85 @@ JNIEXPORT jlong JNICALL Java_psn_ifplusor_actrie_Matcher_ConstructByString(JNIEn
   jsize len = env->GetStringUTFLength(keywords);
 
   strlen_s vocab = {.ptr = (char*)utf, .len = (size_t)len};
-  matcher_t matcher =
-      matcher_construct_by_string(&vocab, all_as_plain, ignore_bad_pattern, bad_as_plain, deduplicate_extra);
+  matcher_options_s options = matcher_jni_options(all_as_plain, ignore_bad_pattern, bad_as_plain, deduplicate_extra);
+  matcher_t matcher = matcher_construct_by_string_with_options(&vocab, &options);
 
   env->ReleaseStringUTFChars(keywords, utf);
 
   return (jlong)matcher;
 }
 
+static inline jstring array_word(JNIEnv* env, jobjectArray keywords, jobjectArray extras, jsize n, jsize i) {
+  jobjectArray array = i < n ? keywords : extras;
+  return array != NULL ? (jstring)env->GetObjectArrayElement(array, i < n ? i : i - n) : NULL;
+}
+
+/*
+ * Class:     psn_ifplusor_actrie_Matcher
+ * Method:    ConstructByArray
+ * Signature: ([Ljava/lang/String;[Ljava/lang/String;ZZZZ)J
+ */
+JNIEXPORT jlong JNICALL Java_psn_ifplusor_actrie_Matcher_ConstructByArray(JNIEnv* env,
+                                                                          jclass clazz,
+                                                                          jobjectArray keywords,
+                                                                          jobjectArray extras,
+                                                                          jboolean all_as_plain,
+                                                                          jboolean ignore_bad_pattern,
+                                                                          jboolean bad_as_plain,
+                                                                          jboolean deduplicate_extra) {
+  if (keywords == NULL) {
+    return 0;
+  }
+
+  jsize n = env->GetArrayLength(keywords);
+  if (extras != NULL && env->GetArrayLength(extras) < n) {
+    return 0;
+  }
+
+  // words[0..n) are keywords, and words[n..2n) are extras
+  strlen_s* words = (strlen_s*)malloc((n > 0 ? n : 1) * 2 * sizeof(strlen_s));
+  if (words == NULL) {
+    return 0;
+  }
+
+  // first pass: length of every word in modified utf-8
+  size_t total = 0;
+  for (jsize i = 0; i < 2 * n; i++) {
+    jstring word = array_word(env, keywords, extras, n, i);
+    words[i].len = word != NULL ? (size_t)env->GetStringUTFLength(word) : 0;
+    total += words[i].len;
+    if (word != NULL) {
+      env->DeleteLocalRef(word);
+    }
+  }
+
+  // second pass: copy all words into one buffer, local references are released one by one.
+  // GetStringUTFRegion may append '\0', which is overwritten by next word.
+  char* buffer = (char*)malloc(total + 1);
+  if (buffer == NULL) {
+    free(words);
+    return 0;
+  }
+  char* ptr = buffer;
+  for (jsize i = 0; i < 2 * n; i++) {
+    words[i].ptr = ptr;
+    if (words[i].len > 0) {
+      jstring word = array_word(env, keywords, extras, n, i);
+      env->GetStringUTFRegion(word, 0, env->GetStringLength(word), ptr);
+      env->DeleteLocalRef(word);
+      ptr += words[i].len;
+    }
+  }
+
+  matcher_options_s options = matcher_jni_options(all_as_plain, ignore_bad_pattern, bad_as_plain, deduplicate_extra);
+  matcher_t matcher = matcher_construct_by_array_with_options(words, words + n, n, &options);
+
+  free(buffer);
+  free(words);
+
+  return (jlong)matcher;
+}
+
 /*
  * Class:     psn_ifplusor_actrie_Matcher
  * Method:    Destruct
@@ -119,15 +208,77 @@ JNIEXPORT jboolean JNICALL Java_psn_ifplusor_actrie_Context_ResetContext(JNIEnv*
 
 #define BUILDWORD_METHOD_SIG "(Ljava/lang/String;JJLjava/lang/String;)Lpsn/ifplusor/actrie/Word;"
 
-static inline jobject build_matched_output(JNIEnv* env, jclass clazz, utf8ctx_t utf8ctx, word_t matched_word) {
+static inline bool is_continuation(const unsigned char* ptr, size_t len, size_t i, size_t n) {
+  for (size_t j = 1; j < n; j++) {
+    if (i + j >= len || (ptr[i + j] & 0xC0) != 0x80) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * new_string - NewStringUTF only accepts modified UTF-8, but dictionary loaded from file is standard UTF-8. both
+ * are decoded here: 4-byte sequence becomes surrogate pair, 3-byte sequence of surrogate is kept as its unit, and
+ * bad byte becomes U+FFFD.
+ */
+static jstring new_string(JNIEnv* env, strlen_t str) {
+  const unsigned char* ptr = (const unsigned char*)str->ptr;
+  size_t len = str->len;
+
+  // units are no more than bytes
+  jchar buffer[256];
+  jchar* chars = len <= 256 ? buffer : (jchar*)malloc(len * sizeof(jchar));
+  if (chars == NULL) {
+    return NULL;
+  }
+
+  size_t n = 0, i = 0;
+  while (i < len) {
+    uint32_t c = ptr[i];
+    if (c < 0x80) {
+      chars[n++] = (jchar)c;
+      i++;
+    } else if ((c & 0xE0) == 0xC0 && is_continuation(ptr, len, i, 2)) {
+      chars[n++] = (jchar)(((c & 0x1F) << 6) | (ptr[i + 1] & 0x3F));
+      i += 2;
+    } else if ((c & 0xF0) == 0xE0 && is_continuation(ptr, len, i, 3)) {
+      chars[n++] = (jchar)(((c & 0x0F) << 12) | ((ptr[i + 1] & 0x3F) << 6) | (ptr[i + 2] & 0x3F));
+      i += 3;
+    } else if ((c & 0xF8) == 0xF0 && is_continuation(ptr, len, i, 4) &&
+               (c = ((c & 0x07) << 18) | ((ptr[i + 1] & 0x3F) << 12) | ((ptr[i + 2] & 0x3F) << 6) |
+                    (ptr[i + 3] & 0x3F)) >= 0x10000 &&
+               c < 0x110000) {
+      chars[n++] = (jchar)(0xD800 + ((c - 0x10000) >> 10));
+      chars[n++] = (jchar)(0xDC00 + ((c - 0x10000) & 0x3FF));
+      i += 4;
+    } else {
+      chars[n++] = 0xFFFD;
+      i++;
+    }
+  }
+
+  jstring string = env->NewString(chars, (jsize)n);
+  if (chars != buffer) {
+    free(chars);
+  }
+  return string;
+}
+
+/**
+ * build_matched_output - keyword is decoded from bytes of context, but in utf16 mode it is chars of content, and
+ * its len is in bytes.
+ */
+static inline jobject build_matched_output(JNIEnv* env, jclass clazz, word_t matched_word, bool utf16) {
   jmethodID buildWord = env->GetStaticMethodID(clazz, "buildWord", BUILDWORD_METHOD_SIG);
-  char* s = (char*)malloc(matched_word->keyword.len + 1);
-  strncpy(s, matched_word->keyword.ptr, matched_word->keyword.len);
-  s[matched_word->keyword.len] = '\0';
-  jstring keyword = env->NewStringUTF(s);
-  jstring extra = env->NewStringUTF(matched_word->extra.ptr);
+  jstring keyword = utf16 ? env->NewString((const jchar*)matched_word->keyword.ptr,
+                                           (jsize)(matched_word->keyword.len / sizeof(jchar)))
+                          : new_string(env, &matched_word->keyword);
+  jstring extra = new_string(env, &matched_word->extra);
   jobject word = env->CallStaticObjectMethod(clazz, buildWord, keyword, (jlong)matched_word->pos.so,
                                              (jlong)matched_word->pos.eo, extra);
+  env->DeleteLocalRef(keyword);
+  env->DeleteLocalRef(extra);
   return word;
 }
 
@@ -140,7 +291,7 @@ static jobject next(JNIEnv* env, jclass clazz, jlong context, utf8ctx_next_f utf
 
   word_t matched_word = utf8ctx_next_func((utf8ctx_t)context);
   if (matched_word != NULL) {
-    return build_matched_output(env, clazz, (utf8ctx_t)context, matched_word);
+    return build_matched_output(env, clazz, matched_word, false);
   }
 
   return NULL;
@@ -154,3 +305,231 @@ static jobject next(JNIEnv* env, jclass clazz, jlong context, utf8ctx_next_f utf
 JNIEXPORT jobject JNICALL Java_psn_ifplusor_actrie_Context_Next(JNIEnv* env, jclass clazz, jlong context) {
   return next(env, clazz, context, utf8ctx_next);
 }
+
+/*
+ * Class:     psn_ifplusor_actrie_Context
+ * Method:    FindAll
+ * Signature: (JLjava/lang/String;Z)Ljava/util/ArrayList;
+ */
+JNIEXPORT jobject JNICALL Java_psn_ifplusor_actrie_Context_FindAll(JNIEnv* env,
+                                                                   jclass clazz,
+                                                                   jlong matcher,
+                                                                   jstring content,
+                                                                   jboolean return_byte_pos) {
+  if (matcher == 0 || content == NULL) {
+    return NULL;
+  }
+
+  jclass list_class = env->FindClass("java/util/ArrayList");
+  jmethodID list_init = env->GetMethodID(list_class, "<init>", "()V");
+  jmethodID list_add = env->GetMethodID(list_class, "add", "(Ljava/lang/Object;)Z");
+
+  utf8ctx_t utf8ctx = utf8ctx_alloc_context((matcher_t)matcher);
+  if (utf8ctx == NULL) {
+    return NULL;
+  }
+
+  // utf is not released until all words are built, match it in place
+  const char* utf = env->GetStringUTFChars(content, JNI_FALSE);
+  jsize len = env->GetStringUTFLength(content);
+
+  jobject list = NULL;
+  if (utf8ctx_reset_context_borrowed(utf8ctx, (char*)utf, len, return_byte_pos)) {
+    list = env->NewObject(list_class, list_init);
+    word_t matched_word = utf8ctx_next(utf8ctx);
+    while (matched_word != NULL) {
+      jobject word = build_matched_output(env, clazz, matched_word, false);
+      env->CallBooleanMethod(list, list_add, word);
+      env->DeleteLocalRef(word);
+      matched_word = utf8ctx_next(utf8ctx);
+    }
+  }
+
+  env->ReleaseStringUTFChars(content, utf);
+  utf8ctx_free_context(utf8ctx);
+
+  return list;
+}
+
+/*
+ * Class:     psn_ifplusor_actrie_Context
+ * Method:    AllocUtf16Context
+ * Signature: (JZ)J
+ */
+JNIEXPORT jlong JNICALL Java_psn_ifplusor_actrie_Context_AllocUtf16Context(JNIEnv* env,
+                                                                            jclass clazz,
+                                                                            jlong matcher,
+                                                                            jboolean cesu) {
+  if (matcher == 0) {
+    return 0;
+  }
+
+  return (jlong)utf16ctx_alloc_context((matcher_t)matcher, cesu);
+}
+
+/*
+ * Class:     psn_ifplusor_actrie_Context
+ * Method:    FreeUtf16Context
+ * Signature: (J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_psn_ifplusor_actrie_Context_FreeUtf16Context(JNIEnv* env,
+                                                                             jclass clazz,
+                                                                             jlong context) {
+  utf16ctx_free_context((utf16ctx_t)context);
+  return JNI_TRUE;
+}
+
+// chars are transcoded into context inside critical region, so no JNI call is made before release
+
+static bool reset_utf16_by_string(JNIEnv* env, utf16ctx_t utf16ctx, jstring content) {
+  jsize len = env->GetStringLength(content);
+  const jchar* chars = env->GetStringCritical(content, NULL);
+  if (chars == NULL) {
+    return false;
+  }
+  bool succeed = utf16ctx_reset_context(utf16ctx, (const uint16_t*)chars, (size_t)len);
+  env->ReleaseStringCritical(content, chars);
+  return succeed;
+}
+
+static bool reset_utf16_by_array(JNIEnv* env, utf16ctx_t utf16ctx, jcharArray content, jint offset, jint length) {
+  if (offset < 0 || length < 0 || offset > env->GetArrayLength(content) - length) {
+    return false;
+  }
+  jchar* chars = (jchar*)env->GetPrimitiveArrayCritical(content, NULL);
+  if (chars == NULL) {
+    return false;
+  }
+  bool succeed = utf16ctx_reset_context(utf16ctx, (const uint16_t*)(chars + offset), (size_t)length);
+  env->ReleasePrimitiveArrayCritical(content, chars, JNI_ABORT);
+  return succeed;
+}
+
+/*
+ * Class:     psn_ifplusor_actrie_Context
+ * Method:    ResetUtf16Context
+ * Signature: (JLjava/lang/String;)Z
+ */
+JNIEXPORT jboolean JNICALL Java_psn_ifplusor_actrie_Context_ResetUtf16Context(JNIEnv* env,
+                                                                              jclass clazz,
+                                                                              jlong context,
+                                                                              jstring content) {
+  if (context == 0 || content == NULL) {
+    return JNI_FALSE;
+  }
+
+  return reset_utf16_by_string(env, (utf16ctx_t)context, content) ? JNI_TRUE : JNI_FALSE;
+}
+
+/*
+ * Class:     psn_ifplusor_actrie_Context
+ * Method:    ResetUtf16ContextByArray
+ * Signature: (J[CII)Z
+ */
+JNIEXPORT jboolean JNICALL Java_psn_ifplusor_actrie_Context_ResetUtf16ContextByArray(JNIEnv* env,
+                                                                                     jclass clazz,
+                                                                                     jlong context,
+                                                                                     jcharArray content,
+                                                                                     jint offset,
+                                                                                     jint length) {
+  if (context == 0 || content == NULL) {
+    return JNI_FALSE;
+  }
+
+  return reset_utf16_by_array(env, (utf16ctx_t)context, content, offset, length) ? JNI_TRUE : JNI_FALSE;
+}
+
+/*
+ * Class:     psn_ifplusor_actrie_Context
+ * Method:    NextUtf16
+ * Signature: (J)Lpsn/ifplusor/actrie/Word;
+ */
+JNIEXPORT jobject JNICALL Java_psn_ifplusor_actrie_Context_NextUtf16(JNIEnv* env, jclass clazz, jlong context) {
+  if (context == 0) {
+    return NULL;
+  }
+
+  word_t matched_word = utf16ctx_next((utf16ctx_t)context);
+  if (matched_word != NULL) {
+    return build_matched_output(env, clazz, matched_word, true);
+  }
+
+  return NULL;
+}
+
+static jobject find_all_utf16(JNIEnv* env, jclass clazz, utf16ctx_t utf16ctx) {
+  jclass list_class = env->FindClass("java/util/ArrayList");
+  jmethodID list_init = env->GetMethodID(list_class, "<init>", "()V");
+  jmethodID list_add = env->GetMethodID(list_class, "add", "(Ljava/lang/Object;)Z");
+
+  jobject list = env->NewObject(list_class, list_init);
+  word_t matched_word = utf16ctx_next(utf16ctx);
+  while (matched_word != NULL) {
+    jobject word = build_matched_output(env, clazz, matched_word, true);
+    env->CallBooleanMethod(list, list_add, word);
+    env->DeleteLocalRef(word);
+    matched_word = utf16ctx_next(utf16ctx);
+  }
+
+  return list;
+}
+
+/*
+ * Class:     psn_ifplusor_actrie_Context
+ * Method:    FindAllUtf16
+ * Signature: (JZLjava/lang/String;)Ljava/util/ArrayList;
+ */
+JNIEXPORT jobject JNICALL Java_psn_ifplusor_actrie_Context_FindAllUtf16(JNIEnv* env,
+                                                                        jclass clazz,
+                                                                        jlong matcher,
+                                                                        jboolean cesu,
+                                                                        jstring content) {
+  if (matcher == 0 || content == NULL) {
+    return NULL;
+  }
+
+  utf16ctx_t utf16ctx = utf16ctx_alloc_context((matcher_t)matcher, cesu);
+  if (utf16ctx == NULL) {
+    return NULL;
+  }
+
+  jobject list = NULL;
+  if (reset_utf16_by_string(env, utf16ctx, content)) {
+    list = find_all_utf16(env, clazz, utf16ctx);
+  }
+
+  utf16ctx_free_context(utf16ctx);
+
+  return list;
+}
+
+/*
+ * Class:     psn_ifplusor_actrie_Context
+ * Method:    FindAllUtf16ByArray
+ * Signature: (JZ[CII)Ljava/util/ArrayList;
+ */
+JNIEXPORT jobject JNICALL Java_psn_ifplusor_actrie_Context_FindAllUtf16ByArray(JNIEnv* env,
+                                                                               jclass clazz,
+                                                                               jlong matcher,
+                                                                               jboolean cesu,
+                                                                               jcharArray content,
+                                                                               jint offset,
+                                                                               jint length) {
+  if (matcher == 0 || content == NULL) {
+    return NULL;
+  }
+
+  utf16ctx_t utf16ctx = utf16ctx_alloc_context((matcher_t)matcher, cesu);
+  if (utf16ctx == NULL) {
+    return NULL;
+  }
+
+  jobject list = NULL;
+  if (reset_utf16_by_array(env, utf16ctx, content, offset, length)) {
+    list = find_all_utf16(env, clazz, utf16ctx);
+  }
+
+  utf16ctx_free_context(utf16ctx);
+
+  return list;
+}
@@ -1,5 +1,6 @@
 package psn.ifplusor.actrie;
 
+import java.util.ArrayList;
 import java.util.Iterator;
 
 public class Context implements Iterable<Word>, AutoCloseable {
@@ -10,16 +11,29 @@ public class Context implements Iterable<Word>, AutoCloseable {
     private String content = null;
     private boolean returnBytePos = false;
 
+    // match chars of string directly, and offsets of words are in chars
+    private final boolean utf16;
+
     private boolean uninitialized = false;
 
     public Context(Matcher matcher) throws MatcherError {
+        this(matcher, false);
+    }
+
+    public Context(Matcher matcher, boolean utf16) throws MatcherError {
         if (matcher == null) {
             throw new MatcherError("Matcher is null");
         }
 
         this.matcher = matcher;
+        this.utf16 = utf16;
         // alloc native context
-        this.nativeContext = Context.AllocContext(this.matcher.getNativeMatcher());
+        if (utf16) {
+            this.nativeContext = Context.AllocUtf16Context(this.matcher.getNativeMatcher(),
+                    this.matcher.isModifiedUtf8());
+        } else {
+            this.nativeContext = Context.AllocContext(this.matcher.getNativeMatcher());
+        }
     }
 
     public Context(Matcher matcher, String content) throws MatcherError {
@@ -32,6 +46,9 @@ public class Context implements Iterable<Word>, AutoCloseable {
     }
 
     public void reset(String content, Boolean returnBytePos) throws MatcherError {
+        if (this.utf16) {
+            throw new MatcherError("Context is in utf16 mode, use resetUtf16.");
+        }
         if (content != null) {
             this.content = content;
         }
@@ -44,10 +61,37 @@ public class Context implements Iterable<Word>, AutoCloseable {
         }
     }
 
+    /**
+     * content is transcoded into native context, so it can be changed after reset.
+     */
+    public void resetUtf16(String content) throws MatcherError {
+        if (!this.utf16) {
+            throw new MatcherError("Context is not in utf16 mode.");
+        }
+        this.uninitialized = content == null || !Context.ResetUtf16Context(this.nativeContext, content);
+        if (this.uninitialized) {
+            throw new MatcherError("Reset context failed!");
+        }
+    }
+
+    public void resetUtf16(char[] content, int offset, int length) throws MatcherError {
+        if (!this.utf16) {
+            throw new MatcherError("Context is not in utf16 mode.");
+        }
+        this.uninitialized = content == null
+                || !Context.ResetUtf16ContextByArray(this.nativeContext, content, offset, length);
+        if (this.uninitialized) {
+            throw new MatcherError("Reset context failed!");
+        }
+    }
+
     public Word next() {
         if (this.uninitialized) {
             return null;
         }
+        if (this.utf16) {
+            return Context.NextUtf16(this.nativeContext);
+        }
         return Context.Next(this.nativeContext);
     }
 
@@ -76,7 +120,11 @@ public class Context implements Iterable<Word>, AutoCloseable {
 
     @Override
     public void close() throws Exception {
-        Context.FreeContext(this.nativeContext);
+        if (this.utf16) {
+            Context.FreeUtf16Context(this.nativeContext);
+        } else {
+            Context.FreeContext(this.nativeContext);
+        }
         this.nativeContext = 0;
     }
 
@@ -98,4 +146,21 @@ public class Context implements Iterable<Word>, AutoCloseable {
 
     private static native Word Next(long context);
 
+    static native ArrayList<Word> FindAll(long matcher, String content, boolean returnBytePos);
+
+    private static native long AllocUtf16Context(long matcher, boolean cesu);
+
+    private static native boolean FreeUtf16Context(long context);
+
+    private static native boolean ResetUtf16Context(long context, String content);
+
+    private static native boolean ResetUtf16ContextByArray(long context, char[] content, int offset, int length);
+
+    private static native Word NextUtf16(long context);
+
+    static native ArrayList<Word> FindAllUtf16(long matcher, boolean cesu, String content);
+
+    static native ArrayList<Word> FindAllUtf16ByArray(long matcher, boolean cesu, char[] content, int offset,
+            int length);
+
 }
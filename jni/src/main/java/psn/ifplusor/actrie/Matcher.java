@@ -1,5 +1,7 @@
 package psn.ifplusor.actrie;
 
+import java.util.List;
+
 public class Matcher implements AutoCloseable {
 
     static {
@@ -8,10 +10,17 @@ public class Matcher implements AutoCloseable {
 
     private long nativeMatcher = 0;
 
+    // keywords from java strings are passed to native in modified UTF-8, surrogate pair is two 3-byte sequences
+    private boolean modifiedUtf8 = false;
+
     public long getNativeMatcher() {
         return this.nativeMatcher;
     }
 
+    boolean isModifiedUtf8() {
+        return this.modifiedUtf8;
+    }
+
     public static Matcher createByFile(String filepath) throws MatcherError {
         return Matcher.createByFile(filepath, false, false, true, true);
     }
@@ -69,6 +78,44 @@ public class Matcher implements AutoCloseable {
         }
         this.nativeMatcher = Matcher.ConstructByString(keywords, allAsPlain, ignoreBadPattern, badAsPlain,
                 deduplicateExtra);
+        this.modifiedUtf8 = true;
+        return this.nativeMatcher != 0;
+    }
+
+    public static Matcher createByArray(String[] keywords, String[] extras) throws MatcherError {
+        return Matcher.createByArray(keywords, extras, false, false, true, true);
+    }
+
+    public static Matcher createByArray(String[] keywords, String[] extras, boolean allAsPlain,
+            boolean ignoreBadPattern, boolean badAsPlain, boolean deduplicateExtra) throws MatcherError {
+        Matcher matcher = new Matcher();
+        if (matcher.loadFromArray(keywords, extras, allAsPlain, ignoreBadPattern, badAsPlain, deduplicateExtra)) {
+            return matcher;
+        }
+        return null;
+    }
+
+    public boolean loadFromArray(String[] keywords, String[] extras) throws MatcherError {
+        return loadFromArray(keywords, extras, false, false, true, true);
+    }
+
+    /**
+     * keywords and extras are passed to native without joining, extras can be null.
+     */
+    public boolean loadFromArray(String[] keywords, String[] extras, boolean allAsPlain, boolean ignoreBadPattern,
+            boolean badAsPlain, boolean deduplicateExtra) throws MatcherError {
+        if (this.nativeMatcher != 0) {
+            throw new MatcherError("Matcher is already initialized.");
+        }
+        if (keywords == null) {
+            return false;
+        }
+        if (extras != null && extras.length < keywords.length) {
+            throw new MatcherError("Extras is shorter than keywords.");
+        }
+        this.nativeMatcher = Matcher.ConstructByArray(keywords, extras, allAsPlain, ignoreBadPattern, badAsPlain,
+                deduplicateExtra);
+        this.modifiedUtf8 = true;
         return this.nativeMatcher != 0;
     }
 
@@ -83,6 +130,82 @@ public class Matcher implements AutoCloseable {
         return new Context(this, content, returnBytePos);
     }
 
+    public List<Word> findAll(String content) throws MatcherError {
+        return findAll(content, false);
+    }
+
+    /**
+     * content is matched in place by native, without copy into context.
+     */
+    public List<Word> findAll(String content, boolean returnBytePos) throws MatcherError {
+        if (this.nativeMatcher == 0) {
+            throw new MatcherError("Matcher is not initialized.");
+        }
+        if (content == null) {
+            throw new MatcherError("Content is null.");
+        }
+        List<Word> words = Context.FindAll(this.nativeMatcher, content, returnBytePos);
+        if (words == null) {
+            throw new MatcherError("Match failed!");
+        }
+        return words;
+    }
+
+    /**
+     * content is matched as UTF-16 chars without conversion to modified UTF-8, offsets of words are indices of
+     * chars in content, same as String.substring. supplementary characters match keywords of both dictionary file
+     * and java strings. matcher is built as char automaton, chars are scanned in place unless dictionary is not
+     * valid UTF-8.
+     */
+    public Context matchUtf16(String content) throws MatcherError {
+        if (this.nativeMatcher == 0) {
+            throw new MatcherError("Matcher is not initialized.");
+        }
+        Context context = new Context(this, true);
+        context.resetUtf16(content);
+        return context;
+    }
+
+    public Context matchUtf16(char[] content, int offset, int length) throws MatcherError {
+        if (this.nativeMatcher == 0) {
+            throw new MatcherError("Matcher is not initialized.");
+        }
+        Context context = new Context(this, true);
+        context.resetUtf16(content, offset, length);
+        return context;
+    }
+
+    public List<Word> findAllUtf16(String content) throws MatcherError {
+        if (this.nativeMatcher == 0) {
+            throw new MatcherError("Matcher is not initialized.");
+        }
+        if (content == null) {
+            throw new MatcherError("Content is null.");
+        }
+        List<Word> words = Context.FindAllUtf16(this.nativeMatcher, this.modifiedUtf8, content);
+        if (words == null) {
+            throw new MatcherError("Match failed!");
+        }
+        return words;
+    }
+
+    /**
+     * offsets of words are relative to offset.
+     */
+    public List<Word> findAllUtf16(char[] content, int offset, int length) throws MatcherError {
+        if (this.nativeMatcher == 0) {
+            throw new MatcherError("Matcher is not initialized.");
+        }
+        if (content == null) {
+            throw new MatcherError("Content is null.");
+        }
+        List<Word> words = Context.FindAllUtf16ByArray(this.nativeMatcher, this.modifiedUtf8, content, offset, length);
+        if (words == null) {
+            throw new MatcherError("Match failed!");
+        }
+        return words;
+    }
+
     @Override
     public void close() throws Exception {
         Matcher.Destruct(this.nativeMatcher);
@@ -100,6 +223,9 @@ public class Matcher implements AutoCloseable {
     private static native long ConstructByString(String keywords, boolean allAsPlain, boolean ignoreBadPattern,
             boolean badAsPlain, boolean deduplicateExtra);
 
+    private static native long ConstructByArray(String[] keywords, String[] extras, boolean allAsPlain,
+            boolean ignoreBadPattern, boolean badAsPlain, boolean deduplicateExtra);
+
     private static native boolean Destruct(long matcher);
 
 }
@@ -0,0 +1,121 @@
+/**
+ * charclass.c
+ *
+ * @author James Yin <ywhjames@hotmail.com>
+ */
+#include "charclass.h"
+
+#include "normalizer.h"
+
+static int charclass_range_compare(const void* a, const void* b) {
+  uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+  return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static void charclass_add(charclass_t self, uint32_t first, uint32_t last) {
+  for (; first <= last && first < 128; first++) {
+    self->ascii[first >> 6] |= (uint64_t)1 << (first & 63);
+  }
+  if (first <= last) {
+    self->ranges[self->range_count * 2] = first;
+    self->ranges[self->range_count * 2 + 1] = last;
+    self->range_count++;
+  }
+}
+
+charclass_t charclass_construct(strlen_t spec) {
+  charclass_t self = amalloc(sizeof(charclass_s));
+  if (self == NULL) {
+    return NULL;
+  }
+  self->ascii[0] = self->ascii[1] = 0;
+  self->range_count = 0;
+  // one range per character at most
+  self->ranges = amalloc(alib_max(spec->len, 1) * 2 * sizeof(uint32_t));
+  if (self->ranges == NULL) {
+    afree(self);
+    return NULL;
+  }
+
+  const uint8_t* ptr = (const uint8_t*)spec->ptr;
+  size_t len = spec->len, i = 0;
+  while (i < len) {
+    uint32_t first, last;
+    i += normalizer_decode(ptr + i, len - i, &first);
+    last = first;
+    if (i + 1 < len && ptr[i] == '-') {
+      i++;
+      i += normalizer_decode(ptr + i, len - i, &last);
+    }
+    if (first >= NORMALIZER_RAW || last >= NORMALIZER_RAW || first > last) {
+      charclass_destruct(self);
+      return NULL;
+    }
+    charclass_add(self, first, last);
+  }
+
+  // merge overlapped and adjacent ranges
+  if (self->range_count > 0) {
+    qsort(self->ranges, self->range_count, 2 * sizeof(uint32_t), charclass_range_compare);
+    size_t n = 0;
+    for (size_t j = 1; j < self->range_count; j++) {
+      if (self->ranges[j * 2] <= self->ranges[n * 2 + 1] + 1) {
+        self->ranges[n * 2 + 1] = alib_max(self->ranges[n * 2 + 1], self->ranges[j * 2 + 1]);
+      } else {
+        n++;
+        self->ranges[n * 2] = self->ranges[j * 2];
+        self->ranges[n * 2 + 1] = self->ranges[j * 2 + 1];
+      }
+    }
+    self->range_count = n + 1;
+  }
+
+  return self;
+}
+
+void charclass_destruct(charclass_t self) {
+  if (self != NULL) {
+    afree(self->ranges);
+    afree(self);
+  }
+}
+
+bool charclass_contains(charclass_t self, uint32_t cp) {
+  if (cp < 128) {
+    return (self->ascii[cp >> 6] >> (cp & 63)) & 1;
+  }
+  // last range starts no later than cp
+  size_t lo = 0, hi = self->range_count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (self->ranges[mid * 2] <= cp) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo > 0 && cp <= self->ranges[(lo - 1) * 2 + 1];
+}
+
+bool charclass_whole_word(charclass_t self, const uint8_t* content, size_t len, size_t so, size_t eo) {
+  uint32_t cp, neighbor;
+  if (so > 0) {
+    normalizer_decode(content + so, len - so, &cp);
+    if (charclass_contains(self, cp)) {
+      normalizer_decode_prev(content, so, &neighbor);
+      if (charclass_contains(self, neighbor)) {
+        return false;
+      }
+    }
+  }
+  if (eo < len) {
+    normalizer_decode_prev(content, eo, &cp);
+    if (charclass_contains(self, cp)) {
+      normalizer_decode(content + eo, len - eo, &neighbor);
+      if (charclass_contains(self, neighbor)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
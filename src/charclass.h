@@ -0,0 +1,44 @@
+/**
+ * charclass.h - set of characters, used to find word boundary
+ *
+ * @author James Yin <ywhjames@hotmail.com>
+ */
+#ifndef __ACTRIE_CHARCLASS_H__
+#define __ACTRIE_CHARCLASS_H__
+
+#include <alib/acom.h>
+#include <alib/string/astr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * charclass - ASCII is looked up in bitmap, other characters in sorted ranges.
+ */
+typedef struct _actrie_charclass_ {
+  uint64_t ascii[2];
+  uint32_t* ranges; /* pairs of first and last codepoint, ascending and disjoint */
+  size_t range_count;
+} charclass_s, *charclass_t;
+
+/**
+ * charclass_construct - spec is characters in UTF-8, "x-y" is range from x to y, and '-' at head or tail of spec
+ * is itself. NULL is returned if spec is not valid UTF-8 or range is reversed.
+ */
+charclass_t charclass_construct(strlen_t spec);
+void charclass_destruct(charclass_t self);
+
+bool charclass_contains(charclass_t self, uint32_t cp);
+
+/**
+ * charclass_whole_word - false if [so, eo) of content starts inside a word, or ends inside a word. side of match
+ * which is not a character of class is not checked, so "c++" is found in "c++11" but "cat" is not in "cats".
+ */
+bool charclass_whole_word(charclass_t self, const uint8_t* content, size_t len, size_t so, size_t eo);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif  // __ACTRIE_CHARCLASS_H__
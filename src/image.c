@@ -0,0 +1,118 @@
+/**
+ * image.c
+ *
+ * @author James Yin <ywhjames@hotmail.com>
+ */
+#include "image.h"
+
+bool image_write(FILE* fp, const void* data, size_t size) {
+  return size == 0 || fwrite(data, 1, size, fp) == size;
+}
+
+bool image_read(FILE* fp, void* data, size_t size) {
+  return size == 0 || fread(data, 1, size, fp) == size;
+}
+
+bool image_checksum(FILE* fp, size_t size, uint64_t* hash) {
+  unsigned char buffer[65536];
+  uint64_t h = IMAGE_HASH_SEED;
+  while (size > 0) {
+    size_t len = alib_min(size, sizeof(buffer));
+    if (fread(buffer, 1, len, fp) != len) {
+      return false;
+    }
+    h = image_hash(h, buffer, len);
+    size -= len;
+  }
+  *hash = h;
+  return true;
+}
+
+bool image_fits(FILE* fp, size_t count, size_t size) {
+  long pos = ftell(fp);
+  if (pos < 0 || fseek(fp, 0, SEEK_END) != 0) {
+    return false;
+  }
+  long end = ftell(fp);
+  if (fseek(fp, pos, SEEK_SET) != 0 || end < pos) {
+    return false;
+  }
+  return count <= (size_t)(end - pos) / size;
+}
+
+// Pointer Index
+// ========================================================
+
+static int ptr_run_cmp(const void* a, const void* b) {
+  const char* pa = ((const ptr_run_s*)a)->base;
+  const char* pb = ((const ptr_run_s*)b)->base;
+  return pa < pb ? -1 : (pa > pb ? 1 : 0);
+}
+
+ptridx_t ptridx_construct(segarray_t array) {
+  ptridx_t self = amalloc(sizeof(ptridx_s));
+  if (self == NULL) {
+    return NULL;
+  }
+
+  self->runs = NULL;
+  self->count = 0;
+  self->node_size = array->node_size;
+
+  size_t size = segarray_size(array), capacity = 0;
+  for (size_t i = 0; i < size; i++) {
+    const char* node = segarray_access(array, i);
+    if (self->count > 0) {
+      ptr_run_t last = &self->runs[self->count - 1];
+      if (last->base + last->len * self->node_size == node) {
+        last->len++;
+        continue;
+      }
+    }
+
+    if (self->count == capacity) {
+      capacity = alib_max(capacity * 2, 16);
+      ptr_run_t runs = arealloc(self->runs, capacity * sizeof(ptr_run_s));
+      if (runs == NULL) {
+        ptridx_destruct(self);
+        return NULL;
+      }
+      self->runs = runs;
+    }
+    self->runs[self->count++] = (ptr_run_s){.base = node, .start = i, .len = 1};
+  }
+
+  qsort(self->runs, self->count, sizeof(ptr_run_s), ptr_run_cmp);
+
+  return self;
+}
+
+void ptridx_destruct(ptridx_t self) {
+  if (self != NULL) {
+    afree(self->runs);
+    afree(self);
+  }
+}
+
+size_t ptridx_index(ptridx_t self, const void* ptr) {
+  const char* p = ptr;
+  size_t left = 0, right = self->count;
+  while (left < right) {  // find last run whose base <= p
+    size_t middle = (left + right) >> 1;
+    if (self->runs[middle].base <= p) {
+      left = middle + 1;
+    } else {
+      right = middle;
+    }
+  }
+  if (left == 0) {
+    return (size_t)-1;
+  }
+
+  ptr_run_t run = &self->runs[left - 1];
+  size_t offset = (size_t)(p - run->base);
+  if (offset % self->node_size != 0 || offset / self->node_size >= run->len) {
+    return (size_t)-1;
+  }
+  return run->start + offset / self->node_size;
+}
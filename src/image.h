@@ -0,0 +1,89 @@
+/**
+ * image.h - dump and load compiled matcher
+ *
+ * @author James Yin <ywhjames@hotmail.com>
+ */
+#ifndef __ACTRIE_IMAGE_H__
+#define __ACTRIE_IMAGE_H__
+
+#include <alib/acom.h>
+#include <alib/collections/list/segarray.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * image is bound to the platform which writes it: numbers are dumped in native byte order,
+ * and sizes are widened to 64 bits.
+ */
+bool image_write(FILE* fp, const void* data, size_t size);
+bool image_read(FILE* fp, void* data, size_t size);
+
+#define IMAGE_HASH_SEED 14695981039346656037ULL
+
+/**
+ * image_hash - FNV-1a, continued from hash.
+ */
+static inline uint64_t image_hash(uint64_t hash, const void* data, size_t size) {
+  const unsigned char* bytes = data;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * image_checksum - hash of next size bytes of fp, position of fp is moved over them.
+ */
+bool image_checksum(FILE* fp, size_t size, uint64_t* hash);
+
+/**
+ * image_fits - count items of size are no more than rest of fp, so count read from image is checked before it is
+ * allocated.
+ */
+bool image_fits(FILE* fp, size_t count, size_t size);
+
+static inline bool image_write_size(FILE* fp, size_t value) {
+  uint64_t v = value;
+  return image_write(fp, &v, sizeof(v));
+}
+
+static inline bool image_read_size(FILE* fp, size_t* value) {
+  uint64_t v;
+  if (!image_read(fp, &v, sizeof(v)) || v > SIZE_MAX) {
+    return false;
+  }
+  *value = (size_t)v;
+  return true;
+}
+
+/**
+ * ptridx - map pointer of node in segarray back to its index. Nodes with consecutive address
+ * are merged to one run, and runs are searched by address.
+ */
+typedef struct _image_ptr_run_ {
+  const char* base;
+  size_t start, len;
+} ptr_run_s, *ptr_run_t;
+
+typedef struct _image_ptridx_ {
+  ptr_run_t runs;
+  size_t count;
+  size_t node_size;
+} ptridx_s, *ptridx_t;
+
+ptridx_t ptridx_construct(segarray_t array);
+void ptridx_destruct(ptridx_t self);
+
+/**
+ * ptridx_index - return index of node, or (size_t)-1 if ptr is not a node of the array.
+ */
+size_t ptridx_index(ptridx_t self, const void* ptr);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif  // __ACTRIE_IMAGE_H__
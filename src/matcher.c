@@ -5,22 +5,48 @@
  */
 #include "matcher.h"
 
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <process.h>
+#define getpid _getpid
+#endif
+
+#include "charclass.h"
+#include "image.h"
+#include "normalizer.h"
 #include "parser/parser.h"
 #include "reglet/engine.h"
 #include "reglet/expr/expr.h"
 #include "trie/acdat.h"
+#include "trie/chardat.h"
+#include "utf8helper.h"
 
 typedef struct _actrie_matcher_ {
   dat_t datrie;
+  chardat_t chardat; /* built instead of datrie if char_automaton is set */
   reglet_t reglet;
-  segarray_t extra_store;
+  strpool_t extra_store;
+  normalizer_t normalizer;  /* NULL if documents are scanned as they are */
+  charclass_t word_chars;   /* NULL if keywords are not anchored at word boundary */
+  unsigned encoding;
+  size_t build_memory;      /* bytes held by construction after datrie is built, 0 if loaded from image */
+  size_t build_peak_memory; /* high-water mark of construction, 0 if loaded from image */
+  bool loaded;         /* loaded from image of compile cache */
 } matcher_s;
 
 static matcher_t matcher_alloc() {
   matcher_t matcher = amalloc(sizeof(matcher_s));
   matcher->datrie = NULL;
+  matcher->chardat = NULL;
   matcher->reglet = NULL;
   matcher->extra_store = NULL;
+  matcher->normalizer = NULL;
+  matcher->word_chars = NULL;
+  matcher->encoding = MATCHER_ENCODING_UTF8;
+  matcher->build_memory = 0;
+  matcher->build_peak_memory = 0;
+  matcher->loaded = false;
   return matcher;
 }
 
@@ -28,32 +54,23 @@ static void matcher_free(matcher_t matcher) {
   afree(matcher);
 }
 
-typedef struct _add_pattern_params_ {
-  matcher_t matcher;
-  trie_t extra_trie;
-} add_pattern_params_s, *add_pattern_params_t;
+/**
+ * matcher_sample_memory - alib has no high-water mark, so amalloc_used_memory is sampled after every pattern and
+ * every stage of construction, buffers which live inside one stage are not seen.
+ */
+static inline void matcher_sample_memory(matcher_t matcher) {
+  size_t used_memory = amalloc_used_memory();
+  if (used_memory > matcher->build_peak_memory) {
+    matcher->build_peak_memory = used_memory;
+  }
+}
 
 static void add_pattern_to_matcher(ptrn_t pattern, strlen_t extra, void* arg) {
-  add_pattern_params_t args = (add_pattern_params_t)arg;
-  dstr_t ds = NULL;
-  if (extra->len > 0) {
-    if (args->extra_trie != NULL) {
-      ds = trie_search(args->extra_trie, extra->ptr, extra->len);
-    }
-    if (ds == NULL) {
-      size_t alloced = segarray_size(args->matcher->extra_store);
-      if (segarray_extend(args->matcher->extra_store, 1) != 1) {
-        // alloc failed!!!
-        exit(-1);
-      }
-      dstr_t* dsc = (dstr_t*)segarray_access(args->matcher->extra_store, alloced);
-      ds = *dsc = dstr(extra);
-      if (args->extra_trie != NULL) {
-        trie_add_keyword(args->extra_trie, extra->ptr, extra->len, ds);
-      }
-    }
-  }
-  reglet_add_pattern(args->matcher->reglet, pattern, ds);
+  matcher_t matcher = (matcher_t)arg;
+  // extra is deduplicated by pool if need
+  strhdl_s handle = strpool_add(matcher->extra_store, extra);
+  reglet_add_pattern(matcher->reglet, pattern, handle);
+  matcher_sample_memory(matcher);
 }
 
 static void expr_list_free(void* trie, void* node) {
@@ -67,119 +84,545 @@ static void expr_list_free(void* trie, void* node) {
   _release(list);
 }
 
-static matcher_t matcher_construct(vocab_t vocab,
-                                   bool all_as_plain,
-                                   bool ignore_bad_pattern,
-                                   bool bad_as_plain,
-                                   bool deduplicate_extra) {
-  trie_t extra_trie = deduplicate_extra ? trie_alloc() : NULL;
+static void* expr_list_merge(void* older, void* newer) {
+  // prepend newer, same as adding keyword to trie
+  list_t list = (list_t)newer;
+  list->cdr = (list_t)older;
+  return list;
+}
+
+static matcher_t matcher_construct(vocab_t vocab, matcher_options_t options) {
+  // amalloc counter is process-wide, so build memory is measured as growth from here
+  size_t base_memory = amalloc_used_memory();
+
+  // normalizer works on UTF-8 only
+  bool normalize = options->normalize != 0 || (options->normalize_table != NULL && options->normalize_table->len > 0) ||
+                   (options->ignore_chars != NULL && options->ignore_chars->len > 0);
+  if (options->encoding > MATCHER_ENCODING_BIG5 || (options->encoding != MATCHER_ENCODING_UTF8 && normalize)) {
+    return NULL;
+  }
 
   // create matcher
   matcher_t matcher = matcher_alloc();
-  matcher->extra_store = segarray_construct_with_type(dstr_t);
+  matcher->encoding = options->encoding;
+  matcher->extra_store = strpool_construct(options->deduplicate_extra);
   matcher->reglet = reglet_construct();
 
+  if (normalize) {
+    matcher->normalizer = normalizer_construct((options->normalize & MATCHER_NORMALIZE_CASE) != 0,
+                                               (options->normalize & MATCHER_NORMALIZE_WIDTH) != 0,
+                                               options->normalize_table);
+    if (matcher->normalizer == NULL) {
+      matcher_destruct(matcher);
+      return NULL;
+    }
+    matcher->reglet->normalizer = matcher->normalizer;
+
+    if (options->ignore_chars != NULL && options->ignore_chars->len > 0) {
+      charclass_t ignore_chars = charclass_construct(options->ignore_chars);
+      bool succeed = ignore_chars != NULL && normalizer_ignore(matcher->normalizer, ignore_chars);
+      charclass_destruct(ignore_chars);
+      if (!succeed) {
+        matcher_destruct(matcher);
+        return NULL;
+      }
+    }
+  }
+
+  if (options->word_boundary) {
+    strlen_s default_word_chars = {.ptr = "0-9A-Za-z_", .len = 10};
+    matcher->word_chars = charclass_construct(options->word_chars != NULL ? options->word_chars : &default_word_chars);
+    if (matcher->word_chars == NULL) {
+      matcher_destruct(matcher);
+      return NULL;
+    }
+  }
+
+  // every pattern adds one keyword at least
+  dat_builder_reserve(matcher->reglet->builder, vocab_count(vocab));
+
   // load vocabulary
-  add_pattern_params_s add_pattern_args = {.matcher = matcher, .extra_trie = extra_trie};
-  if (!parse_vocab(vocab, add_pattern_to_matcher, &add_pattern_args, all_as_plain, ignore_bad_pattern, bad_as_plain)) {
-    trie_free(matcher->reglet->trie, (trie_node_free_f)expr_list_free);
-    matcher->reglet->trie = NULL;
+  if (!parse_vocab(vocab, add_pattern_to_matcher, matcher, options->all_as_plain, options->ignore_bad_pattern,
+                   options->bad_as_plain)) {
+    dat_builder_destruct(matcher->reglet->builder, (dat_builder_free_f)expr_list_free);
+    matcher->reglet->builder = NULL;
     matcher_destruct(matcher);
     return NULL;
   }
 
-  // build datrie by reglet->trie
-  trie_sort_to_bfs(matcher->reglet->trie);
-  matcher->datrie = dat_construct_by_trie(matcher->reglet->trie, true);
-  // then, free reglet->trie
-  trie_free(matcher->reglet->trie, NULL);
-  matcher->reglet->trie = NULL;
+  // all extras are added, drop hash index of extras before datrie grows
+  matcher_sample_memory(matcher);
+  strpool_seal(matcher->extra_store);
 
-  // free extra_trie
-  if (extra_trie) {
-    trie_free(extra_trie, NULL);
+  // build datrie from sorted keywords directly, linked trie is skipped
+  if (options->char_automaton && matcher->encoding == MATCHER_ENCODING_UTF8) {
+    matcher->chardat = chardat_construct_by_builder(matcher->reglet->builder, expr_list_merge);
   }
+  if (matcher->chardat == NULL) {
+    matcher->datrie = dat_construct_by_builder(matcher->reglet->builder, expr_list_merge, true);
+  }
+
+  // builder and datrie are both alive here
+  size_t used_memory = amalloc_used_memory();
+  matcher->build_memory = used_memory > base_memory ? used_memory - base_memory : 0;
+  matcher_sample_memory(matcher);
+  matcher->build_peak_memory = matcher->build_peak_memory > base_memory ? matcher->build_peak_memory - base_memory : 0;
+
+  // then, free reglet->builder
+  dat_builder_destruct(matcher->reglet->builder, NULL);
+  matcher->reglet->builder = NULL;
 
   return matcher;
 }
 
-matcher_t matcher_construct_by_file(const char* path,
-                                    bool all_as_plain,
-                                    bool ignore_bad_pattern,
-                                    bool bad_as_plain,
-                                    bool deduplicate_extra) {
+matcher_t matcher_construct_by_file_with_options(const char* path, matcher_options_t options) {
   vocab_t vocab = vocab_construct(stream_type_file, (void*)path);
   if (vocab == NULL) {
     return NULL;
   }
 
-  matcher_t matcher = matcher_construct(vocab, all_as_plain, ignore_bad_pattern, bad_as_plain, deduplicate_extra);
+  matcher_t matcher = matcher_construct(vocab, options);
+  vocab_destruct(vocab);
+  return matcher;
+}
+
+matcher_t matcher_construct_by_string_with_options(strlen_t string, matcher_options_t options) {
+  vocab_t vocab = vocab_construct(stream_type_string, string);
+  matcher_t matcher = matcher_construct(vocab, options);
   vocab_destruct(vocab);
   return matcher;
 }
 
+matcher_t matcher_construct_by_array_with_options(const strlen_s* keywords,
+                                                  const strlen_s* extras,
+                                                  size_t n,
+                                                  matcher_options_t options) {
+  vocab_t vocab = vocab_construct_by_array(keywords, extras, n);
+  if (vocab == NULL) {
+    return NULL;
+  }
+
+  matcher_t matcher = matcher_construct(vocab, options);
+  vocab_destruct(vocab);
+  return matcher;
+}
+
+matcher_t matcher_construct_by_file(const char* path,
+                                    bool all_as_plain,
+                                    bool ignore_bad_pattern,
+                                    bool bad_as_plain,
+                                    bool deduplicate_extra) {
+  matcher_options_s options = {.all_as_plain = all_as_plain,
+                               .ignore_bad_pattern = ignore_bad_pattern,
+                               .bad_as_plain = bad_as_plain,
+                               .deduplicate_extra = deduplicate_extra};
+  return matcher_construct_by_file_with_options(path, &options);
+}
+
 matcher_t matcher_construct_by_string(strlen_t string,
                                       bool all_as_plain,
                                       bool ignore_bad_pattern,
                                       bool bad_as_plain,
                                       bool deduplicate_extra) {
-  vocab_t vocab = vocab_construct(stream_type_string, string);
-  matcher_t matcher = matcher_construct(vocab, all_as_plain, ignore_bad_pattern, bad_as_plain, deduplicate_extra);
-  vocab_destruct(vocab);
-  return matcher;
+  matcher_options_s options = {.all_as_plain = all_as_plain,
+                               .ignore_bad_pattern = ignore_bad_pattern,
+                               .bad_as_plain = bad_as_plain,
+                               .deduplicate_extra = deduplicate_extra};
+  return matcher_construct_by_string_with_options(string, &options);
+}
+
+matcher_t matcher_construct_by_array(const strlen_s* keywords,
+                                     const strlen_s* extras,
+                                     size_t n,
+                                     bool all_as_plain,
+                                     bool ignore_bad_pattern,
+                                     bool bad_as_plain,
+                                     bool deduplicate_extra) {
+  matcher_options_s options = {.all_as_plain = all_as_plain,
+                               .ignore_bad_pattern = ignore_bad_pattern,
+                               .bad_as_plain = bad_as_plain,
+                               .deduplicate_extra = deduplicate_extra};
+  return matcher_construct_by_array_with_options(keywords, extras, n, &options);
+}
+
+// Compile Cache
+// ========================================================
+
+#define MATCHER_IMAGE_VERSION 2
+
+typedef struct _actrie_matcher_image_header_ {
+  char magic[8];
+  uint32_t version;
+  uint32_t node_size; /* layout of datrie is bound to size of node */
+  uint64_t key;
+  uint64_t body_len; /* bytes after header */
+  uint64_t checksum; /* image_hash of body */
+} matcher_image_header_s;
+
+static const char matcher_image_magic[8] = {'A', 'C', 'T', 'R', 'I', 'E', 'I', 'M'};
+
+/**
+ * key of cache is FNV-1a of dictionary, with construct flags mixed in.
+ */
+static bool matcher_cache_key(const char* path, bool flags[4], uint64_t* key) {
+  FILE* fp = fopen(path, "rb");
+  if (fp == NULL) {
+    return false;
+  }
+
+  uint64_t hash = IMAGE_HASH_SEED;
+  unsigned char buffer[65536];
+  size_t len;
+  while ((len = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+    hash = image_hash(hash, buffer, len);
+  }
+  bool failed = ferror(fp) != 0;
+  fclose(fp);
+
+  for (size_t i = 0; i < 4; i++) {
+    hash ^= flags[i] ? 0x80 + i : i;
+    hash *= 1099511628211ULL;
+  }
+
+  *key = hash;
+  return !failed;
+}
+
+static bool matcher_dump_body(matcher_t matcher, FILE* fp) {
+  if (!strpool_dump(matcher->extra_store, fp)) {
+    return false;
+  }
+
+  // lists of expressions are dumped in order of value_array
+  segarray_t value_array = matcher->datrie->value_array;
+  size_t value_count = segarray_size(value_array);
+  void** value_list = amalloc(alib_max(value_count, 1) * sizeof(void*));
+  if (value_list == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < value_count; i++) {
+    value_list[i] = ((dat_value_t)segarray_access(value_array, i))->value;
+  }
+  bool succeed = reglet_dump(matcher->reglet, value_list, value_count, fp) && dat_dump(matcher->datrie, fp);
+  afree(value_list);
+
+  return succeed;
+}
+
+/**
+ * matcher_dump_image - header is written again when body is done, with length and checksum read back from fp.
+ */
+static bool matcher_dump_image(matcher_t matcher, uint64_t key, FILE* fp) {
+  if (matcher->datrie == NULL) {
+    return false;
+  }
+
+  matcher_image_header_s header = {.version = MATCHER_IMAGE_VERSION, .node_size = sizeof(dat_node_s), .key = key};
+  memcpy(header.magic, matcher_image_magic, sizeof(header.magic));
+  if (!image_write(fp, &header, sizeof(header)) || !matcher_dump_body(matcher, fp)) {
+    return false;
+  }
+
+  long end = ftell(fp);
+  if (end < (long)sizeof(header) || fseek(fp, sizeof(header), SEEK_SET) != 0) {
+    return false;
+  }
+  header.body_len = (uint64_t)end - sizeof(header);
+  return image_checksum(fp, header.body_len, &header.checksum) && fseek(fp, 0, SEEK_SET) == 0 &&
+         image_write(fp, &header, sizeof(header));
+}
+
+/**
+ * matcher_image_check_keyword - start of keyword is end of match minus its len, and the end is not less than depth
+ * of node where the keyword is matched.
+ */
+static bool matcher_image_check_keyword(void* value, size_t depth) {
+  for (list_t con = value; con != NULL; con = con->cdr) {
+    if (container_of(_(list, con, car), expr_text_s, header)->len > depth) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * matcher_load_image - body is verified by length and checksum before it is parsed, and parts of it are checked
+ * against each other while loading, so a broken image is dropped instead of read out of bounds.
+ */
+static matcher_t matcher_load_image(uint64_t key, FILE* fp) {
+  matcher_image_header_s header;
+  uint64_t checksum;
+  if (!image_read(fp, &header, sizeof(header)) || memcmp(header.magic, matcher_image_magic, sizeof(header.magic)) ||
+      header.version != MATCHER_IMAGE_VERSION || header.node_size != sizeof(dat_node_s) || header.key != key ||
+      header.body_len > SIZE_MAX || !image_checksum(fp, header.body_len, &checksum) ||
+      checksum != header.checksum || fgetc(fp) != EOF || fseek(fp, sizeof(header), SEEK_SET) != 0) {
+    return NULL;
+  }
+
+  matcher_t matcher = matcher_alloc();
+  void** value_list = NULL;
+  size_t value_count = 0;
+
+  do {
+    matcher->extra_store = strpool_load(fp);
+    if (matcher->extra_store == NULL) {
+      break;
+    }
+
+    matcher->reglet = reglet_load(fp, matcher->extra_store->size, &value_list, &value_count);
+    if (matcher->reglet == NULL) {
+      break;
+    }
+
+    matcher->datrie = dat_load(fp, value_list, value_count, matcher_image_check_keyword);
+    if (matcher->datrie == NULL) {
+      for (size_t i = 0; i < value_count; i++) {
+        expr_list_free(NULL, value_list[i]);
+      }
+      break;
+    }
+    afree(value_list);
+    value_list = NULL;
+
+    // body is consumed exactly
+    if (ftell(fp) != (long)(sizeof(header) + header.body_len)) {
+      break;
+    }
+
+    matcher->loaded = true;
+    return matcher;
+  } while (0);
+
+  afree(value_list);
+  matcher_destruct(matcher);
+  return NULL;
+}
+
+static size_t matcher_cache_temp_count = 0;
+
+/**
+ * matcher_cache_temp_suffix - pid tells processes apart, and address of suffix, which is on stack of caller, tells
+ * running threads apart. the counter is not atomic, it only tells calls of same thread apart.
+ */
+static void matcher_cache_temp_suffix(char* suffix, size_t len) {
+  snprintf(suffix, len, ".%ld.%llx.%zu.tmp", (long)getpid(), (unsigned long long)(uintptr_t)suffix,
+           matcher_cache_temp_count++);
 }
 
-static void extra_store_free(segarray_t extra_store) {
-  if (extra_store != NULL) {
-    size_t store_size = segarray_size(extra_store);
-    for (size_t idx = 0; idx < store_size; idx++) {
-      dstr_t ds = *(dstr_t*)segarray_access(extra_store, idx);
-      _release(ds);
+static char* matcher_cache_path(const char* cache_dir, uint64_t key, const char* suffix) {
+  size_t len = strlen(cache_dir) + strlen(suffix) + 64;
+  char* path = amalloc(len);
+  if (path != NULL) {
+    snprintf(path, len, "%s/%016llx.actrie%s", cache_dir, (unsigned long long)key, suffix);
+  }
+  return path;
+}
+
+matcher_t matcher_construct_by_file_with_cache(const char* path,
+                                               const char* cache_dir,
+                                               bool all_as_plain,
+                                               bool ignore_bad_pattern,
+                                               bool bad_as_plain,
+                                               bool deduplicate_extra) {
+  bool flags[4] = {all_as_plain, ignore_bad_pattern, bad_as_plain, deduplicate_extra};
+  uint64_t key;
+  if (cache_dir == NULL || !matcher_cache_key(path, flags, &key)) {
+    return matcher_construct_by_file(path, all_as_plain, ignore_bad_pattern, bad_as_plain, deduplicate_extra);
+  }
+
+  char* image_path = matcher_cache_path(cache_dir, key, "");
+  if (image_path == NULL) {
+    return NULL;
+  }
+
+  // hit
+  FILE* fp = fopen(image_path, "rb");
+  if (fp != NULL) {
+    matcher_t matcher = matcher_load_image(key, fp);
+    fclose(fp);
+    if (matcher != NULL) {
+      afree(image_path);
+      return matcher;
     }
-    segarray_destruct(extra_store);
   }
+
+  // miss, build and write image through temporary file, so that readers never see a partial image
+  matcher_t matcher =
+      matcher_construct_by_file(path, all_as_plain, ignore_bad_pattern, bad_as_plain, deduplicate_extra);
+  if (matcher != NULL) {
+    char suffix[64];
+    matcher_cache_temp_suffix(suffix, sizeof(suffix));
+    char* temp_path = matcher_cache_path(cache_dir, key, suffix);
+    // image is read back for checksum
+    fp = temp_path != NULL ? fopen(temp_path, "w+b") : NULL;
+    if (fp != NULL) {
+      bool succeed = matcher_dump_image(matcher, key, fp);
+      succeed = fclose(fp) == 0 && succeed;
+      if (!succeed || rename(temp_path, image_path) != 0) {
+        remove(temp_path);
+      }
+    }
+    afree(temp_path);
+  }
+
+  afree(image_path);
+  return matcher;
+}
+
+unsigned matcher_encoding(matcher_t matcher) {
+  return matcher->encoding;
+}
+
+size_t matcher_build_memory(matcher_t matcher) {
+  return matcher->build_memory;
+}
+
+size_t matcher_build_peak_memory(matcher_t matcher) {
+  return matcher->build_peak_memory;
+}
+
+bool matcher_loaded_from_image(matcher_t matcher) {
+  return matcher->loaded;
+}
+
+void matcher_stats(matcher_t matcher, matcher_stats_t stats) {
+  dat_stats_s trie_stats = {.depth_histogram = stats->depth_histogram, .depth_buckets = MATCHER_STATS_DEPTH_BUCKETS};
+  if (matcher->chardat != NULL) {
+    chardat_stats(matcher->chardat, &trie_stats);
+    stats->node_bytes = trie_stats.node_count * sizeof(chardat_node_s);
+  } else {
+    dat_stats(matcher->datrie, &trie_stats);
+    stats->node_bytes = trie_stats.node_count * sizeof(dat_node_s);
+  }
+  stats->node_count = trie_stats.node_count;
+  stats->node_used = trie_stats.node_used;
+  stats->node_pad = trie_stats.node_pad;
+  stats->fill_ratio = trie_stats.node_count > 0 ? (double)trie_stats.node_used / trie_stats.node_count : 0;
+  stats->value_count = trie_stats.value_count;
+  stats->failed_chain_avg = trie_stats.node_used > 0 ? (double)trie_stats.failed_chain_total / trie_stats.node_used : 0;
+  stats->failed_chain_max = trie_stats.failed_chain_max;
+
+  reglet_t reglet = matcher->reglet;
+  stats->expr_text = reglet->expr_count[reg_expr_type_text];
+  stats->expr_dist = reglet->expr_count[reg_expr_type_dist];
+  stats->expr_ambi = reglet->expr_count[reg_expr_type_ambi];
+  stats->expr_anto = reglet->expr_count[reg_expr_type_anto];
+  stats->expr_pass = reglet->expr_count[reg_expr_type_pass];
+  stats->expr_output = reglet->expr_count[reg_expr_type_output];
+  stats->expr_bytes = 0;
+  for (size_t i = 0; i < reg_expr_type_count; i++) {
+    stats->expr_bytes += reglet->expr_count[i] * reglet->expr_size;
+  }
+
+  stats->extra_used = matcher->extra_store->size;
+  stats->extra_bytes = matcher->extra_store->borrowed ? 0 : matcher->extra_store->capacity;
+
+  stats->build_memory = matcher->build_memory;
+  stats->build_peak_memory = matcher->build_peak_memory;
 }
 
 void matcher_destruct(matcher_t matcher) {
   if (matcher != NULL) {
     dat_destruct(matcher->datrie, (dat_node_free_f)expr_list_free);
+    chardat_destruct(matcher->chardat, (chardat_value_free_f)expr_list_free);
     reglet_destruct(matcher->reglet);
-    extra_store_free(matcher->extra_store);
+    strpool_destruct(matcher->extra_store);
+    normalizer_destruct(matcher->normalizer);
+    charclass_destruct(matcher->word_chars);
     matcher_free(matcher);
   }
 }
 
+#define MATCHER_NORMALIZE_CHUNK 4096
+
 typedef struct _actrie_context_ {
   strlen_s content;
+  strpool_t extra_store;
   reg_ctx_t reg_ctx;
   dat_ctx_t dat_ctx;
+  chardat_ctx_t char_ctx; /* one of dat_ctx and char_ctx is allocated, same as matcher */
   word_s matched_word;
+
+  // normalized text is produced chunk by chunk while scanning, so content is never copied as a whole
+  normalizer_t normalizer;
+  uint8_t* norm_text;
+  size_t* norm_ends; /* offset in content after the character of norm_text[i-1] */
+  size_t norm_source; /* offset in content where next chunk starts */
+
+  charclass_t word_chars;
+  utf8_ctx_t legacy_map; /* chars of content in legacy encoding, NULL for UTF-8 */
+
+  bool utf16; /* content is UTF-16 code units, scanned by char_ctx */
+  bool cesu;
 } context_s;
 
 static context_t context_alloc() {
   context_t context = amalloc(sizeof(context_s));
   context->content.ptr = NULL;
   context->content.len = 0;
+  context->extra_store = NULL;
   context->reg_ctx = NULL;
   context->dat_ctx = NULL;
+  context->char_ctx = NULL;
+  context->normalizer = NULL;
+  context->norm_text = NULL;
+  context->norm_ends = NULL;
+  context->norm_source = 0;
+  context->word_chars = NULL;
+  context->legacy_map = NULL;
+  context->utf16 = false;
+  context->cesu = false;
   return context;
 }
 
 static void context_free(context_t context) {
+  afree(context->norm_text);
+  afree(context->norm_ends);
   afree(context);
 }
 
+static size_t matcher_normalized_start_pos(size_t eo, size_t len, void* arg) {
+  context_t context = (context_t)arg;
+  return normalizer_rewind(context->normalizer, (uint8_t*)context->content.ptr, eo, len);
+}
+
 context_t matcher_alloc_context(matcher_t matcher) {
   context_t context = context_alloc();
-  context->dat_ctx = dat_alloc_context(matcher->datrie);
+  context->extra_store = matcher->extra_store;
+  if (matcher->chardat != NULL) {
+    context->char_ctx = chardat_alloc_context(matcher->chardat);
+  } else {
+    context->dat_ctx = dat_alloc_context(matcher->datrie);
+  }
   context->reg_ctx = reglet_alloc_context(matcher->reglet);
+  context->word_chars = matcher->word_chars;
+  if (matcher->encoding != MATCHER_ENCODING_UTF8) {
+    context->legacy_map = alloc_utf8_context();
+    if (context->legacy_map == NULL) {
+      matcher_free_context(context);
+      return NULL;
+    }
+    context->legacy_map->encoding = matcher->encoding;
+  }
+  if (matcher->normalizer != NULL) {
+    context->normalizer = matcher->normalizer;
+    context->norm_text = amalloc(MATCHER_NORMALIZE_CHUNK + 4);
+    context->norm_ends = amalloc((MATCHER_NORMALIZE_CHUNK + 5) * sizeof(size_t));
+    if (context->norm_text == NULL || context->norm_ends == NULL) {
+      matcher_free_context(context);
+      return NULL;
+    }
+    reglet_start_pos(context->reg_ctx, matcher_normalized_start_pos, context);
+  }
   return context;
 }
 
 void matcher_free_context(context_t context) {
   if (context != NULL) {
     dat_free_context(context->dat_ctx);
+    chardat_free_context(context->char_ctx);
     reglet_free_context(context->reg_ctx);
+    free_utf8_context(context->legacy_map);
     context_free(context);
   }
 }
@@ -188,29 +631,189 @@ void matcher_fix_pos(context_t context, fix_pos_f fix_pos_func, void* fix_pos_ar
   reglet_fix_pos(context->reg_ctx, fix_pos_func, fix_pos_arg);
 }
 
-void matcher_reset_context(context_t context, char content[], size_t len) {
+// scan on datrie or chardat, which one is built by matcher
+// ========================================================
+
+static void matcher_scan_reset(context_t context, char content[], size_t len, bool refill) {
+  if (context->char_ctx != NULL) {
+    if (refill) {
+      chardat_refill_context(context->char_ctx, content, len);
+    } else {
+      chardat_reset_context(context->char_ctx, content, len);
+    }
+  } else {
+    if (refill) {
+      dat_refill_context(context->dat_ctx, content, len);
+    } else {
+      dat_reset_context(context->dat_ctx, content, len);
+    }
+  }
+}
+
+static inline bool matcher_scan_next(context_t context, bool prefix) {
+  if (context->char_ctx != NULL) {
+    if (context->utf16) {
+      return prefix ? chardat_ac_prefix_next_on_unit(context->char_ctx) : chardat_ac_next_on_unit(context->char_ctx);
+    }
+    return prefix ? chardat_ac_prefix_next_on_char(context->char_ctx) : chardat_ac_next_on_char(context->char_ctx);
+  }
+  return prefix ? dat_ac_prefix_next_on_node(context->dat_ctx) : dat_ac_next_on_node(context->dat_ctx);
+}
+
+static inline bool matcher_scan_end(context_t context) {
+  return context->char_ctx != NULL ? chardat_match_end(context->char_ctx) : dat_match_end(context->dat_ctx);
+}
+
+static inline size_t matcher_scan_read(context_t context) {
+  return context->char_ctx != NULL ? context->char_ctx->_read : context->dat_ctx->_read;
+}
+
+static inline list_t matcher_scan_value(context_t context) {
+  return context->char_ctx != NULL ? chardat_matched_value(context->char_ctx) : dat_matched_value(context->dat_ctx);
+}
+
+static size_t matcher_normalize_chunk(context_t context) {
+  return normalizer_fill(context->normalizer, (uint8_t*)context->content.ptr, context->content.len,
+                         &context->norm_source, context->norm_text, MATCHER_NORMALIZE_CHUNK, context->norm_ends);
+}
+
+bool matcher_reset_context(context_t context, char content[], size_t len) {
+  if (context->legacy_map != NULL && !reset_utf8_context(context->legacy_map, content, len)) {
+    return false;
+  }
+  if (context->utf16) {
+    // start offset is eo - len again, contexts that scan units have no normalizer
+    context->utf16 = false;
+    reglet_start_pos(context->reg_ctx, NULL, NULL);
+  }
   context->content = (strlen_s){.ptr = content, .len = len};
-  dat_reset_context(context->dat_ctx, content, len);
+  if (context->normalizer != NULL) {
+    context->norm_source = 0;
+    size_t chunk_len = matcher_normalize_chunk(context);
+    matcher_scan_reset(context, (char*)context->norm_text, chunk_len, false);
+  } else {
+    matcher_scan_reset(context, content, len, false);
+  }
   reglet_reset_context(context->reg_ctx, content, len);
+  return true;
+}
+
+bool matcher_scan_utf16(matcher_t matcher) {
+  return matcher->chardat != NULL && matcher->normalizer == NULL && matcher->word_chars == NULL;
+}
+
+/**
+ * matcher_utf16_start_pos - walk back units until UTF-8 length of characters is len, the keyword was matched by the
+ * same characters, so the walk stops at a boundary.
+ */
+static size_t matcher_utf16_start_pos(size_t eo, size_t len, void* arg) {
+  context_t context = (context_t)arg;
+  const uint16_t* units = (const uint16_t*)context->content.ptr;
+  size_t so = eo, bytes = 0;
+  while (bytes < len && so > 0) {
+    uint16_t unit = units[--so];
+    if (!context->cesu && unit >= 0xDC00 && unit < 0xE000 && so > 0 && units[so - 1] >= 0xD800 &&
+        units[so - 1] < 0xDC00) {
+      so--;
+      bytes += 4;
+    } else {
+      bytes += unit < 0x80 ? 1 : (unit < 0x800 ? 2 : 3);
+    }
+  }
+  return so;
+}
+
+bool matcher_reset_context_utf16(context_t context, const uint16_t content[], size_t len, bool cesu) {
+  if (context->char_ctx == NULL || context->normalizer != NULL || context->word_chars != NULL ||
+      context->legacy_map != NULL) {
+    return false;
+  }
+  context->content = (strlen_s){.ptr = (char*)content, .len = len};
+  context->utf16 = true;
+  context->cesu = cesu;
+  chardat_reset_context_utf16(context->char_ctx, content, len, cesu);
+  reglet_reset_context_utf16(context->reg_ctx, content, len);
+  reglet_start_pos(context->reg_ctx, matcher_utf16_start_pos, context);
+  return true;
+}
+
+utf8_ctx_t matcher_char_map(context_t context) {
+  return context->legacy_map;
 }
 
-typedef bool (*dat_next_on_node_f)(dat_ctx_t ctx);
+static bool matcher_scan_next_chunked(context_t context, bool prefix) {
+  while (!matcher_scan_next(context, prefix)) {
+    // refill only if chunk is exhausted, prefix matching may stop in middle of chunk
+    if (context->normalizer == NULL || context->norm_source >= context->content.len || !matcher_scan_end(context)) {
+      return false;
+    }
+    size_t chunk_len = matcher_normalize_chunk(context);
+    matcher_scan_reset(context, (char*)context->norm_text, chunk_len, true);
+  }
+  return true;
+}
 
-static word_t matcher_next0(context_t context, dat_next_on_node_f dat_next_on_node_func) {
+static inline bool matcher_legacy_word_char(context_t context, size_t pos) {
+  uint8_t c = (uint8_t)context->content.ptr[pos];
+  return c < 0x80 && charclass_contains(context->word_chars, c);
+}
+
+/**
+ * matcher_legacy_whole_word - only ASCII is classified, multibyte characters can not be decoded without code page.
+ */
+static bool matcher_legacy_whole_word(context_t context, size_t so, size_t eo) {
+  if (so > 0 && matcher_legacy_word_char(context, so) && matcher_legacy_word_char(context, so - 1) &&
+      is_utf8_lead(context->legacy_map, so - 1)) {
+    return false;
+  }
+  if (eo < context->content.len && matcher_legacy_word_char(context, eo) && matcher_legacy_word_char(context, eo - 1) &&
+      is_utf8_lead(context->legacy_map, eo - 1)) {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * matcher_keep_keyword - exprs in list share one keyword, so it is checked once for all of them.
+ */
+static bool matcher_keep_keyword(context_t context, expr_t expr, size_t eo) {
+  size_t len = container_of(expr, expr_text_s, header)->len;
+  if (context->legacy_map != NULL) {
+    // bytes of keyword may appear from trail byte of a character in legacy encoding
+    size_t so = eo - len;
+    if (!is_utf8_lead(context->legacy_map, so) ||
+        (eo < context->content.len && !is_utf8_lead(context->legacy_map, eo))) {
+      return false;
+    }
+    return context->word_chars == NULL || matcher_legacy_whole_word(context, so, eo);
+  }
+  size_t so = context->normalizer != NULL
+                  ? normalizer_rewind(context->normalizer, (uint8_t*)context->content.ptr, eo, len)
+                  : eo - len;
+  return charclass_whole_word(context->word_chars, (uint8_t*)context->content.ptr, context->content.len, so, eo);
+}
+
+static word_t matcher_next0(context_t context, bool prefix) {
   // 不保证输出有序
-  pos_cache_t matched = prique_pop(context->reg_ctx->output_queue);
+  pos_cache_t matched = output_queue_pop(&context->reg_ctx->output_queue);
   if (matched == NULL) {
-    while (dat_next_on_node_func(context->dat_ctx)) {
-      list_t expr_list = dat_matched_value(context->dat_ctx);
+    while (matcher_scan_next_chunked(context, prefix)) {
+      list_t expr_list = matcher_scan_value(context);
+      // datrie only output end offset, and set start offset in expr_text
+      size_t eo =
+          context->normalizer != NULL ? context->norm_ends[matcher_scan_read(context)] : matcher_scan_read(context);
+      if ((context->word_chars != NULL || context->legacy_map != NULL) &&
+          !matcher_keep_keyword(context, _(list, expr_list, car), eo)) {
+        continue;
+      }
       while (expr_list != NULL) {
         expr_t expr = _(list, expr_list, car);
-        pos_cache_t pos_cache = dynapool_alloc_node(context->reg_ctx->pos_cache_pool);
-        // datrie only output end offset, and set start offset in expr_text
-        pos_cache->pos.eo = context->dat_ctx->_read;
+        pos_cache_t pos_cache = arena_pool_alloc_node(context->reg_ctx->pos_cache_pool);
+        pos_cache->pos.eo = eo;
         expr_feed_text(expr, pos_cache, context->reg_ctx);
         expr_list = _(list, expr_list, cdr);
       }
-      matched = prique_pop(context->reg_ctx->output_queue);
+      matched = output_queue_pop(&context->reg_ctx->output_queue);
       if (matched != NULL) {
         break;
       }
@@ -218,28 +821,25 @@ static word_t matcher_next0(context_t context, dat_next_on_node_f dat_next_on_no
   }
   if (matched == NULL) {
     reglet_activate_expr_ctx(context->reg_ctx);
-    matched = prique_pop(context->reg_ctx->output_queue);
+    matched = output_queue_pop(&context->reg_ctx->output_queue);
   }
   if (matched != NULL) {
     // matche pattern, output
-    context->matched_word.keyword =
-        (strlen_s){.ptr = context->content.ptr + matched->pos.so, .len = matched->pos.eo - matched->pos.so};
-    if (matched->embed.extra != NULL) {
-      context->matched_word.extra = (strlen_s){.ptr = matched->embed.extra->str, .len = matched->embed.extra->len};
-    } else {
-      context->matched_word.extra = strlen_empty;
-    }
+    size_t unit_size = context->utf16 ? sizeof(uint16_t) : 1;
+    context->matched_word.keyword = (strlen_s){.ptr = context->content.ptr + matched->pos.so * unit_size,
+                                               .len = (matched->pos.eo - matched->pos.so) * unit_size};
+    context->matched_word.extra = strpool_get(context->extra_store, *matched->embed.output.extra);
     context->matched_word.pos = matched->pos;
-    dynapool_free_node(context->reg_ctx->pos_cache_pool, matched);
+    arena_pool_free_node(context->reg_ctx->pos_cache_pool, matched);
     return &context->matched_word;
   }
   return NULL;
 }
 
 word_t matcher_next(context_t context) {
-  return matcher_next0(context, dat_ac_next_on_node);
+  return matcher_next0(context, false);
 }
 
 word_t matcher_next_prefix(context_t context) {
-  return matcher_next0(context, dat_ac_prefix_next_on_node);
+  return matcher_next0(context, true);
 }
@@ -0,0 +1,269 @@
+/**
+ * normalizer.c
+ *
+ * @author James Yin <ywhjames@hotmail.com>
+ */
+#include "normalizer.h"
+
+static bool normalizer_set(normalizer_t self, uint32_t from, uint32_t to) {
+  uint32_t** page = &self->pages[from >> NORMALIZER_PAGE_SHIFT];
+  if (*page == NULL) {
+    *page = amalloc(NORMALIZER_PAGE_SIZE * sizeof(uint32_t));
+    if (*page == NULL) {
+      return false;
+    }
+    // identity for the rest of page
+    uint32_t base = from & ~(uint32_t)(NORMALIZER_PAGE_SIZE - 1);
+    for (uint32_t i = 0; i < NORMALIZER_PAGE_SIZE; i++) {
+      (*page)[i] = base + i;
+    }
+    self->page_used++;
+  }
+  (*page)[from & (NORMALIZER_PAGE_SIZE - 1)] = to;
+  return true;
+}
+
+/**
+ * one character per side, and line ends with '\n' or "\r\n".
+ */
+static bool normalizer_load_table(normalizer_t self, strlen_t table) {
+  const uint8_t* ptr = (const uint8_t*)table->ptr;
+  size_t len = table->len, i = 0;
+  while (i < len) {
+    if (ptr[i] == '\n' || ptr[i] == '\r') {
+      i++;
+      continue;
+    }
+
+    uint32_t from, to;
+    i += normalizer_decode(ptr + i, len - i, &from);
+    if (from >= NORMALIZER_RAW || i >= len || ptr[i] != '\t') {
+      return false;
+    }
+    i++;
+    if (i >= len) {
+      return false;
+    }
+    i += normalizer_decode(ptr + i, len - i, &to);
+    if (to >= NORMALIZER_RAW || (i < len && ptr[i] != '\n' && ptr[i] != '\r')) {
+      return false;
+    }
+
+    // target is folded too, so that the result is stable
+    if (!normalizer_set(self, from, normalizer_map(self, to))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+normalizer_t normalizer_construct(bool fold_case, bool fold_width, strlen_t table) {
+  normalizer_t self = amalloc(sizeof(normalizer_s));
+  if (self == NULL) {
+    return NULL;
+  }
+  memset(self->pages, 0, sizeof(self->pages));
+  self->page_used = 0;
+
+  bool succeed = true;
+  if (fold_case) {
+    for (uint32_t c = 'A'; c <= 'Z'; c++) {
+      succeed = succeed && normalizer_set(self, c, c + ('a' - 'A'));
+    }
+  }
+  if (fold_width) {
+    // full-width forms of ASCII, and ideographic space
+    for (uint32_t c = 0xFF01; c <= 0xFF5E; c++) {
+      uint32_t half = c - 0xFEE0;
+      if (fold_case && half >= 'A' && half <= 'Z') {
+        half += 'a' - 'A';
+      }
+      succeed = succeed && normalizer_set(self, c, half);
+    }
+    succeed = succeed && normalizer_set(self, 0x3000, ' ');
+  }
+  if (succeed && table != NULL && table->len > 0) {
+    succeed = normalizer_load_table(self, table);
+  }
+
+  if (!succeed) {
+    normalizer_destruct(self);
+    return NULL;
+  }
+  return self;
+}
+
+void normalizer_destruct(normalizer_t self) {
+  if (self != NULL) {
+    for (size_t i = 0; i < NORMALIZER_PAGE_COUNT; i++) {
+      afree(self->pages[i]);
+    }
+    afree(self);
+  }
+}
+
+bool normalizer_ignore(normalizer_t self, charclass_t chars) {
+  // targets of table are dropped first, pages created below are checked again but only map to themselves
+  for (size_t p = 0; p < NORMALIZER_PAGE_COUNT; p++) {
+    uint32_t* page = self->pages[p];
+    for (size_t i = 0; page != NULL && i < NORMALIZER_PAGE_SIZE; i++) {
+      if (page[i] != NORMALIZER_DROP && charclass_contains(chars, page[i])) {
+        page[i] = NORMALIZER_DROP;
+      }
+    }
+  }
+
+  for (uint32_t c = 0; c < 128; c++) {
+    if (charclass_contains(chars, c) && !normalizer_set(self, c, NORMALIZER_DROP)) {
+      return false;
+    }
+  }
+  for (size_t r = 0; r < chars->range_count; r++) {
+    for (uint32_t c = chars->ranges[r * 2]; c <= chars->ranges[r * 2 + 1] && c < NORMALIZER_RAW; c++) {
+      if (!normalizer_set(self, c, NORMALIZER_DROP)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+size_t normalizer_decode(const uint8_t* src, size_t len, uint32_t* cp) {
+  uint8_t lead = src[0];
+  if (lead < 0x80) {
+    *cp = lead;
+    return 1;
+  }
+
+  size_t n = 0;
+  uint32_t c = 0, min = 0;
+  if ((lead & 0xE0) == 0xC0) {
+    n = 2;
+    c = lead & 0x1F;
+    min = 0x80;
+  } else if ((lead & 0xF0) == 0xE0) {
+    n = 3;
+    c = lead & 0x0F;
+    min = 0x800;
+  } else if ((lead & 0xF8) == 0xF0) {
+    n = 4;
+    c = lead & 0x07;
+    min = 0x10000;
+  }
+
+  bool valid = n > 0 && n <= len;
+  for (size_t i = 1; valid && i < n; i++) {
+    valid = (src[i] & 0xC0) == 0x80;
+    c = (c << 6) | (src[i] & 0x3F);
+  }
+  // overlong form is not canonical, so it is kept as raw bytes
+  if (!valid || c < min || c >= NORMALIZER_RAW) {
+    *cp = NORMALIZER_RAW + lead;
+    return 1;
+  }
+
+  *cp = c;
+  return n;
+}
+
+static inline size_t normalizer_encoded_len(uint32_t cp) {
+  return cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : cp < NORMALIZER_RAW ? 4 : cp == NORMALIZER_DROP ? 0 : 1;
+}
+
+size_t normalizer_encode(uint32_t cp, uint8_t* dst) {
+  if (cp < 0x80) {
+    dst[0] = (uint8_t)cp;
+    return 1;
+  } else if (cp < 0x800) {
+    dst[0] = (uint8_t)(0xC0 | (cp >> 6));
+    dst[1] = (uint8_t)(0x80 | (cp & 0x3F));
+    return 2;
+  } else if (cp < 0x10000) {
+    dst[0] = (uint8_t)(0xE0 | (cp >> 12));
+    dst[1] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+    dst[2] = (uint8_t)(0x80 | (cp & 0x3F));
+    return 3;
+  } else if (cp < NORMALIZER_RAW) {
+    dst[0] = (uint8_t)(0xF0 | (cp >> 18));
+    dst[1] = (uint8_t)(0x80 | ((cp >> 12) & 0x3F));
+    dst[2] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+    dst[3] = (uint8_t)(0x80 | (cp & 0x3F));
+    return 4;
+  } else if (cp == NORMALIZER_DROP) {
+    return 0;
+  } else {
+    dst[0] = (uint8_t)(cp - NORMALIZER_RAW);
+    return 1;
+  }
+}
+
+size_t normalizer_fill(normalizer_t self,
+                       const uint8_t* src,
+                       size_t len,
+                       size_t* source,
+                       uint8_t out[],
+                       size_t capacity,
+                       size_t ends[]) {
+  size_t s = *source, w = 0;
+  ends[0] = s;
+  while (s < len && w < capacity) {
+    uint32_t cp;
+    if (src[s] < 0x80) {
+      cp = normalizer_map(self, src[s]);
+      s++;
+      if (cp < 0x80) {
+        // fast path, ASCII is mapped to ASCII in most tables
+        out[w++] = (uint8_t)cp;
+        ends[w] = s;
+        continue;
+      }
+    } else {
+      s += normalizer_decode(src + s, len - s, &cp);
+      cp = normalizer_map(self, cp);
+    }
+    size_t n = normalizer_encode(cp, out + w);
+    for (size_t i = 1; i <= n; i++) {
+      ends[w + i] = s;
+    }
+    w += n;
+  }
+  *source = s;
+  return w;
+}
+
+size_t normalizer_decode_prev(const uint8_t* src, size_t pos, uint32_t* cp) {
+  if (src[pos - 1] >= 0x80) {
+    for (size_t n = 2; n <= 4 && n <= pos; n++) {
+      if ((src[pos - n] & 0xC0) != 0x80) {
+        // lead byte is found, it is a character only if it covers exactly to pos
+        if (normalizer_decode(src + pos - n, n, cp) == n) {
+          return pos - n;
+        }
+        break;
+      }
+    }
+  }
+  normalizer_decode(src + pos - 1, 1, cp);
+  return pos - 1;
+}
+
+size_t normalizer_rewind(normalizer_t self, const uint8_t* src, size_t eo, size_t len) {
+  size_t so = eo, n = 0;
+  while (n < len && so > 0) {
+    uint32_t cp;
+    so = normalizer_decode_prev(src, so, &cp);
+    n += normalizer_encoded_len(normalizer_map(self, cp));
+  }
+  return so;
+}
+
+size_t normalizer_apply(normalizer_t self, const char* src, size_t len, char* out) {
+  const uint8_t* ptr = (const uint8_t*)src;
+  size_t s = 0, w = 0;
+  while (s < len) {
+    uint32_t cp;
+    s += normalizer_decode(ptr + s, len - s, &cp);
+    w += normalizer_encode(normalizer_map(self, cp), (uint8_t*)out + w);
+  }
+  return w;
+}
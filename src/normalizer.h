@@ -0,0 +1,99 @@
+/**
+ * normalizer.h - codepoint mapping applied to keywords and documents
+ *
+ * @author James Yin <ywhjames@hotmail.com>
+ */
+#ifndef __ACTRIE_NORMALIZER_H__
+#define __ACTRIE_NORMALIZER_H__
+
+#include <alib/acom.h>
+#include <alib/string/astr.h>
+
+#include "charclass.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define NORMALIZER_PAGE_SHIFT 8
+#define NORMALIZER_PAGE_SIZE (1 << NORMALIZER_PAGE_SHIFT)
+#define NORMALIZER_PAGE_COUNT (0x110000 >> NORMALIZER_PAGE_SHIFT)
+
+/* byte that is not part of valid UTF-8 is decoded to NORMALIZER_RAW + byte, and never mapped */
+#define NORMALIZER_RAW 0x110000
+
+/* character mapped to NORMALIZER_DROP is removed from normalized text */
+#define NORMALIZER_DROP UINT32_MAX
+
+/**
+ * normalizer - table of codepoints split in pages of 256, page without mapping is NULL,
+ * so lookup is one load for identity and two loads for mapped codepoint.
+ */
+typedef struct _actrie_normalizer_ {
+  uint32_t* pages[NORMALIZER_PAGE_COUNT];
+  size_t page_used;
+} normalizer_s, *normalizer_t;
+
+/**
+ * normalizer_construct - table is lines of "from\tto", both of them are single character. mapping
+ * of table is applied after folding, and NULL is returned if table is malformed.
+ */
+normalizer_t normalizer_construct(bool fold_case, bool fold_width, strlen_t table);
+void normalizer_destruct(normalizer_t self);
+
+/**
+ * normalizer_ignore - drop characters of class, and characters mapped to them.
+ */
+bool normalizer_ignore(normalizer_t self, charclass_t chars);
+
+static inline uint32_t normalizer_map(normalizer_t self, uint32_t cp) {
+  if (cp < NORMALIZER_RAW) {
+    uint32_t* page = self->pages[cp >> NORMALIZER_PAGE_SHIFT];
+    if (page != NULL) {
+      return page[cp & (NORMALIZER_PAGE_SIZE - 1)];
+    }
+  }
+  return cp;
+}
+
+size_t normalizer_decode(const uint8_t* src, size_t len, uint32_t* cp);
+size_t normalizer_encode(uint32_t cp, uint8_t* dst);
+
+/**
+ * normalizer_decode_prev - start of character which ends at pos, same as boundary found by forward decoding.
+ */
+size_t normalizer_decode_prev(const uint8_t* src, size_t pos, uint32_t* cp);
+
+/**
+ * normalizer_fill - normalize src from *source until src is exhausted or out is nearly full, and
+ * ends[i] is offset in src after the character that contains out[i-1].
+ *
+ * out must have space of capacity + 4 bytes, ends must have capacity + 5 slots.
+ *
+ * @return bytes written to out
+ */
+size_t normalizer_fill(normalizer_t self,
+                       const uint8_t* src,
+                       size_t len,
+                       size_t* source,
+                       uint8_t out[],
+                       size_t capacity,
+                       size_t ends[]);
+
+/**
+ * normalizer_rewind - offset in src where normalized text of length len ends at eo starts.
+ */
+size_t normalizer_rewind(normalizer_t self, const uint8_t* src, size_t eo, size_t len);
+
+/**
+ * normalizer_apply - normalize whole string, out must have space of 4 * len bytes.
+ *
+ * @return bytes written to out
+ */
+size_t normalizer_apply(normalizer_t self, const char* src, size_t len, char* out);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif  // __ACTRIE_NORMALIZER_H__
@@ -5,8 +5,13 @@
  */
 #include "parser.h"
 
+#include <alib/concurrent/threadlocal.h>
 #include <alib/object/pint.h>
 
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
 #include "lr_table.h"
 #include "tokenizer.h"
 
@@ -153,7 +158,7 @@ void parse_reduce(dynapool_t sign_pool, deque_node_t sign_stack, lr_sign_t* node
   *change = lr_goto_table[sign->state][nonid];
 }
 
-ptrn_t parse_pattern0(stream_t stream) {
+ptrn_t parse_pattern0(token_cursor_t cursor) {
   ptrn_t pattern = NULL;
 
   deque_node_s sign_stack[1], token_deque[1];
@@ -165,7 +170,7 @@ ptrn_t parse_pattern0(stream_t stream) {
   // tokenize
   int ch;
   dstr_t token;
-  while ((ch = token_next(stream, &token)) != TOKEN_EOF) {
+  while ((ch = token_next(cursor, &token)) != TOKEN_EOF) {
     if (ch == TOKEN_ERR) {
       break;
     }
@@ -181,8 +186,8 @@ ptrn_t parse_pattern0(stream_t stream) {
       lr_sign_t node = dynapool_alloc_node(sign_pool);
       node->state = -ch;  // every sign is negative
       if (ch == TOKEN_REPT) {
-        int max = token_rept_max();
-        int min = token_rept_min();
+        int max = cursor->rept_max;
+        int min = cursor->rept_min;
         node->data = pint(((uptr_t)max & 0xFFFFU) << 16U | ((uptr_t)min & 0xFFFFU));
       } else {
         node->data = pint(ch);
@@ -256,13 +261,192 @@ lr_error:
 }
 
 /**
- * wrapper for convert strlen_t to stream_t
+ * wrapper for convert strlen_t to token_cursor_t
  */
 ptrn_t parse_pattern(strlen_t pattern) {
-  stream_t stream = stream_construct(stream_type_string, pattern);
-  ptrn_t ptrn = parse_pattern0(stream);
-  stream_destruct(stream);
-  return ptrn;
+  token_cursor_s cursor;
+  token_cursor_init(&cursor, pattern);
+  return parse_pattern0(&cursor);
+}
+
+/**
+ * parse_keyword - parse keyword of vocabulary to pattern
+ * @param bad - set to true if keyword is bad pattern
+ * @return pattern, or NULL if keyword is bad and not converted to plain
+ */
+static ptrn_t parse_keyword(strlen_t keyword, bool all_as_plain, bool bad_as_plain, bool* bad) {
+  ptrn_t pattern;
+  *bad = false;
+  if (all_as_plain) {
+    // construct pure-pattern
+    dstr_t text = dstr(keyword);
+    pattern = _alloc(ptrn, pure, text);
+    _release(text);
+  } else {
+    pattern = parse_pattern(keyword);
+    if (pattern == NULL) {
+      *bad = true;
+      if (bad_as_plain) {
+        // construct pure-pattern
+        dstr_t text = dstr(keyword);
+        pattern = _alloc(ptrn, pure, text);
+        _release(text);
+      }
+    }
+  }
+  return pattern;
+}
+
+// Concurrent Parse
+// ========================================================
+
+#ifndef PARSE_VOCAB_MAX_THREADS
+#define PARSE_VOCAB_MAX_THREADS 8
+#endif
+
+#define PARSE_VOCAB_LINES_PER_THREAD 4096
+#define PARSE_VOCAB_LINES_PER_BATCH 4096
+
+typedef struct _parsed_line_ {
+  ptrn_t pattern;
+  strlen_s keyword, extra;
+  bool bad;
+} parsed_line_s, *parsed_line_t;
+
+/**
+ * parse_worker - parse a batch of vocabulary, and keep patterns in line order,
+ * keyword and extra are slices of vocabulary.
+ */
+typedef struct _parse_worker_ {
+  strlen_s content;
+  parsed_line_t lines;
+  size_t count;
+  bool all_as_plain, bad_as_plain, stop_on_bad;
+  thrd_t thread;
+  bool started;
+} parse_worker_s, *parse_worker_t;
+
+static int parse_worker_run(void* arg) {
+  parse_worker_t worker = (parse_worker_t)arg;
+  strlen_s keyword, extra;
+
+  vocab_t vocab = vocab_construct(stream_type_string, &worker->content);
+  if (vocab == NULL) {
+    return -1;
+  }
+  worker->lines = amalloc(alib_max(vocab_count(vocab), 1) * sizeof(parsed_line_s));
+  if (worker->lines == NULL) {
+    vocab_destruct(vocab);
+    return -1;
+  }
+
+  while (vocab_next_word(vocab, &keyword, &extra)) {
+    if (keyword.len <= 0) {
+      continue;
+    }
+    parsed_line_t line = &worker->lines[worker->count++];
+    line->pattern = parse_keyword(&keyword, worker->all_as_plain, worker->bad_as_plain, &line->bad);
+    line->keyword = keyword;
+    line->extra = extra;
+    if (line->pattern == NULL && worker->stop_on_bad) {
+      // following lines will be dropped by merge
+      break;
+    }
+  }
+
+  vocab_destruct(vocab);
+  return 0;
+}
+
+static size_t parse_vocab_concurrency(vocab_t vocab) {
+  size_t n = vocab_count(vocab) / PARSE_VOCAB_LINES_PER_THREAD;
+#ifdef _SC_NPROCESSORS_ONLN
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cpus > 0 && n > (size_t)cpus) {
+    n = (size_t)cpus;
+  }
+#endif
+  return alib_min(n, PARSE_VOCAB_MAX_THREADS);
+}
+
+static void parse_round_start(parse_worker_s workers[],
+                              strlen_s batches[],
+                              size_t n,
+                              bool all_as_plain,
+                              bool ignore_bad_pattern,
+                              bool bad_as_plain) {
+  for (size_t i = 0; i < n; i++) {
+    parse_worker_t worker = &workers[i];
+    worker->content = batches[i];
+    worker->lines = NULL;
+    worker->count = 0;
+    worker->all_as_plain = all_as_plain;
+    worker->bad_as_plain = !ignore_bad_pattern && bad_as_plain;
+    worker->stop_on_bad = !ignore_bad_pattern;
+    worker->started = thrd_create(&worker->thread, parse_worker_run, worker) == thrd_success;
+  }
+}
+
+/**
+ * parse_vocab_concurrently - parse batches of vocabulary on threads round by round, then merge patterns
+ * batch by batch in line order, so the result is same as parsing on single thread. all workers of a round
+ * are joined before it is merged, have_pattern never runs while other threads are parsing.
+ */
+static bool parse_vocab_concurrently(strlen_s batches[],
+                                     size_t count,
+                                     size_t n,
+                                     have_pattern_f have_pattern,
+                                     void* arg,
+                                     bool all_as_plain,
+                                     bool ignore_bad_pattern,
+                                     bool bad_as_plain) {
+  parse_worker_s workers[PARSE_VOCAB_MAX_THREADS];
+  int rets[PARSE_VOCAB_MAX_THREADS];
+
+  bool success = true;
+  for (size_t next = 0; next < count && success; next += n) {
+    size_t m = alib_min(n, count - next);
+    parse_round_start(workers, batches + next, m, all_as_plain, ignore_bad_pattern, bad_as_plain);
+
+    for (size_t i = 0; i < m; i++) {
+      parse_worker_t worker = &workers[i];
+      rets[i] = -1;
+      if (worker->started) {
+        thrd_join(worker->thread, &rets[i]);
+      }
+    }
+    for (size_t i = 0; i < m; i++) {
+      if (!workers[i].started) {
+        // fallback to current thread, after other workers are joined
+        rets[i] = parse_worker_run(&workers[i]);
+      }
+    }
+
+    for (size_t i = 0; i < m; i++) {
+      parse_worker_t worker = &workers[i];
+      if (rets[i] != 0) {
+        success = false;
+      }
+
+      for (size_t j = 0; j < worker->count; j++) {
+        parsed_line_t line = &worker->lines[j];
+        if (success) {
+          if (line->bad) {
+            fprintf(stderr, "bad pattern: '%.*s'\n", (int)line->keyword.len, line->keyword.ptr);
+          }
+          if (line->pattern != NULL) {
+            have_pattern(line->pattern, &line->extra, arg);
+          } else if (!ignore_bad_pattern) {
+            success = false;
+          }
+        }
+        _release(line->pattern);
+      }
+      afree(worker->lines);
+    }
+  }
+
+  return success;
 }
 
 bool parse_vocab(vocab_t vocab,
@@ -271,6 +455,23 @@ bool parse_vocab(vocab_t vocab,
                  bool all_as_plain,
                  bool ignore_bad_pattern,
                  bool bad_as_plain) {
+  // only in-place vocabulary can be split, into batches of similar size
+  size_t n = parse_vocab_concurrency(vocab);
+  if (n > 1) {
+    size_t count = alib_max(vocab_count(vocab) / PARSE_VOCAB_LINES_PER_BATCH, n);
+    strlen_s* batches = amalloc(count * sizeof(strlen_s));
+    if (batches != NULL) {
+      count = vocab_split(vocab, batches, count);
+      if (count > 1) {
+        bool success = parse_vocab_concurrently(batches, count, alib_min(n, count), have_pattern, arg, all_as_plain,
+                                                ignore_bad_pattern, bad_as_plain);
+        afree(batches);
+        return success;
+      }
+      afree(batches);
+    }
+  }
+
   strlen_s keyword, extra;
   vocab_reset(vocab);
   while (vocab_next_word(vocab, &keyword, &extra)) {
@@ -278,29 +479,16 @@ bool parse_vocab(vocab_t vocab,
       continue;
     }
     // parse pattern, output syntax tree
-    ptrn_t pattern;
-    if (all_as_plain) {
-      // construct pure-pattern
-      dstr_t text = dstr(&keyword);
-      pattern = _alloc(ptrn, pure, text);
-      _release(text);
-    } else {
-      pattern = parse_pattern(&keyword);
-      if (pattern == NULL) {
-        fprintf(stderr, "bad pattern: '%.*s'\n", (int)keyword.len, keyword.ptr);
-        if (!ignore_bad_pattern) {
-          if (bad_as_plain) {
-            // construct pure-pattern
-            dstr_t text = dstr(&keyword);
-            pattern = _alloc(ptrn, pure, text);
-            _release(text);
-          } else {
-            return false;
-          }
-        } else {
-          continue;
-        }
+    bool bad;
+    ptrn_t pattern = parse_keyword(&keyword, all_as_plain, !ignore_bad_pattern && bad_as_plain, &bad);
+    if (bad) {
+      fprintf(stderr, "bad pattern: '%.*s'\n", (int)keyword.len, keyword.ptr);
+    }
+    if (pattern == NULL) {
+      if (!ignore_bad_pattern) {
+        return false;
       }
+      continue;
     }
     have_pattern(pattern, &extra, arg);
     _release(pattern);
@@ -5,7 +5,6 @@
  */
 #include "tokenizer.h"
 
-#include <alib/concurrent/threadlocal.h>
 #include <alib/string/dynabuf.h>
 
 // clang-format off
@@ -84,25 +83,40 @@ const int hex_char2num[256] = {
     0,  0,  0,  0,  0,  0,  0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
     0,  0,  0,  0,  0,  0,  0, 0, 0, 0, 0, 0, 0, 0, 0, 0
 };
-// clang-format on
 
-static once_flag rept_flag = ONCE_FLAG_INIT;
-static tss_t rept_key;
+/* bytes which break a run of plain text */
+const bool token_meta_bitmap[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 1, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+// clang-format on
 
-static void rept_init(void) {
-  if (tss_create(&rept_key, free) != thrd_success) {
-    ALOG_FATAL("rept_init failed!");
-  }
+static inline int token_getc(token_cursor_t cursor) {
+  return cursor->ptr < cursor->end ? *cursor->ptr++ : EOF;
 }
 
 /**
  * token_oct_num - octal escape sequence
  * @param ch - first char
  */
-int token_oct_num(int ch, stream_t stream) {
+int token_oct_num(int ch, token_cursor_t cursor) {
   int num = ch - '0';
   for (int i = 0; i < 2; i++) {
-    ch = stream_getc(stream);
+    ch = token_getc(cursor);
     if (ch == EOF || !oct_number_bitmap[ch]) {
       return TOKEN_ERR;
     }
@@ -115,10 +129,10 @@ int token_oct_num(int ch, stream_t stream) {
  * token_hex_num -  hexadecimal escape sequence
  * @param ch - first char
  */
-int token_hex_num(int ch, stream_t stream) {
+int token_hex_num(int ch, token_cursor_t cursor) {
   int num = ch - '0';
   for (int i = 0; i < 2; i++) {
-    ch = stream_getc(stream);
+    ch = token_getc(cursor);
     if (ch == EOF || !hex_number_bitmap[ch]) {
       return TOKEN_ERR;
     }
@@ -128,84 +142,43 @@ int token_hex_num(int ch, stream_t stream) {
 }
 
 /**
- * token_expect - compare next sequence with excepted bytes
+ * token_expect - consume next sequence if it is excepted bytes
  */
-bool token_expect(stream_t stream, const uchar* except, size_t len) {
-  if (len == 0) {
-    return true;
-  }
-  int ch = stream_getc(stream);
-  if (ch != EOF) {
-    if (ch == except[0] && token_expect(stream, except + 1, len - 1)) {
-      return true;
-    }
-    stream_ungetc(stream, ch);
+bool token_expect(token_cursor_t cursor, const uchar* except, size_t len) {
+  if ((size_t)(cursor->end - cursor->ptr) < len || memcmp(cursor->ptr, except, len) != 0) {
+    return false;
   }
-  return false;
-}
-
-/**
- * token_expect_char - compare next char with excepted next
- */
-bool token_expect_char(stream_t stream, const uchar ch) {
-  return token_expect(stream, &ch, 1);
+  cursor->ptr += len;
+  return true;
 }
 
 /**
- * token_skip_set - skip next sequence when each byte is excepted
+ * token_expect_char - consume next char if it is excepted
  */
-bool token_skip_set(stream_t stream, const uchar* except, size_t len) {
-  int ch;
-  if (except == NULL || len == 0 || except[0] == '\0') {
-    // empty set
-    return false;
-  } else {
-    if (len == 1) {
-      while ((ch = stream_getc(stream)) != EOF && ch == *except)
-        ;
-    } else {
-      uchar table[256];
-      uchar* p = memset(table, 0, 64);
-      memset(p + 64, 0, 64);
-      memset(p + 128, 0, 64);
-      memset(p + 192, 0, 64);
-
-      for (int i = 0; i < len; i++) {
-        p[except[i]] = 1;
-      }
-
-      while ((ch = stream_getc(stream)) != EOF && p[ch])
-        ;
-    }
-
-    if (ch != EOF) {
-      stream_ungetc(stream, ch);
-    }
-
+bool token_expect_char(token_cursor_t cursor, const uchar ch) {
+  if (cursor->ptr < cursor->end && *cursor->ptr == ch) {
+    cursor->ptr++;
     return true;
   }
+  return false;
 }
 
 /**
  * token_skip_space - skip next space sequence
  */
-bool token_skip_space(stream_t stream) {
-  return token_skip_set(stream, (uchar*)" ", 1);
+void token_skip_space(token_cursor_t cursor) {
+  while (cursor->ptr < cursor->end && *cursor->ptr == ' ') {
+    cursor->ptr++;
+  }
 }
 
-bool token_consume_integer(stream_t stream, int* integer) {
-  int ch = stream_getc(stream);
-  bool is_neg = false;
-  if (ch == '-') {
-    is_neg = true;
-    ch = stream_getc(stream);
-  }
-  if (ch != EOF && dec_number_bitmap[ch]) {
+bool token_consume_integer(token_cursor_t cursor, int* integer) {
+  bool is_neg = token_expect_char(cursor, '-');
+  if (cursor->ptr < cursor->end && dec_number_bitmap[*cursor->ptr]) {
     int num = 0;
     do {
-      num = num * 10 + (ch - '0');
-    } while ((ch = stream_getc(stream)) != EOF && dec_number_bitmap[ch]);
-    stream_ungetc(stream, ch);
+      num = num * 10 + (*cursor->ptr++ - '0');
+    } while (cursor->ptr < cursor->end && dec_number_bitmap[*cursor->ptr]);
 
     if (integer != NULL) {
       *integer = is_neg ? -num : num;
@@ -216,7 +189,7 @@ bool token_consume_integer(stream_t stream, int* integer) {
   return false;
 }
 
-int token_escape(int ch, stream_t stream) {
+int token_escape(int ch, token_cursor_t cursor) {
   switch (ch) {
     case '\\':
       return '\\';
@@ -244,81 +217,51 @@ int token_escape(int ch, stream_t stream) {
     case '5':
     case '6':
     case '7':
-      return token_oct_num(ch, stream);
+      return token_oct_num(ch, cursor);
     case 'x':
-      return token_hex_num('0', stream);
+      return token_hex_num('0', cursor);
     default:
       return TOKEN_ERR;
   }
 }
 
-typedef struct _token_rept_s {
-  int min, max;
-} rept_s, *rept_t;
-
-void token_set_rept(int min, int max) {
-  call_once(&rept_flag, rept_init);
-  rept_t rept = tss_get(rept_key);
-  if (rept == NULL) {
-    rept = malloc(sizeof(rept_s));
-    tss_set(rept_key, rept);
-  }
-  rept->min = min;
-  rept->max = max;
-}
-
-int token_rept_min() {
-  rept_t rept = tss_get(rept_key);
-  if (rept == NULL) {
-    return -1;
-  }
-  return rept->min;
-}
-
-int token_rept_max() {
-  rept_t rept = tss_get(rept_key);
-  if (rept == NULL) {
-    return -1;
-  }
-  return rept->max;
-}
-
-int token_rept(int ch, stream_t stream) {
+int token_rept(int ch, token_cursor_t cursor) {
   // rept: {min,max}
   do {
     int min, max;
 
-    token_skip_space(stream);
-    if (!token_consume_integer(stream, &min) || min < 0) {
+    token_skip_space(cursor);
+    if (!token_consume_integer(cursor, &min) || min < 0) {
       break;
     }
-    token_skip_space(stream);
-    if (!token_expect_char(stream, ',')) {
+    token_skip_space(cursor);
+    if (!token_expect_char(cursor, ',')) {
       break;
     }
-    token_skip_space(stream);
-    if (!token_consume_integer(stream, &max) || max < min) {
+    token_skip_space(cursor);
+    if (!token_consume_integer(cursor, &max) || max < min) {
       break;
     }
-    token_skip_space(stream);
-    if (!token_expect_char(stream, '}')) {
+    token_skip_space(cursor);
+    if (!token_expect_char(cursor, '}')) {
       break;
     }
 
     // set min and max
-    token_set_rept(min, max);
+    cursor->rept_min = min;
+    cursor->rept_max = max;
 
     return TOKEN_REPT;
   } while (0);
   return TOKEN_ERR;
 }
 
-int token_subs(int ch, stream_t stream) {
-  if (token_expect_char(stream, '?')) {
-    if (token_expect(stream, (uchar*)"&!", 2)) {
+int token_subs(int ch, token_cursor_t cursor) {
+  if (token_expect_char(cursor, '?')) {
+    if (token_expect(cursor, (uchar*)"&!", 2)) {
       // ambi-pattern: (?&!pattern)
       return TOKEN_AMBI;
-    } else if (token_expect(stream, (uchar*)"<!", 2)) {
+    } else if (token_expect(cursor, (uchar*)"<!", 2)) {
       // anto-pattern: (?<!pattern)
       return TOKEN_ANTO;
     }
@@ -326,14 +269,14 @@ int token_subs(int ch, stream_t stream) {
   return TOKEN_SUBS;
 }
 
-int token_meta(int ch, stream_t stream) {
+int token_meta(int ch, token_cursor_t cursor) {
   switch (ch) {
     case '(':  // sub-pattern
-      return token_subs(ch, stream);
+      return token_subs(ch, cursor);
     case ')':
       return TOKEN_SUBE;
     case '{':  // rept
-      return token_rept(ch, stream);
+      return token_rept(ch, cursor);
     case '.':
       return TOKEN_ANY;
     case '|':
@@ -343,29 +286,52 @@ int token_meta(int ch, stream_t stream) {
   }
 }
 
-int token_next(stream_t stream, dstr_t* token) {
-  int ch;
+int token_next(token_cursor_t cursor, dstr_t* token) {
+  const uchar* run = cursor->ptr; /* plain bytes which are not copied */
+  const uchar* stop;
   dynabuf_s buffer;
+  bool buffered = false;
+  int ch;
 
-  dynabuf_init(&buffer, 31);
+  while (true) {
+    // skip run of plain bytes
+    while (cursor->ptr < cursor->end && !token_meta_bitmap[*cursor->ptr]) {
+      cursor->ptr++;
+    }
+    stop = cursor->ptr;
 
-  while ((ch = stream_getc(stream)) != EOF) {
-    if (ch == '\\') {  // 处理转义字符
-      ch = token_escape(stream_getc(stream), stream);
+    ch = token_getc(cursor);
+    if (ch == EOF) {
+      break;
+    } else if (ch == '\\') {  // 处理转义字符
+      ch = token_escape(token_getc(cursor), cursor);
     } else {
-      ch = token_meta(ch, stream);
+      ch = token_meta(ch, cursor);
     }
 
     if (ch <= TOKEN_ERR) {
       break;
     }
 
+    // escaped byte, text is copied only in this case
+    if (!buffered) {
+      dynabuf_init(&buffer, 31);
+      buffered = true;
+    }
     char ch0 = (uchar)ch;
+    dynabuf_write(&buffer, (const char*)run, stop - run);
     dynabuf_write(&buffer, &ch0, 1);
+    run = cursor->ptr;
+  }
+
+  strlen_s tok = {.ptr = (char*)run, .len = stop - run};
+  if (buffered) {
+    dynabuf_write(&buffer, (const char*)run, stop - run);
+    tok = dynabuf_content(&buffer);
   }
 
   if (ch == EOF) {
-    if (dynabuf_empty(&buffer)) {
+    if (tok.len == 0) {
       ch = TOKEN_EOF;
     } else {
       ch = TOKEN_TEXT;
@@ -373,16 +339,17 @@ int token_next(stream_t stream, dstr_t* token) {
   }
 
   if (token != NULL) {
-    if (dynabuf_empty(&buffer) || ch == TOKEN_ERR) {
+    if (tok.len == 0 || ch == TOKEN_ERR) {
       // 出错不返回
       *token = NULL;
     } else {
-      strlen_s tok = dynabuf_content(&buffer);
       *token = dstr(&tok);
     }
   }
 
-  dynabuf_clean(&buffer);
+  if (buffered) {
+    dynabuf_clean(&buffer);
+  }
 
   return ch;
 }
@@ -6,7 +6,6 @@
 #ifndef __ACTRIE_TOKENIZER_H__
 #define __ACTRIE_TOKENIZER_H__
 
-#include <alib/io/stream.h>
 #include <alib/object/dstr.h>
 
 #define TOKEN_TEXT (0)
@@ -21,8 +20,22 @@
 #define TOKEN_REPT (-9)
 #define TOKEN_ALT (-10)
 
-int token_next(stream_t stream, dstr_t* token);
-int token_rept_min();
-int token_rept_max();
+/**
+ * token_cursor - pattern is tokenized in memory, plain text is scanned by table and
+ * only copied when it contains escaped bytes.
+ */
+typedef struct _token_cursor_ {
+  const uchar* ptr;
+  const uchar* end;
+  int rept_min, rept_max; /* bound of last TOKEN_REPT */
+} token_cursor_s, *token_cursor_t;
+
+static inline void token_cursor_init(token_cursor_t cursor, strlen_t text) {
+  cursor->ptr = (const uchar*)text->ptr;
+  cursor->end = cursor->ptr + text->len;
+  cursor->rept_min = cursor->rept_max = -1;
+}
+
+int token_next(token_cursor_t cursor, dstr_t* token);
 
 #endif  // __ACTRIE_TOKENIZER_H__
@@ -0,0 +1,124 @@
+/**
+ * arena.c
+ *
+ * @author James Yin <ywhjames@hotmail.com>
+ */
+#include "arena.h"
+
+#define ARENA_ALIGN (2 * sizeof(void*))
+
+// Arena
+// ========================================================
+
+static arena_block_t arena_block_alloc(size_t size) {
+  arena_block_t block = amalloc(sizeof(arena_block_s) + size);
+  if (block != NULL) {
+    block->next = NULL;
+    block->size = size;
+  }
+  return block;
+}
+
+arena_t arena_construct(size_t block_size) {
+  arena_t arena = amalloc(sizeof(arena_s));
+  if (arena == NULL) {
+    return NULL;
+  }
+
+  arena->block_size = (block_size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  arena->head = arena_block_alloc(arena->block_size);
+  if (arena->head == NULL) {
+    afree(arena);
+    return NULL;
+  }
+  arena->current = arena->head;
+  arena->offset = 0;
+
+  return arena;
+}
+
+void arena_destruct(arena_t arena) {
+  if (arena != NULL) {
+    arena_block_t block = arena->head;
+    while (block != NULL) {
+      arena_block_t next = block->next;
+      afree(block);
+      block = next;
+    }
+    afree(arena);
+  }
+}
+
+void* arena_alloc(arena_t arena, size_t size) {
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+  if (arena->current->size - arena->offset < size) {
+    // reuse block that left by last document
+    arena_block_t next = arena->current->next;
+    if (next == NULL || next->size < size) {
+      next = arena_block_alloc(alib_max(arena->block_size, size));
+      if (next == NULL) {
+        return NULL;
+      }
+      next->next = arena->current->next;
+      arena->current->next = next;
+    }
+    arena->current = next;
+    arena->offset = 0;
+  }
+
+  void* ptr = arena->current->data + arena->offset;
+  arena->offset += size;
+  return ptr;
+}
+
+void arena_reset(arena_t arena) {
+  arena->current = arena->head;
+  arena->offset = 0;
+}
+
+// Arena Pool
+// ========================================================
+
+arena_pool_t arena_pool_construct(size_t node_size) {
+  arena_pool_t pool = amalloc(sizeof(arena_pool_s));
+  if (pool == NULL) {
+    return NULL;
+  }
+
+  pool->node_size = alib_max(node_size, sizeof(void*));
+  pool->arena = arena_construct(pool->node_size * 256);
+  if (pool->arena == NULL) {
+    afree(pool);
+    return NULL;
+  }
+  pool->free_list = NULL;
+
+  return pool;
+}
+
+void arena_pool_destruct(arena_pool_t pool) {
+  if (pool != NULL) {
+    arena_destruct(pool->arena);
+    afree(pool);
+  }
+}
+
+void* arena_pool_alloc_node(arena_pool_t pool) {
+  void* node = pool->free_list;
+  if (node != NULL) {
+    pool->free_list = *(void**)node;
+    return node;
+  }
+  return arena_alloc(pool->arena, pool->node_size);
+}
+
+void arena_pool_free_node(arena_pool_t pool, void* node) {
+  *(void**)node = pool->free_list;
+  pool->free_list = node;
+}
+
+void arena_pool_reset(arena_pool_t pool) {
+  pool->free_list = NULL;
+  arena_reset(pool->arena);
+}
@@ -0,0 +1,63 @@
+/**
+ * arena.h - bump allocator for objects living within one document
+ *
+ * @author James Yin <ywhjames@hotmail.com>
+ */
+#ifndef __ACTRIE_REGEX_ARENA_H__
+#define __ACTRIE_REGEX_ARENA_H__
+
+#include <alib/acom.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+struct _regex_arena_block_;
+typedef struct _regex_arena_block_ arena_block_s;
+typedef arena_block_s* arena_block_t;
+
+struct _regex_arena_block_ {
+  arena_block_t next;
+  size_t size;
+  char data[];
+};
+
+/**
+ * arena - blocks are chained and never returned to system until destruct,
+ * so that reset is O(1) and steady-state allocation never calls amalloc.
+ */
+typedef struct _regex_arena_ {
+  arena_block_t head;
+  arena_block_t current;
+  size_t offset; /* used bytes of current block */
+  size_t block_size;
+} arena_s, *arena_t;
+
+arena_t arena_construct(size_t block_size);
+void arena_destruct(arena_t arena);
+
+void* arena_alloc(arena_t arena, size_t size);
+void arena_reset(arena_t arena);
+
+/**
+ * arena_pool - fixed-size node pool on arena, all nodes can be dropped at once
+ */
+typedef struct _regex_arena_pool_ {
+  arena_t arena;
+  void* free_list;
+  size_t node_size;
+} arena_pool_s, *arena_pool_t;
+
+arena_pool_t arena_pool_construct(size_t node_size);
+#define arena_pool_construct_with_type(type) arena_pool_construct(sizeof(type))
+void arena_pool_destruct(arena_pool_t pool);
+
+void* arena_pool_alloc_node(arena_pool_t pool);
+void arena_pool_free_node(arena_pool_t pool, void* node);
+void arena_pool_reset(arena_pool_t pool);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif  // __ACTRIE_REGEX_ARENA_H__
@@ -14,6 +14,9 @@
 #include <alib/string/astr.h>
 #include <alib/string/utf8.h>
 
+#include "../strpool.h"
+#include "arena.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -23,7 +26,10 @@ typedef struct _position_cache_node_ {
   union {
     avl_node_s avl_elem;
     deque_node_s deque_elem;
-    dstr_t extra;
+    struct {
+      const strhdl_s* extra;
+      struct _position_cache_node_* next; /* link in bucket of output queue */
+    } output;
   } embed;
 } pos_cache_s, *pos_cache_t;
 
@@ -34,22 +40,102 @@ sptr_t pos_cache_eq_eo(avl_node_t node, void* key);
 sptr_t pos_cache_so_in_range(avl_node_t node, void* arg);
 sptr_t pos_cache_eo_in_range(avl_node_t node, void* arg);
 
-sptr_t pos_cache_so_in_word(avl_node_t node, void* arg);
-sptr_t pos_cache_eo_in_word(avl_node_t node, void* arg);
+/**
+ * avl_stash - recycle avl trees of expression contexts between documents.
+ * trees before 'used' are taken by current document, and the rest are free.
+ */
+typedef struct _avl_stash_ {
+  avl_t* trees;
+  size_t used, size;
+  avl_cmp_f cmp;
+} avl_stash_s, *avl_stash_t;
+
+void avl_stash_init(avl_stash_t stash, avl_cmp_f cmp);
+void avl_stash_clean(avl_stash_t stash);
+avl_t avl_stash_take(avl_stash_t stash);
+void avl_stash_reset(avl_stash_t stash);
+
+#define OUTPUT_QUEUE_BUCKETS (sizeof(size_t) * 8 + 1)
+
+typedef struct _output_bucket_ {
+  pos_cache_t head, tail;
+} output_bucket_s, *output_bucket_t;
+
+/**
+ * output_queue - radix queue of pending outputs, popped in (eo, so) order.
+ *
+ * outputs are made at scan position, so eo of pushed output is not less than eo of last popped one. output is put
+ * into bucket by the highest bit which its eo differs from 'last', and bucket 0 holds outputs at 'last'. when
+ * bucket 0 is drained, the lowest non-empty bucket is split into lower buckets around its minimal eo. while
+ * scanning, all pending outputs share one eo, so push and pop are O(1); deferred outputs of activation move
+ * down once per bit of their distance at most. the queue takes fixed memory, whatever the length of content.
+ */
+typedef struct _output_queue_ {
+  output_bucket_s buckets[OUTPUT_QUEUE_BUCKETS];
+  uint64_t nonempty; /* bit i - 1 is set if bucket i is not empty, for i > 0 */
+  size_t last;       /* eo of bucket 0 */
+  size_t len;
+  bool sorted; /* bucket 0 is in so order */
+} output_queue_s, *output_queue_t;
+
+void output_queue_init(output_queue_t queue);
+void output_queue_clean(output_queue_t queue);
+void output_queue_reset(output_queue_t queue);
+void output_queue_push(output_queue_t queue, pos_cache_t pos_cache);
+pos_cache_t output_queue_pop(output_queue_t queue);
 
-void free_pos_cache(avl_node_t node, void* arg);
+/**
+ * expr_ctx_slot - expression context is valid only if generation of slot is
+ * equal to generation of reg_ctx, so reset need not visit any slot.
+ */
+typedef struct _expr_ctx_slot_ {
+  struct _expression_context_* expr_ctx;
+  size_t generation;
+} expr_ctx_slot_s, *expr_ctx_slot_t;
+
+/**
+ * digit_block - non-digit bytes of 64 bytes of content, and the first block at or after this one which has
+ * non-digit byte, so that a run of digits is checked by three blocks at most.
+ */
+typedef struct _digit_block_ {
+  uint64_t non_digit;
+  size_t next_dirty;
+} digit_block_s, *digit_block_t;
+
+/**
+ * digit_index - digit blocks of content, built lazily by numeric distance expressions, and valid only in its
+ * generation. it takes 1/4 byte per byte of content.
+ */
+typedef struct _digit_index_ {
+  digit_block_t blocks;
+  size_t capacity;
+  size_t generation;
+} digit_index_s, *digit_index_t;
 
 typedef size_t (*fix_pos_f)(size_t pos, size_t diff, bool plus_or_subtract, void* arg);
 
+/**
+ * start_pos_f - start offset of keyword whose matched bytes have length len and end at eo, it is
+ * needed when the scanned text is not the content itself.
+ */
+typedef size_t (*start_pos_f)(size_t eo, size_t len, void* arg);
+
 typedef struct _regex_context_ {
   strlen_s content;
-  dynapool_t pos_cache_pool;
-  avl_t expr_ctx_map;
-  prique_t output_queue;
-  prique_t activate_queue;
+  bool utf16; /* content is UTF-16 code units, len is count of units */
+  size_t generation;
+  arena_pool_t pos_cache_pool;
+  expr_ctx_slot_t expr_ctx_slots;
+  arena_t expr_ctx_arena;
+  avl_stash_s eoso_trees;
+  avl_stash_s soeo_trees;
+  digit_index_s digit_index;
+  output_queue_s output_queue;
+  prique_t activate_queue; /* ordered by expression, and pushed once per expression context in a row */
   fix_pos_f fix_pos_func;
   void* fix_pos_arg;
-  bool reset_or_free;
+  start_pos_f start_pos_func; /* NULL if start offset is eo - len */
+  void* start_pos_arg;
 } reg_ctx_s, *reg_ctx_t;
 
 #ifdef __cplusplus
@@ -5,25 +5,19 @@
  */
 #include "engine.h"
 
+#include "../image.h"
 #include "expr/expr.h"
 
 extern inline void expr_init(expr_t self, expr_t target, expr_feed_f feed);
 extern inline void expr_feed_target(expr_t self, pos_cache_t keyword, reg_ctx_t context);
 
-extern inline void expr_ctx_init(expr_ctx_t self, expr_t expr, expr_ctx_free_f free, expr_ctx_activate_f activate);
+extern inline void expr_ctx_init(expr_ctx_t self, expr_t expr, expr_ctx_activate_f activate);
+extern inline expr_ctx_t expr_ctx_access(reg_ctx_t context, size_t slot);
+extern inline void expr_ctx_attach(reg_ctx_t context, size_t slot, expr_ctx_t expr_ctx);
 
 //
 // compare
 
-sptr_t pos_cache_cmp_output(void* node1, void* node2) {
-  pos_cache_t pos1 = node1, pos2 = node2;
-  if (pos1->pos.eo == pos2->pos.eo) {
-    return pos1->pos.so - pos2->pos.so;
-  } else {
-    return pos1->pos.eo - pos2->pos.eo;
-  }
-}
-
 sptr_t pos_cache_cmp_eoso(avl_node_t node, void* key) {
   pos_cache_t pos_cache = container_of(node, pos_cache_s, embed.avl_elem);
   strpos_t pos_key = (strpos_t)key;
@@ -77,45 +71,218 @@ sptr_t pos_cache_eo_in_range(avl_node_t node, void* arg) {
   }
 }
 
-sptr_t pos_cache_so_in_word(avl_node_t node, void* arg) {
-  pos_cache_t pos_cache = container_of(node, pos_cache_s, embed.avl_elem);
-  strpos_t pos_word = (strpos_t)arg;
-  if (pos_cache->pos.so >= pos_word->eo) {
-    return 1;
-  } else if (pos_cache->pos.so < pos_word->so && pos_cache->pos.eo <= pos_word->so) {
-    return -1;
+//
+// avl stash
+
+void avl_stash_init(avl_stash_t stash, avl_cmp_f cmp) {
+  stash->trees = NULL;
+  stash->used = stash->size = 0;
+  stash->cmp = cmp;
+}
+
+void avl_stash_clean(avl_stash_t stash) {
+  for (size_t i = 0; i < stash->size; i++) {
+    avl_destruct(stash->trees[i]);
+  }
+  afree(stash->trees);
+  stash->trees = NULL;
+  stash->used = stash->size = 0;
+}
+
+avl_t avl_stash_take(avl_stash_t stash) {
+  avl_t tree;
+  if (stash->used < stash->size) {
+    // reset lazily, tree may be dirty since last document
+    tree = stash->trees[stash->used];
+    avl_reset(tree);
   } else {
-    return 0;
+    if ((stash->size & (stash->size - 1)) == 0) {
+      // grow capacity by power of 2
+      void* ptr = arealloc(stash->trees, alib_max(stash->size * 2, 8) * sizeof(avl_t));
+      if (ptr == NULL) {
+        return NULL;
+      }
+      stash->trees = ptr;
+    }
+    tree = avl_construct(stash->cmp);
+    stash->trees[stash->size++] = tree;
   }
+  stash->used++;
+  return tree;
 }
 
-sptr_t pos_cache_eo_in_word(avl_node_t node, void* arg) {
-  pos_cache_t pos_cache = container_of(node, pos_cache_s, embed.avl_elem);
-  strpos_t pos_word = (strpos_t)arg;
-  if (pos_cache->pos.eo <= pos_word->so) {
-    return -1;
-  } else if (pos_cache->pos.eo > pos_word->eo && pos_cache->pos.so >= pos_word->eo) {
-    return 1;
+void avl_stash_reset(avl_stash_t stash) {
+  stash->used = 0;
+}
+
+//
+// output queue
+
+void output_queue_init(output_queue_t queue) {
+  memset(queue->buckets, 0, sizeof(queue->buckets));
+  queue->nonempty = 0;
+  queue->last = 0;
+  queue->len = 0;
+  queue->sorted = true;
+}
+
+void output_queue_clean(output_queue_t queue) {
+  output_queue_init(queue);
+}
+
+void output_queue_reset(output_queue_t queue) {
+  // pos_cache is dropped with pool, only forget buckets
+  if (queue->len > 0) {
+    output_queue_init(queue);
+  }
+}
+
+static inline size_t output_queue_bucket(size_t last, size_t eo) {
+  return eo == last ? 0 : sizeof(unsigned long long) * 8 - __builtin_clzll((unsigned long long)(eo ^ last));
+}
+
+static inline void output_queue_append(output_queue_t queue, pos_cache_t pos_cache) {
+  size_t index = output_queue_bucket(queue->last, pos_cache->pos.eo);
+  output_bucket_t bucket = &queue->buckets[index];
+  pos_cache->embed.output.next = NULL;
+  if (bucket->head == NULL) {
+    bucket->head = pos_cache;
+    if (index > 0) {
+      queue->nonempty |= (uint64_t)1 << (index - 1);
+    }
   } else {
-    return 0;
+    if (index == 0 && pos_cache->pos.so < bucket->tail->pos.so) {
+      queue->sorted = false;
+    }
+    bucket->tail->embed.output.next = pos_cache;
+  }
+  bucket->tail = pos_cache;
+}
+
+/**
+ * output_queue_rebase - move all outputs after 'last' is lowered to eo. it happens only if output is pushed behind
+ * the popped one, which the engine does not do.
+ */
+static void output_queue_rebase(output_queue_t queue, size_t eo) {
+  output_bucket_s buckets[OUTPUT_QUEUE_BUCKETS];
+  memcpy(buckets, queue->buckets, sizeof(buckets));
+  memset(queue->buckets, 0, sizeof(queue->buckets));
+  queue->nonempty = 0;
+  queue->last = eo;
+  queue->sorted = true;
+  for (size_t i = 0; i < OUTPUT_QUEUE_BUCKETS; i++) {
+    pos_cache_t pos_cache = buckets[i].head;
+    while (pos_cache != NULL) {
+      pos_cache_t next = pos_cache->embed.output.next;
+      output_queue_append(queue, pos_cache);
+      pos_cache = next;
+    }
+  }
+}
+
+/**
+ * output_queue_sort - merge sort of list by so. it is stable, so outputs at same position keep order of push.
+ */
+static pos_cache_t output_queue_sort(pos_cache_t list, size_t len) {
+  if (len <= 1) {
+    return list;
+  }
+  pos_cache_t middle = list;
+  for (size_t i = 1; i < len / 2; i++) {
+    middle = middle->embed.output.next;
   }
+  pos_cache_t right = middle->embed.output.next;
+  middle->embed.output.next = NULL;
+  pos_cache_t left = output_queue_sort(list, len / 2);
+  right = output_queue_sort(right, len - len / 2);
+
+  pos_cache_s head;
+  pos_cache_t tail = &head;
+  while (left != NULL && right != NULL) {
+    if (right->pos.so < left->pos.so) {
+      tail->embed.output.next = right;
+      right = right->embed.output.next;
+    } else {
+      tail->embed.output.next = left;
+      left = left->embed.output.next;
+    }
+    tail = tail->embed.output.next;
+  }
+  tail->embed.output.next = left != NULL ? left : right;
+  return head.embed.output.next;
+}
+
+void output_queue_push(output_queue_t queue, pos_cache_t pos_cache) {
+  if (queue->len == 0) {
+    queue->last = pos_cache->pos.eo;
+  } else if (pos_cache->pos.eo < queue->last) {
+    output_queue_rebase(queue, pos_cache->pos.eo);
+  }
+  output_queue_append(queue, pos_cache);
+  queue->len++;
 }
 
-// free for avl
+pos_cache_t output_queue_pop(output_queue_t queue) {
+  if (queue->len == 0) {
+    return NULL;
+  }
+
+  output_bucket_t bucket = &queue->buckets[0];
+  if (bucket->head == NULL) {
+    // split the lowest non-empty bucket around its minimal eo, all outputs of it move to lower buckets
+    size_t index = __builtin_ctzll(queue->nonempty) + 1;
+    pos_cache_t pos_cache = queue->buckets[index].head;
+    queue->buckets[index].head = queue->buckets[index].tail = NULL;
+    queue->nonempty &= ~((uint64_t)1 << (index - 1));
+    size_t last = pos_cache->pos.eo;
+    for (pos_cache_t node = pos_cache->embed.output.next; node != NULL; node = node->embed.output.next) {
+      last = alib_min(last, node->pos.eo);
+    }
+    queue->last = last;
+    while (pos_cache != NULL) {
+      pos_cache_t next = pos_cache->embed.output.next;
+      output_queue_append(queue, pos_cache);
+      pos_cache = next;
+    }
+  }
 
-void free_pos_cache(avl_node_t node, void* arg) {
-  pos_cache_t cache_node = container_of(node, pos_cache_s, embed.avl_elem);
-  reg_ctx_t reg_ctx = (reg_ctx_t)arg;
-  dynapool_free_node(reg_ctx->pos_cache_pool, cache_node);
+  if (!queue->sorted) {
+    size_t len = 0;
+    for (pos_cache_t node = bucket->head; node != NULL; node = node->embed.output.next) {
+      len++;
+    }
+    bucket->head = output_queue_sort(bucket->head, len);
+    for (bucket->tail = bucket->head; bucket->tail->embed.output.next != NULL;) {
+      bucket->tail = bucket->tail->embed.output.next;
+    }
+    queue->sorted = true;
+  }
+
+  pos_cache_t pos_cache = bucket->head;
+  bucket->head = pos_cache->embed.output.next;
+  if (bucket->head == NULL) {
+    bucket->tail = NULL;
+  }
+  queue->len--;
+  return pos_cache;
 }
 
 //
 // reglet
 
+typedef struct _regex_exprerssion_output_ {
+  expr_s header;
+  strhdl_s extra;
+} expr_output_s, *expr_output_t;
+
 reglet_t reglet_alloc() {
   reglet_t reglet = amalloc(sizeof(reglet_s));
   reglet->expr_pool = NULL;
-  reglet->trie = NULL;
+  reglet->expr_size = 0;
+  memset(reglet->expr_count, 0, sizeof(reglet->expr_count));
+  reglet->expr_ctx_count = 0;
+  reglet->builder = NULL;
+  reglet->normalizer = NULL;
   return reglet;
 }
 
@@ -131,34 +298,65 @@ reglet_t reglet_construct() {
   expr_size = alib_max(expr_size, sizeof(expr_ambi_s));
   expr_size = alib_max(expr_size, sizeof(expr_anto_s));
   expr_size = alib_max(expr_size, sizeof(expr_pass_s));
+  expr_size = alib_max(expr_size, sizeof(expr_output_s));
+  reglet->expr_size = expr_size;
   reglet->expr_pool = dynapool_construct(expr_size);
-  reglet->trie = trie_alloc();
+  reglet->builder = dat_builder_construct();
   return reglet;
 }
 
 void reglet_destruct(reglet_t reglet) {
-  dynapool_destruct(reglet->expr_pool);
-  trie_free(reglet->trie, NULL);
-  reglet_free(reglet);
+  if (reglet != NULL) {
+    dynapool_destruct(reglet->expr_pool);
+    dat_builder_destruct(reglet->builder, NULL);
+    reglet_free(reglet);
+  }
 }
 
 static expr_t reglet_build_expr(reglet_t self, ptrn_t pattern, expr_t target, expr_feed_f feed);
 
+static inline void* reglet_alloc_expr(reglet_t self, reg_expr_type_e type) {
+  self->expr_count[type]++;
+  return dynapool_alloc_node(self->expr_pool);
+}
+
 static expr_t reglet_build_expr_for_pure(reglet_t self, ptrn_t pattern, expr_t target, expr_feed_f feed) {
   dstr_t text = pattern->desc;
-  expr_text_t expr_text = dynapool_alloc_node(self->expr_pool);
-  expr_init_text(expr_text, target, feed, text->len);
-  // prepend expr_list
-  list_t expr_list = _(list, &expr_text->header, cons, NULL);
-  list_t old_list = trie_add_keyword(self->trie, text->str, text->len, expr_list);
-  expr_list->cdr = old_list;  // replace NULL
+  char* keyword = text->str;
+  size_t len = text->len;
+  if (self->normalizer != NULL) {
+    // length of expr_text is measured on normalized text, as datrie scans
+    keyword = amalloc(alib_max(len * 4, 1));
+    if (keyword == NULL) {
+      fprintf(stderr, "reglet: normalize keyword failed.\nexit.\n");
+      exit(-1);
+    }
+    len = normalizer_apply(self->normalizer, text->str, text->len, keyword);
+  }
+
+  expr_text_t expr_text = reglet_alloc_expr(self, reg_expr_type_text);
+  expr_init_text(expr_text, target, feed, len);
+  bool succeed = true;
+  if (len > 0 || keyword == text->str) {
+    // lists of same keyword are merged when builder is sealed
+    list_t expr_list = _(list, &expr_text->header, cons, NULL);
+    succeed = dat_builder_add_keyword(self->builder, keyword, len, expr_list);
+  }
+  // else keyword is made of ignored characters only, and never matches
+  if (keyword != text->str) {
+    afree(keyword);
+  }
+  if (!succeed) {
+    fprintf(stderr, "reglet: add keyword failed.\nexit.\n");
+    exit(-1);
+  }
   return &expr_text->header;
 }
 
 static expr_t reglet_build_expr_for_ambi(reglet_t self, ptrn_t pattern, expr_t target, expr_feed_f feed) {
   list_t con = pattern->desc;
-  expr_ambi_t expr_ambi = dynapool_alloc_node(self->expr_pool);
-  expr_init_ambi(expr_ambi, target, feed);
+  expr_ambi_t expr_ambi = reglet_alloc_expr(self, reg_expr_type_ambi);
+  expr_init_ambi(expr_ambi, target, feed, self->expr_ctx_count++);
   ptrn_t center = _(list, con, car);
   ptrn_t ambiguity = _(list, con, cdr);
   reglet_build_expr(self, center, &expr_ambi->header, expr_feed_ambi_center);
@@ -168,8 +366,8 @@ static expr_t reglet_build_expr_for_ambi(reglet_t self, ptrn_t pattern, expr_t t
 
 static expr_t reglet_build_expr_for_anto(reglet_t self, ptrn_t pattern, expr_t target, expr_feed_f feed) {
   list_t con = pattern->desc;
-  expr_anto_t expr_anto = dynapool_alloc_node(self->expr_pool);
-  expr_init_anto(expr_anto, target, feed);
+  expr_anto_t expr_anto = reglet_alloc_expr(self, reg_expr_type_anto);
+  expr_init_anto(expr_anto, target, feed, self->expr_ctx_count++);
   ptrn_t center = _(list, con, car);
   ptrn_t antonym = _(list, con, cdr);
   reglet_build_expr(self, center, &expr_anto->header, expr_feed_anto_center);
@@ -179,8 +377,8 @@ static expr_t reglet_build_expr_for_anto(reglet_t self, ptrn_t pattern, expr_t t
 
 static expr_t reglet_build_expr_for_dist(reglet_t self, ptrn_t pattern, expr_t target, expr_feed_f feed) {
   pdd_t pdd = pattern->desc;
-  expr_dist_t expr_dist = dynapool_alloc_node(self->expr_pool);
-  expr_init_dist(expr_dist, target, feed, pdd->min, pdd->max);
+  expr_dist_t expr_dist = reglet_alloc_expr(self, reg_expr_type_dist);
+  expr_init_dist(expr_dist, target, feed, self->expr_ctx_count++, pdd->min, pdd->max);
   if (pdd->type == ptrn_dist_type_num) {
     reglet_build_expr(self, pdd->head, &expr_dist->header, expr_feed_ddist_prefix);
     reglet_build_expr(self, pdd->tail, &expr_dist->header, expr_feed_ddist_suffix);
@@ -193,7 +391,7 @@ static expr_t reglet_build_expr_for_dist(reglet_t self, ptrn_t pattern, expr_t t
 
 static expr_t reglet_build_expr_for_alter(reglet_t self, ptrn_t pattern, expr_t target, expr_feed_f feed) {
 #ifdef EXPR_PASS_FOR_ALTER
-  expr_pass_t expr_pass = dynapool_alloc_node(self->expr_pool);
+  expr_pass_t expr_pass = reglet_alloc_expr(self, reg_expr_type_pass);
   expr_init_pass(expr_pass, target, feed);
   for (list_t con = pattern->desc; con != NULL; con = con->cdr) {
     ptrn_t sub_ptrn = con->car;
@@ -227,32 +425,374 @@ static expr_t reglet_build_expr(reglet_t self, ptrn_t pattern, expr_t target, ex
   return NULL;
 }
 
-typedef struct _regex_exprerssion_output_ {
-  expr_s header;
-  dstr_t extra;
-} expr_output_s, *expr_output_t;
-
-static void expr_init_output(expr_output_t self, dstr_t extra) {
+static void expr_init_output(expr_output_t self, strhdl_s extra) {
   expr_init(&self->header, NULL, NULL);
   self->extra = extra;
 }
 
 static void expr_feed_output(expr_t expr, pos_cache_t keyword, reg_ctx_t context) {
   expr_output_t self = container_of(expr, expr_output_s, header);
-  keyword->embed.extra = self->extra;
+  keyword->embed.output.extra = &self->extra;
   // push into output queue
-  prique_push(context->output_queue, keyword);
+  output_queue_push(&context->output_queue, keyword);
 }
 
-void reglet_add_pattern(reglet_t self, ptrn_t pattern, dstr_t extra) {
-  expr_output_t expr_output = dynapool_alloc_node(self->expr_pool);
+void reglet_add_pattern(reglet_t self, ptrn_t pattern, strhdl_s extra) {
+  expr_output_t expr_output = reglet_alloc_expr(self, reg_expr_type_output);
   expr_init_output(expr_output, extra);
   reglet_build_expr(self, pattern, &expr_output->header, expr_feed_output);
 }
 
-sptr_t expr_ctx_cmp(avl_node_t node, void* key) {
-  expr_ctx_t expr_ctx = container_of(node, expr_ctx_s, avl_elem);
-  return expr_ctx->expr - (expr_t)key;
+// reglet Image
+// ========================================================
+
+/* feed functions are dumped as index of this table */
+static const expr_feed_f reglet_image_feeds[] = {
+    NULL,
+    expr_feed_output,
+    expr_feed_ambi_center,
+    expr_feed_ambi_ambiguity,
+    expr_feed_anto_center,
+    expr_feed_anto_antonym,
+    expr_feed_dist_prefix,
+    expr_feed_dist_suffix,
+    expr_feed_ddist_prefix,
+    expr_feed_ddist_suffix,
+    expr_feed_pass,
+};
+
+/* type of target which is fed by the function */
+static const reg_expr_type_e reglet_image_feed_types[] = {
+    reg_expr_type_count, reg_expr_type_output, reg_expr_type_ambi, reg_expr_type_ambi,
+    reg_expr_type_anto,  reg_expr_type_anto,   reg_expr_type_dist, reg_expr_type_dist,
+    reg_expr_type_dist,  reg_expr_type_dist,   reg_expr_type_pass,
+};
+
+#define REGLET_IMAGE_FEED_COUNT (sizeof(reglet_image_feeds) / sizeof(reglet_image_feeds[0]))
+
+typedef struct _regex_image_expr_ {
+  uint32_t type, feed;
+  uint64_t target; /* index of expression plus 1, or 0 */
+  uint64_t args[3];
+} reg_image_expr_s;
+
+static int reglet_image_expr_cmp(const void* a, const void* b) {
+  expr_t ea = *(const expr_t*)a, eb = *(const expr_t*)b;
+  return ea < eb ? -1 : (ea > eb ? 1 : 0);
+}
+
+static size_t reglet_image_expr_index(expr_t* exprs, size_t count, expr_t expr) {
+  expr_t* found = bsearch(&expr, exprs, count, sizeof(expr_t), reglet_image_expr_cmp);
+  return found == NULL ? (size_t)-1 : (size_t)(found - exprs);
+}
+
+static size_t reglet_image_feed_index(expr_feed_f feed) {
+  for (size_t i = 0; i < REGLET_IMAGE_FEED_COUNT; i++) {
+    if (reglet_image_feeds[i] == feed) {
+      return i;
+    }
+  }
+  return (size_t)-1;
+}
+
+static void reglet_image_list_free(list_t list) {
+  for (list_t con = list; con != NULL; con = con->cdr) {
+    con->car = NULL;  // car is expr_t, not aobj
+  }
+  _release(list);
+}
+
+/**
+ * expressions are collected from leaves, and dumped by order of address. So the activation order, which is
+ * compared by address of expression, is kept after loaded.
+ */
+static expr_t* reglet_image_collect(void* value_list[], size_t value_count, size_t* count) {
+  expr_t* exprs = NULL;
+  size_t len = 0, capacity = 0;
+  for (size_t i = 0; i < value_count; i++) {
+    for (list_t con = value_list[i]; con != NULL; con = con->cdr) {
+      for (expr_t expr = con->car; expr != NULL; expr = expr->target) {
+        if (len == capacity) {
+          capacity = alib_max(capacity * 2, 256);
+          expr_t* buffer = arealloc(exprs, capacity * sizeof(expr_t));
+          if (buffer == NULL) {
+            afree(exprs);
+            return NULL;
+          }
+          exprs = buffer;
+        }
+        exprs[len++] = expr;
+      }
+    }
+  }
+
+  if (len > 0) {
+    qsort(exprs, len, sizeof(expr_t), reglet_image_expr_cmp);
+    size_t unique = 1;
+    for (size_t i = 1; i < len; i++) {
+      if (exprs[i] != exprs[unique - 1]) {
+        exprs[unique++] = exprs[i];
+      }
+    }
+    len = unique;
+  }
+
+  *count = len;
+  return exprs;
+}
+
+static bool reglet_image_fill(reg_image_expr_s* image, expr_t expr) {
+  memset(image->args, 0, sizeof(image->args));
+  switch (image->type) {
+    case reg_expr_type_text:
+      image->args[0] = container_of(expr, expr_text_s, header)->len;
+      break;
+    case reg_expr_type_dist: {
+      expr_dist_t dist = container_of(expr, expr_dist_s, header);
+      image->args[0] = dist->slot;
+      image->args[1] = dist->min;
+      image->args[2] = dist->max;
+      break;
+    }
+    case reg_expr_type_ambi:
+      image->args[0] = container_of(expr, expr_ambi_s, header)->slot;
+      break;
+    case reg_expr_type_anto:
+      image->args[0] = container_of(expr, expr_anto_s, header)->slot;
+      break;
+    case reg_expr_type_pass:
+      break;
+    case reg_expr_type_output: {
+      expr_output_t output = container_of(expr, expr_output_s, header);
+      image->args[0] = output->extra.offset;
+      image->args[1] = output->extra.len;
+      break;
+    }
+    default:
+      return false;
+  }
+  return true;
+}
+
+bool reglet_dump(reglet_t self, void* value_list[], size_t value_count, FILE* fp) {
+  size_t count = 0;
+  expr_t* exprs = reglet_image_collect(value_list, value_count, &count);
+  reg_image_expr_s* images = amalloc(alib_max(count, 1) * sizeof(reg_image_expr_s));
+  bool succeed = images != NULL && (exprs != NULL || count == 0);
+
+  // leaves are text, others are known by feed of children
+  for (size_t i = 0; succeed && i < count; i++) {
+    images[i].type = exprs[i]->target == NULL ? reg_expr_type_output : reg_expr_type_count;
+  }
+  for (size_t i = 0; succeed && i < value_count; i++) {
+    for (list_t con = value_list[i]; con != NULL; con = con->cdr) {
+      images[reglet_image_expr_index(exprs, count, con->car)].type = reg_expr_type_text;
+    }
+  }
+  for (size_t i = 0; succeed && i < count; i++) {
+    size_t feed = reglet_image_feed_index(exprs[i]->target_feed);
+    if (feed == (size_t)-1) {
+      succeed = false;
+      break;
+    }
+    images[i].feed = feed;
+    images[i].target = 0;
+    if (exprs[i]->target != NULL) {
+      size_t target = reglet_image_expr_index(exprs, count, exprs[i]->target);
+      images[i].target = target + 1;
+      images[target].type = reglet_image_feed_types[feed];
+    }
+  }
+  for (size_t i = 0; succeed && i < count; i++) {
+    succeed = reglet_image_fill(&images[i], exprs[i]);
+  }
+
+  succeed = succeed && image_write_size(fp, count) && image_write_size(fp, self->expr_ctx_count) &&
+            image_write(fp, images, count * sizeof(reg_image_expr_s)) && image_write_size(fp, value_count);
+
+  for (size_t i = 0; succeed && i < value_count; i++) {
+    size_t len = 0;
+    for (list_t con = value_list[i]; con != NULL; con = con->cdr) {
+      len++;
+    }
+    succeed = image_write_size(fp, len);
+    for (list_t con = value_list[i]; succeed && con != NULL; con = con->cdr) {
+      succeed = image_write_size(fp, reglet_image_expr_index(exprs, count, con->car));
+    }
+  }
+
+  afree(images);
+  afree(exprs);
+  return succeed;
+}
+
+/**
+ * reglet_image_check - only output has no target, and target must be of the type which feed function expects,
+ * otherwise feed function takes expression of other type by container_of.
+ */
+static bool reglet_image_check(reg_image_expr_s* images, size_t count, size_t index, size_t extra_size) {
+  reg_image_expr_s* image = &images[index];
+  if (image->type >= reg_expr_type_count || image->feed >= REGLET_IMAGE_FEED_COUNT || image->target > count) {
+    return false;
+  }
+  if (image->type == reg_expr_type_output) {
+    // extra is terminated by '\0' in pool
+    return image->target == 0 && image->feed == 0 &&
+           (image->args[1] == 0 || (image->args[1] < extra_size && image->args[0] < extra_size - image->args[1]));
+  }
+  if (image->target == 0 || image->feed == 0 ||
+      images[image->target - 1].type != reglet_image_feed_types[image->feed]) {
+    return false;
+  }
+  // start of keyword is end minus len, keyword is not empty
+  return image->type != reg_expr_type_text || image->args[0] > 0;
+}
+
+/**
+ * reglet_image_acyclic - every expression reaches output by targets. each expression has one target, so a walk
+ * which meets expression visited by itself is a cycle.
+ */
+static bool reglet_image_acyclic(reg_image_expr_s* images, size_t count) {
+  size_t* walks = amalloc(alib_max(count, 1) * sizeof(size_t));
+  if (walks == NULL) {
+    return false;
+  }
+  memset(walks, 0, alib_max(count, 1) * sizeof(size_t));
+
+  bool acyclic = true;
+  for (size_t i = 0; acyclic && i < count; i++) {
+    // walks[j] is 1 + index of walk which visited j
+    size_t j = i;
+    while (walks[j] == 0) {
+      walks[j] = i + 1;
+      if (images[j].target == 0) {
+        break;
+      }
+      j = images[j].target - 1;
+    }
+    acyclic = walks[j] != i + 1 || images[j].target == 0;
+  }
+
+  afree(walks);
+  return acyclic;
+}
+
+static bool reglet_image_init(reglet_t self, reg_image_expr_s* image, expr_t* exprs, size_t index) {
+  expr_t target = image->target == 0 ? NULL : exprs[image->target - 1];
+  expr_feed_f feed = reglet_image_feeds[image->feed];
+  expr_t expr = exprs[index];
+  switch (image->type) {
+    case reg_expr_type_text:
+      expr_init_text(container_of(expr, expr_text_s, header), target, feed, image->args[0]);
+      break;
+    case reg_expr_type_dist:
+      if (image->args[0] >= self->expr_ctx_count) {
+        return false;
+      }
+      expr_init_dist(container_of(expr, expr_dist_s, header), target, feed, image->args[0], image->args[1],
+                     image->args[2]);
+      break;
+    case reg_expr_type_ambi:
+      if (image->args[0] >= self->expr_ctx_count) {
+        return false;
+      }
+      expr_init_ambi(container_of(expr, expr_ambi_s, header), target, feed, image->args[0]);
+      break;
+    case reg_expr_type_anto:
+      if (image->args[0] >= self->expr_ctx_count) {
+        return false;
+      }
+      expr_init_anto(container_of(expr, expr_anto_s, header), target, feed, image->args[0]);
+      break;
+    case reg_expr_type_pass:
+      expr_init_pass(container_of(expr, expr_pass_s, header), target, feed);
+      break;
+    case reg_expr_type_output:
+      expr_init_output(container_of(expr, expr_output_s, header),
+                       (strhdl_s){.offset = image->args[0], .len = image->args[1]});
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+reglet_t reglet_load(FILE* fp, size_t extra_size, void*** value_list, size_t* value_count) {
+  size_t count, ctx_count;
+  // every context slot is taken by one expression
+  if (!image_read_size(fp, &count) || !image_read_size(fp, &ctx_count) ||
+      !image_fits(fp, count, sizeof(reg_image_expr_s)) || ctx_count > count) {
+    return NULL;
+  }
+
+  reglet_t reglet = reglet_construct();
+  dat_builder_destruct(reglet->builder, NULL);
+  reglet->builder = NULL;
+  reglet->expr_ctx_count = ctx_count;
+
+  reg_image_expr_s* images = amalloc(alib_max(count, 1) * sizeof(reg_image_expr_s));
+  expr_t* exprs = amalloc(alib_max(count, 1) * sizeof(expr_t));
+  void** lists = NULL;
+  size_t list_count = 0, i = 0;
+  bool succeed = images != NULL && exprs != NULL && image_read(fp, images, count * sizeof(reg_image_expr_s));
+
+  for (i = 0; succeed && i < count; i++) {
+    succeed = reglet_image_check(images, count, i, extra_size);
+  }
+  succeed = succeed && reglet_image_acyclic(images, count);
+
+  // allocate by order of address, then link them
+  for (i = 0; succeed && i < count; i++) {
+    exprs[i] = reglet_alloc_expr(reglet, images[i].type);
+  }
+  for (i = 0; succeed && i < count; i++) {
+    succeed = reglet_image_init(reglet, &images[i], exprs, i);
+  }
+
+  succeed = succeed && image_read_size(fp, &list_count) && image_fits(fp, list_count, sizeof(uint64_t));
+  if (succeed) {
+    lists = amalloc(alib_max(list_count, 1) * sizeof(void*));
+    succeed = lists != NULL;
+  }
+  for (i = 0; succeed && i < list_count; i++) {
+    size_t len, index;
+    list_t list = NULL;
+    succeed = image_read_size(fp, &len) && len <= count;
+    // items are read in order, so build list in reverse then flip it
+    for (size_t j = 0; succeed && j < len; j++) {
+      // leaves are text, engine takes them as expr_text_s
+      succeed = image_read_size(fp, &index) && index < count && images[index].type == reg_expr_type_text;
+      if (succeed) {
+        list_t con = _(list, exprs[index], cons, NULL);
+        con->cdr = list;  // take over the reference, as builder does
+        list = con;
+      }
+    }
+    list_t reversed = NULL;
+    while (list != NULL) {
+      list_t next = list->cdr;
+      list->cdr = reversed;
+      reversed = list;
+      list = next;
+    }
+    lists[i] = reversed;
+  }
+
+  afree(images);
+  afree(exprs);
+
+  if (!succeed) {
+    for (size_t j = 0; lists != NULL && j < i; j++) {
+      reglet_image_list_free(lists[j]);
+    }
+    afree(lists);
+    reglet_destruct(reglet);
+    return NULL;
+  }
+
+  *value_list = lists;
+  *value_count = list_count;
+  return reglet;
 }
 
 sptr_t expr_ctx_cmp2(void* node1, void* node2) {
@@ -274,31 +814,38 @@ static size_t default_fix_pos(size_t pos, size_t diff, bool plus_or_subtract, vo
 
 reg_ctx_t reglet_alloc_context(reglet_t reglet) {
   reg_ctx_t reg_ctx = amalloc(sizeof(reg_ctx_s));
-  reg_ctx->pos_cache_pool = dynapool_construct_with_type(pos_cache_s);
-  reg_ctx->expr_ctx_map = avl_construct(expr_ctx_cmp);
-  reg_ctx->output_queue = prique_construct(pos_cache_cmp_output);
+  reg_ctx->content = (strlen_s){.ptr = NULL, .len = 0};
+  reg_ctx->utf16 = false;
+  reg_ctx->generation = 1;
+  reg_ctx->pos_cache_pool = arena_pool_construct_with_type(pos_cache_s);
+  // generation of slot is 0, so all slots are detached
+  reg_ctx->expr_ctx_slots = amalloc(alib_max(reglet->expr_ctx_count, 1) * sizeof(expr_ctx_slot_s));
+  memset(reg_ctx->expr_ctx_slots, 0, alib_max(reglet->expr_ctx_count, 1) * sizeof(expr_ctx_slot_s));
+  reg_ctx->expr_ctx_arena = arena_construct(4096);
+  avl_stash_init(&reg_ctx->eoso_trees, pos_cache_cmp_eoso);
+  avl_stash_init(&reg_ctx->soeo_trees, pos_cache_cmp_soeo);
+  reg_ctx->digit_index = (digit_index_s){.blocks = NULL, .capacity = 0, .generation = 0};
+  output_queue_init(&reg_ctx->output_queue);
   reg_ctx->activate_queue = prique_construct(expr_ctx_cmp2);
   reg_ctx->fix_pos_func = default_fix_pos;
   reg_ctx->fix_pos_arg = NULL;
+  reg_ctx->start_pos_func = NULL;
+  reg_ctx->start_pos_arg = NULL;
   return reg_ctx;
 }
 
-void free_expr_ctx(avl_node_t node, void* arg) {
-  expr_ctx_t expr_ctx = container_of(node, expr_ctx_s, avl_elem);
-  reg_ctx_t reg_ctx = (reg_ctx_t)arg;
-  expr_ctx->free_func(expr_ctx, reg_ctx);
-}
-
 void reglet_free_context(reg_ctx_t context) {
   if (context != NULL) {
-    context->reset_or_free = false;
-    // free expr_ctx and map
-    avl_walk_in_order(context->expr_ctx_map, NULL, free_expr_ctx, NULL, context);
-    avl_destruct(context->expr_ctx_map);
+    // expr_ctx is placed in arena, and pos_cache will be freed with pool
+    afree(context->expr_ctx_slots);
+    arena_destruct(context->expr_ctx_arena);
+    avl_stash_clean(&context->eoso_trees);
+    avl_stash_clean(&context->soeo_trees);
+    afree(context->digit_index.blocks);
     // free pos_cache pool
-    dynapool_destruct(context->pos_cache_pool);
+    arena_pool_destruct(context->pos_cache_pool);
     // free output queue
-    prique_destruct(context->output_queue);
+    output_queue_clean(&context->output_queue);
     // free activate queue
     prique_destruct(context->activate_queue);
     // free context
@@ -309,21 +856,29 @@ void reglet_free_context(reg_ctx_t context) {
 void reglet_reset_context(reg_ctx_t context, char content[], size_t len) {
   if (context != NULL) {
     context->content = (strlen_s){.ptr = content, .len = len};
-
-    context->reset_or_free = true;
-    // free expression context, and clear map
-    avl_walk_in_order(context->expr_ctx_map, NULL, free_expr_ctx, NULL, context);
-    avl_reset(context->expr_ctx_map);
+    context->utf16 = false;
+
+    // detach all expression contexts, slot will be checked when accessed
+    context->generation++;
+    // drop all expression contexts and pos_cache at once
+    arena_reset(context->expr_ctx_arena);
+    arena_pool_reset(context->pos_cache_pool);
+    avl_stash_reset(&context->eoso_trees);
+    avl_stash_reset(&context->soeo_trees);
     // clear output_queue
-    for (size_t i = 1; i <= context->output_queue->len; i++) {
-      dynapool_free_node(context->pos_cache_pool, context->output_queue->data);
-    }
-    context->output_queue->len = 0;
+    output_queue_reset(&context->output_queue);
     // clear activate expr_ctx queue
     context->activate_queue->len = 0;
   }
 }
 
+void reglet_reset_context_utf16(reg_ctx_t context, const uint16_t content[], size_t len) {
+  if (context != NULL) {
+    reglet_reset_context(context, (char*)content, len);
+    context->utf16 = true;
+  }
+}
+
 void reglet_fix_pos(reg_ctx_t context, fix_pos_f fix_pos_func, void* fix_pos_arg) {
   if (fix_pos_func != NULL) {
     context->fix_pos_func = fix_pos_func;
@@ -334,6 +889,11 @@ void reglet_fix_pos(reg_ctx_t context, fix_pos_f fix_pos_func, void* fix_pos_arg
   }
 }
 
+void reglet_start_pos(reg_ctx_t context, start_pos_f start_pos_func, void* start_pos_arg) {
+  context->start_pos_func = start_pos_func;
+  context->start_pos_arg = start_pos_func != NULL ? start_pos_arg : NULL;
+}
+
 void reglet_activate_expr_ctx(reg_ctx_t context) {
   expr_ctx_t expr_ctx = prique_pop(context->activate_queue);
   while (expr_ctx != NULL) {
@@ -6,28 +6,58 @@
 #ifndef __ACTRIE_REGEX_ENGINE_H__
 #define __ACTRIE_REGEX_ENGINE_H__
 
+#include "../normalizer.h"
 #include "../pattern.h"
-#include "../trie/actrie.h"
+#include "../trie/datbuilder.h"
 #include "context.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
 
+typedef enum _regex_expr_type_ {
+  reg_expr_type_text = 0,
+  reg_expr_type_dist,
+  reg_expr_type_ambi,
+  reg_expr_type_anto,
+  reg_expr_type_pass,
+  reg_expr_type_output,
+  reg_expr_type_count
+} reg_expr_type_e;
+
 typedef struct _regex_applet_ {
   dynapool_t expr_pool;
-  trie_t trie;
+  size_t expr_size;                        /* node size of expr_pool */
+  size_t expr_count[reg_expr_type_count];  /* allocated expressions by type */
+  size_t expr_ctx_count; /* number of expressions which need context */
+  dat_builder_t builder; /* keywords of texts, values are lists of expr_text */
+  normalizer_t normalizer; /* borrowed, keywords are normalized before added to builder if not NULL */
 } reglet_s, *reglet_t;
 
 reglet_t reglet_construct();
 void reglet_destruct(reglet_t reglet);
 
-void reglet_add_pattern(reglet_t self, ptrn_t pattern, dstr_t extra);
+void reglet_add_pattern(reglet_t self, ptrn_t pattern, strhdl_s extra);
+
+/**
+ * reglet_dump - dump expressions reachable from the lists of leaves, and the lists.
+ */
+bool reglet_dump(reglet_t self, void* value_list[], size_t value_count, FILE* fp);
+
+/**
+ * reglet_load - extra of output is checked against extra_size, the size of loaded pool.
+ */
+reglet_t reglet_load(FILE* fp, size_t extra_size, void*** value_list, size_t* value_count);
 
 reg_ctx_t reglet_alloc_context(reglet_t reglet);
 void reglet_free_context(reg_ctx_t context);
 void reglet_reset_context(reg_ctx_t context, char content[], size_t len);
+/**
+ * reglet_reset_context_utf16 - content is UTF-16 code units, and positions are counted by units.
+ */
+void reglet_reset_context_utf16(reg_ctx_t context, const uint16_t content[], size_t len);
 void reglet_fix_pos(reg_ctx_t context, fix_pos_f fix_pos_func, void* fix_pos_arg);
+void reglet_start_pos(reg_ctx_t context, start_pos_f start_pos_func, void* start_pos_arg);
 
 void reglet_activate_expr_ctx(reg_ctx_t context);
 
@@ -5,77 +5,126 @@
  */
 #include "ambi.h"
 
+#include <stdlib.h>
+
+/**
+ * ambiguity_span - position of ambiguity, with the minimal so of all spans behind it in eo order.
+ */
+typedef struct _ambiguity_span_ {
+  strpos_s pos;
+  size_t min_so;
+} ambi_span_s, *ambi_span_t;
+
 typedef struct _expression_anti_ambiguity_context_ {
   expr_ctx_s header;
-  avl_t ambiguity_cache_eoso;
-  avl_t ambiguity_cache_soeo;
+  ambi_span_t spans;
+  size_t count, capacity;
+  size_t indexed; /* count of spans covered by min_so */
+  bool ordered;   /* spans are appended in eo order */
   deque_node_s center_queue[1];
 } ambi_ctx_s, *ambi_ctx_t;
 
-void ambi_ctx_free(expr_ctx_t expr_ctx, reg_ctx_t reg_ctx) {
-  ambi_ctx_t ambi_ctx = container_of(expr_ctx, ambi_ctx_s, header);
+void expr_activate_ambi_ctx(expr_ctx_t expr_ctx, reg_ctx_t context);
+
+ambi_ctx_t ambi_ctx_alloc(expr_ambi_t expr_ambi, reg_ctx_t reg_ctx) {
+  // ambi_ctx and spans are recycled by reg_ctx
+  ambi_ctx_t ambi_ctx = arena_alloc(reg_ctx->expr_ctx_arena, sizeof(ambi_ctx_s));
+  expr_ctx_init(&ambi_ctx->header, &expr_ambi->header, expr_activate_ambi_ctx);
+  ambi_ctx->spans = NULL;
+  ambi_ctx->count = ambi_ctx->capacity = 0;
+  ambi_ctx->indexed = 0;
+  ambi_ctx->ordered = true;
+  deque_init(ambi_ctx->center_queue);
+  expr_ctx_attach(reg_ctx, expr_ambi->slot, &ambi_ctx->header);
+  return ambi_ctx;
+}
 
-  if (reg_ctx->reset_or_free) {
-    avl_walk_in_order(ambi_ctx->ambiguity_cache_eoso, NULL, free_pos_cache, NULL, reg_ctx);
-    avl_walk_in_order(ambi_ctx->ambiguity_cache_soeo, NULL, free_pos_cache, NULL, reg_ctx);
+static ambi_ctx_t ambi_ctx_access(expr_ambi_t expr_ambi, reg_ctx_t reg_ctx) {
+  expr_ctx_t expr_ctx = expr_ctx_access(reg_ctx, expr_ambi->slot);
+  if (expr_ctx == NULL) {
+    return ambi_ctx_alloc(expr_ambi, reg_ctx);
+  }
+  return container_of(expr_ctx, ambi_ctx_s, header);
+}
 
-    pos_cache_t pos_cache = deque_pop_front(ambi_ctx->center_queue, pos_cache_s, embed.deque_elem);
-    while (pos_cache != NULL) {
-      dynapool_free_node(reg_ctx->pos_cache_pool, pos_cache);
-      pos_cache = deque_pop_front(ambi_ctx->center_queue, pos_cache_s, embed.deque_elem);
+static void ambi_ctx_append(ambi_ctx_t ambi_ctx, strpos_t pos, reg_ctx_t reg_ctx) {
+  if (ambi_ctx->count == ambi_ctx->capacity) {
+    // old spans are dropped with arena
+    size_t capacity = ambi_ctx->capacity == 0 ? 16 : ambi_ctx->capacity * 2;
+    ambi_span_t spans = arena_alloc(reg_ctx->expr_ctx_arena, sizeof(ambi_span_s) * capacity);
+    if (ambi_ctx->count > 0) {
+      memcpy(spans, ambi_ctx->spans, sizeof(ambi_span_s) * ambi_ctx->count);
     }
+    ambi_ctx->spans = spans;
+    ambi_ctx->capacity = capacity;
   }
 
-  avl_destruct(ambi_ctx->ambiguity_cache_eoso);
-  avl_destruct(ambi_ctx->ambiguity_cache_soeo);
+  if (ambi_ctx->count > 0 && ambi_ctx->spans[ambi_ctx->count - 1].pos.eo > pos->eo) {
+    ambi_ctx->ordered = false;
+  }
+  ambi_ctx->spans[ambi_ctx->count++].pos = *pos;
+}
 
-  afree(ambi_ctx);
+static int ambi_span_cmp(const void* a, const void* b) {
+  const ambi_span_s *span1 = a, *span2 = b;
+  if (span1->pos.eo != span2->pos.eo) {
+    return span1->pos.eo < span2->pos.eo ? -1 : 1;
+  }
+  return span1->pos.so < span2->pos.so ? -1 : span1->pos.so > span2->pos.so;
 }
 
-void expr_activate_ambi_ctx(expr_ctx_t expr_ctx, reg_ctx_t context);
+/**
+ * build suffix minimum of so, then spans whose eo greater than x are a suffix of array.
+ */
+static void ambi_ctx_index(ambi_ctx_t ambi_ctx) {
+  if (!ambi_ctx->ordered) {
+    qsort(ambi_ctx->spans, ambi_ctx->count, sizeof(ambi_span_s), ambi_span_cmp);
+    ambi_ctx->ordered = true;
+  }
 
-ambi_ctx_t ambi_ctx_alloc(expr_ambi_t expr_ambi) {
-  ambi_ctx_t ambi_ctx = amalloc(sizeof(ambi_ctx_s));
-  expr_ctx_init(&ambi_ctx->header, &expr_ambi->header, ambi_ctx_free, expr_activate_ambi_ctx);
-  ambi_ctx->ambiguity_cache_eoso = avl_construct(pos_cache_cmp_eoso);
-  ambi_ctx->ambiguity_cache_soeo = avl_construct(pos_cache_cmp_soeo);
-  deque_init(ambi_ctx->center_queue);
-  return ambi_ctx;
+  size_t min_so = SIZE_MAX;
+  for (size_t i = ambi_ctx->count; i > 0; i--) {
+    ambi_span_t span = &ambi_ctx->spans[i - 1];
+    if (span->pos.so < min_so) {
+      min_so = span->pos.so;
+    }
+    span->min_so = min_so;
+  }
+  ambi_ctx->indexed = ambi_ctx->count;
+}
+
+static bool ambi_ctx_overlap(ambi_ctx_t ambi_ctx, strpos_t pos) {
+  // find first span that eo greater than pos->so
+  size_t lo = 0, hi = ambi_ctx->count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (ambi_ctx->spans[mid].pos.eo <= pos->so) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo < ambi_ctx->count && ambi_ctx->spans[lo].min_so < pos->eo;
 }
 
-void expr_init_ambi(expr_ambi_t self, expr_t target, expr_feed_f feed) {
+void expr_init_ambi(expr_ambi_t self, expr_t target, expr_feed_f feed, size_t slot) {
   expr_init(&self->header, target, feed);
+  self->slot = slot;
 }
 
 void expr_feed_ambi_ambiguity(expr_t expr, pos_cache_t ambiguity, reg_ctx_t context) {
   expr_ambi_t self = container_of(expr, expr_ambi_s, header);
 
-  ambi_ctx_t ambi_ctx;
-  avl_node_t node = avl_search(context->expr_ctx_map, expr);
-  if (node == NULL) {
-    ambi_ctx = ambi_ctx_alloc(self);
-    avl_insert(context->expr_ctx_map, expr, &ambi_ctx->header.avl_elem);
-  } else {
-    ambi_ctx = container_of(node, ambi_ctx_s, header.avl_elem);
-  }
+  ambi_ctx_t ambi_ctx = ambi_ctx_access(self, context);
 
-  pos_cache_t ambiguity2 = dynapool_alloc_node(context->pos_cache_pool);
-  ambiguity2->pos = ambiguity->pos;
-  avl_insert(ambi_ctx->ambiguity_cache_eoso, &ambiguity->pos, &ambiguity->embed.avl_elem);
-  avl_insert(ambi_ctx->ambiguity_cache_soeo, &ambiguity2->pos, &ambiguity2->embed.avl_elem);
+  ambi_ctx_append(ambi_ctx, &ambiguity->pos, context);
+  arena_pool_free_node(context->pos_cache_pool, ambiguity);
 }
 
 void expr_feed_ambi_center(expr_t expr, pos_cache_t center, reg_ctx_t context) {
   expr_ambi_t self = container_of(expr, expr_ambi_s, header);
 
-  ambi_ctx_t ambi_ctx;
-  avl_node_t node = avl_search(context->expr_ctx_map, expr);
-  if (node == NULL) {
-    ambi_ctx = ambi_ctx_alloc(self);
-    avl_insert(context->expr_ctx_map, expr, &ambi_ctx->header.avl_elem);
-  } else {
-    ambi_ctx = container_of(node, ambi_ctx_s, header.avl_elem);
-  }
+  ambi_ctx_t ambi_ctx = ambi_ctx_access(self, context);
 
   if (deque_empty(ambi_ctx->center_queue)) {
     prique_push(context->activate_queue, &ambi_ctx->header);
@@ -85,13 +134,16 @@ void expr_feed_ambi_center(expr_t expr, pos_cache_t center, reg_ctx_t context) {
 
 void expr_activate_ambi_ctx(expr_ctx_t expr_ctx, reg_ctx_t context) {
   ambi_ctx_t ambi_ctx = container_of(expr_ctx, ambi_ctx_s, header);
+  if (ambi_ctx->indexed != ambi_ctx->count) {
+    ambi_ctx_index(ambi_ctx);
+  }
+
   pos_cache_t center = deque_pop_front(ambi_ctx->center_queue, pos_cache_s, embed.deque_elem);
   while (center != NULL) {
-    if (avl_search_ext(ambi_ctx->ambiguity_cache_eoso, center, pos_cache_eo_in_word) == NULL &&
-        avl_search_ext(ambi_ctx->ambiguity_cache_soeo, center, pos_cache_so_in_word) == NULL) {
+    if (!ambi_ctx_overlap(ambi_ctx, &center->pos)) {
       expr_feed_target(ambi_ctx->header.expr, center, context);
     } else {
-      dynapool_free_node(context->pos_cache_pool, center);
+      arena_pool_free_node(context->pos_cache_pool, center);
     }
     center = deque_pop_front(ambi_ctx->center_queue, pos_cache_s, embed.deque_elem);
   }
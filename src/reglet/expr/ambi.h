@@ -14,9 +14,10 @@ extern "C" {
 
 typedef struct _regex_expression_anti_ambiguity_ {
   expr_s header;
+  size_t slot; /* index of expr_ctx_slot */
 } expr_ambi_s, *expr_ambi_t;
 
-void expr_init_ambi(expr_ambi_t self, expr_t target, expr_feed_f feed);
+void expr_init_ambi(expr_ambi_t self, expr_t target, expr_feed_f feed, size_t slot);
 
 void expr_feed_ambi_ambiguity(expr_t self, pos_cache_t ambiguity, reg_ctx_t context);
 void expr_feed_ambi_center(expr_t self, pos_cache_t center, reg_ctx_t context);
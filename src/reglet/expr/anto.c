@@ -11,49 +11,35 @@ typedef struct _expression_anti_antonym_context_ {
   deque_node_s center_queue[1];
 } anto_ctx_s, *anto_ctx_t;
 
-void anto_ctx_free(expr_ctx_t expr_ctx, reg_ctx_t reg_ctx) {
-  anto_ctx_t anto_ctx = container_of(expr_ctx, anto_ctx_s, header);
-
-  if (reg_ctx->reset_or_free) {
-    avl_walk_in_order(anto_ctx->antonym_cache, NULL, free_pos_cache, NULL, reg_ctx);
-  }
-
-  avl_destruct(anto_ctx->antonym_cache);
-
-  pos_cache_t center = deque_pop_front(anto_ctx->center_queue, pos_cache_s, embed.deque_elem);
-  while (center != NULL) {
-    dynapool_free_node(reg_ctx->pos_cache_pool, center);
-    center = deque_pop_front(anto_ctx->center_queue, pos_cache_s, embed.deque_elem);
-  }
-
-  afree(anto_ctx);
-}
-
 void expr_activate_anto_ctx(expr_ctx_t expr_ctx, reg_ctx_t context);
 
-anto_ctx_t anto_ctx_alloc(expr_anto_t expr_anto) {
-  anto_ctx_t anto_ctx = amalloc(sizeof(anto_ctx_s));
-  expr_ctx_init(&anto_ctx->header, &expr_anto->header, anto_ctx_free, expr_activate_anto_ctx);
-  anto_ctx->antonym_cache = avl_construct(pos_cache_cmp_eoso);
+anto_ctx_t anto_ctx_alloc(expr_anto_t expr_anto, reg_ctx_t reg_ctx) {
+  // anto_ctx and tree are recycled by reg_ctx
+  anto_ctx_t anto_ctx = arena_alloc(reg_ctx->expr_ctx_arena, sizeof(anto_ctx_s));
+  expr_ctx_init(&anto_ctx->header, &expr_anto->header, expr_activate_anto_ctx);
+  anto_ctx->antonym_cache = avl_stash_take(&reg_ctx->eoso_trees);
   deque_init(anto_ctx->center_queue);
+  expr_ctx_attach(reg_ctx, expr_anto->slot, &anto_ctx->header);
   return anto_ctx;
 }
 
-void expr_init_anto(expr_anto_t self, expr_t target, expr_feed_f feed) {
+static anto_ctx_t anto_ctx_access(expr_anto_t expr_anto, reg_ctx_t reg_ctx) {
+  expr_ctx_t expr_ctx = expr_ctx_access(reg_ctx, expr_anto->slot);
+  if (expr_ctx == NULL) {
+    return anto_ctx_alloc(expr_anto, reg_ctx);
+  }
+  return container_of(expr_ctx, anto_ctx_s, header);
+}
+
+void expr_init_anto(expr_anto_t self, expr_t target, expr_feed_f feed, size_t slot) {
   expr_init(&self->header, target, feed);
+  self->slot = slot;
 }
 
 void expr_feed_anto_antonym(expr_t expr, pos_cache_t antonym, reg_ctx_t context) {
   expr_anto_t self = container_of(expr, expr_anto_s, header);
 
-  anto_ctx_t anto_ctx;
-  avl_node_t node = avl_search(context->expr_ctx_map, expr);
-  if (node == NULL) {
-    anto_ctx = anto_ctx_alloc(self);
-    avl_insert(context->expr_ctx_map, expr, &anto_ctx->header.avl_elem);
-  } else {
-    anto_ctx = container_of(node, anto_ctx_s, header.avl_elem);
-  }
+  anto_ctx_t anto_ctx = anto_ctx_access(self, context);
 
   avl_insert(anto_ctx->antonym_cache, &antonym->pos, &antonym->embed.avl_elem);
 }
@@ -61,14 +47,7 @@ void expr_feed_anto_antonym(expr_t expr, pos_cache_t antonym, reg_ctx_t context)
 void expr_feed_anto_center(expr_t expr, pos_cache_t center, reg_ctx_t context) {
   expr_anto_t self = container_of(expr, expr_anto_s, header);
 
-  anto_ctx_t anto_ctx = NULL;
-  avl_node_t node = avl_search(context->expr_ctx_map, expr);
-  if (node == NULL) {
-    anto_ctx = anto_ctx_alloc(self);
-    avl_insert(context->expr_ctx_map, expr, &anto_ctx->header.avl_elem);
-  } else {
-    anto_ctx = container_of(node, anto_ctx_s, header.avl_elem);
-  }
+  anto_ctx_t anto_ctx = anto_ctx_access(self, context);
 
   if (avl_search_ext(anto_ctx->antonym_cache, &center->pos.so, pos_cache_eq_eo) == NULL) {
     if (deque_empty(anto_ctx->center_queue)) {
@@ -85,7 +64,7 @@ void expr_activate_anto_ctx(expr_ctx_t expr_ctx, reg_ctx_t context) {
     if (avl_search_ext(anto_ctx->antonym_cache, &center->pos.so, pos_cache_eq_eo) == NULL) {
       expr_feed_target(anto_ctx->header.expr, center, context);
     } else {
-      dynapool_free_node(context->pos_cache_pool, center);
+      arena_pool_free_node(context->pos_cache_pool, center);
     }
     center = deque_pop_front(anto_ctx->center_queue, pos_cache_s, embed.deque_elem);
   }
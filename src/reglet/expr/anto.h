@@ -14,9 +14,10 @@ extern "C" {
 
 typedef struct _regex_expression_anti_antonym_ {
   expr_s header;
+  size_t slot; /* index of expr_ctx_slot */
 } expr_anto_s, *expr_anto_t;
 
-void expr_init_anto(expr_anto_t self, expr_t target, expr_feed_f feed);
+void expr_init_anto(expr_anto_t self, expr_t target, expr_feed_f feed, size_t slot);
 
 void expr_feed_anto_antonym(expr_t self, pos_cache_t antonym, reg_ctx_t context);
 void expr_feed_anto_center(expr_t self, pos_cache_t center, reg_ctx_t context);
@@ -7,7 +7,7 @@
 
 #include <alib/collections/map/avl.h>
 
-const bool dec_number_bitmap[256];
+extern const bool dec_number_bitmap[256];
 
 typedef struct _expression_distance_context_ {
   expr_ctx_s header;
@@ -15,30 +15,98 @@ typedef struct _expression_distance_context_ {
   avl_t suffix_cache;
 } dist_ctx_s, *dist_ctx_t;
 
-void dist_ctx_free(expr_ctx_t expr_ctx, reg_ctx_t reg_ctx) {
-  dist_ctx_t dist_ctx = container_of(expr_ctx, dist_ctx_s, header);
+dist_ctx_t dist_ctx_alloc(expr_dist_t expr_dist, reg_ctx_t reg_ctx) {
+  // dist_ctx and trees are recycled by reg_ctx
+  dist_ctx_t dist_ctx = arena_alloc(reg_ctx->expr_ctx_arena, sizeof(dist_ctx_s));
+  expr_ctx_init(&dist_ctx->header, &expr_dist->header, NULL);
+  dist_ctx->prefix_cache = avl_stash_take(&reg_ctx->eoso_trees);
+  dist_ctx->suffix_cache = avl_stash_take(&reg_ctx->soeo_trees);
+  expr_ctx_attach(reg_ctx, expr_dist->slot, &dist_ctx->header);
+  return dist_ctx;
+}
 
-  if (reg_ctx->reset_or_free) {
-    avl_walk_in_order(dist_ctx->prefix_cache, NULL, free_pos_cache, NULL, reg_ctx);
-    avl_walk_in_order(dist_ctx->suffix_cache, NULL, free_pos_cache, NULL, reg_ctx);
+static dist_ctx_t dist_ctx_access(expr_dist_t expr_dist, reg_ctx_t reg_ctx) {
+  expr_ctx_t expr_ctx = expr_ctx_access(reg_ctx, expr_dist->slot);
+  if (expr_ctx == NULL) {
+    return dist_ctx_alloc(expr_dist, reg_ctx);
   }
+  return container_of(expr_ctx, dist_ctx_s, header);
+}
 
-  avl_destruct(dist_ctx->prefix_cache);
-  avl_destruct(dist_ctx->suffix_cache);
+static inline bool reg_ctx_is_digit(reg_ctx_t reg_ctx, size_t i) {
+  if (reg_ctx->utf16) {
+    uint16_t unit = ((const uint16_t*)reg_ctx->content.ptr)[i];
+    return unit < 256 && dec_number_bitmap[unit];
+  }
+  return dec_number_bitmap[((const unsigned char*)reg_ctx->content.ptr)[i]];
+}
+
+static bool reg_ctx_build_digit_index(reg_ctx_t reg_ctx) {
+  digit_index_t index = &reg_ctx->digit_index;
+  size_t len = reg_ctx->content.len, count = (len >> 6) + 1;
+  if (index->capacity < count) {
+    void* ptr = arealloc(index->blocks, count * sizeof(digit_block_s));
+    if (ptr == NULL) {
+      return false;
+    }
+    index->blocks = ptr;
+    index->capacity = count;
+  }
+
+  // scan content once per document
+  digit_block_t blocks = index->blocks;
+  for (size_t b = 0; b < count; b++) {
+    size_t start = b << 6, stop = alib_min(start + 64, len);
+    uint64_t non_digit = 0;
+    for (size_t i = start; i < stop; i++) {
+      non_digit |= (uint64_t)!reg_ctx_is_digit(reg_ctx, i) << (i - start);
+    }
+    blocks[b].non_digit = non_digit;
+  }
+  size_t next_dirty = count;
+  for (size_t b = count; b > 0; b--) {
+    if (blocks[b - 1].non_digit != 0) {
+      next_dirty = b - 1;
+    }
+    blocks[b - 1].next_dirty = next_dirty;
+  }
 
-  afree(dist_ctx);
+  index->generation = reg_ctx->generation;
+  return true;
 }
 
-dist_ctx_t dist_ctx_alloc(expr_dist_t expr_dist) {
-  dist_ctx_t dist_ctx = amalloc(sizeof(dist_ctx_s));
-  expr_ctx_init(&dist_ctx->header, &expr_dist->header, dist_ctx_free, NULL);
-  dist_ctx->prefix_cache = avl_construct(pos_cache_cmp_eoso);
-  dist_ctx->suffix_cache = avl_construct(pos_cache_cmp_soeo);
-  return dist_ctx;
+/**
+ * all bytes, or units, in [so, eo) of content are digits, index is built at first call of document. content is
+ * scanned directly if index can not be allocated.
+ */
+static bool reg_ctx_is_number(reg_ctx_t reg_ctx, size_t so, size_t eo) {
+  if (so >= eo) {
+    return true;
+  }
+
+  digit_index_t index = &reg_ctx->digit_index;
+  if (index->generation != reg_ctx->generation && !reg_ctx_build_digit_index(reg_ctx)) {
+    for (size_t i = so; i < eo; i++) {
+      if (!reg_ctx_is_digit(reg_ctx, i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  digit_block_t blocks = index->blocks;
+  size_t first = so >> 6, last = (eo - 1) >> 6;
+  uint64_t head = ~(uint64_t)0 << (so & 63), tail = ~(uint64_t)0 >> (63 - ((eo - 1) & 63));
+  if (first == last) {
+    return (blocks[first].non_digit & head & tail) == 0;
+  }
+  return (blocks[first].non_digit & head) == 0 && (first + 1 == last || blocks[first + 1].next_dirty >= last) &&
+         (blocks[last].non_digit & tail) == 0;
 }
 
-void expr_init_dist(expr_dist_t self, expr_t target, expr_feed_f feed, uint32_t min, uint32_t max) {
+void expr_init_dist(expr_dist_t self, expr_t target, expr_feed_f feed, size_t slot, uint32_t min, uint32_t max) {
   expr_init(&self->header, target, feed);
+  self->slot = slot;
   self->min = min;
   self->max = max;
 }
@@ -51,7 +119,7 @@ static void prefix_match_suffix(avl_node_t node, void* arg) {
   pos_cache_t prefix = feed_arg->keyword;
   reg_ctx_t reg_ctx = feed_arg->context;
 
-  pos_cache_t keyword = dynapool_alloc_node(reg_ctx->pos_cache_pool);
+  pos_cache_t keyword = arena_pool_alloc_node(reg_ctx->pos_cache_pool);
   keyword->pos.so = prefix->pos.so;
   keyword->pos.eo = suffix->pos.eo;
   expr_feed_target(expr, keyword, reg_ctx);
@@ -65,13 +133,11 @@ static void prefix_match_suffix_check_num(avl_node_t node, void* arg) {
   pos_cache_t prefix = feed_arg->keyword;
   reg_ctx_t reg_ctx = feed_arg->context;
 
-  for (size_t i = prefix->pos.eo; i < suffix->pos.so; i++) {
-    if (!dec_number_bitmap[(unsigned char)reg_ctx->content.ptr[i]]) {
-      return;
-    }
+  if (!reg_ctx_is_number(reg_ctx, prefix->pos.eo, suffix->pos.so)) {
+    return;
   }
 
-  pos_cache_t keyword = dynapool_alloc_node(reg_ctx->pos_cache_pool);
+  pos_cache_t keyword = arena_pool_alloc_node(reg_ctx->pos_cache_pool);
   keyword->pos.so = prefix->pos.so;
   keyword->pos.eo = suffix->pos.eo;
   expr_feed_target(expr, keyword, reg_ctx);
@@ -83,14 +149,7 @@ static void expr_feed_dist_prefix0(expr_t expr,
                                    avl_walk_op_f prefix_match_suffix_func) {
   expr_dist_t self = container_of(expr, expr_dist_s, header);
 
-  dist_ctx_t dist_ctx;
-  avl_node_t node = avl_search(context->expr_ctx_map, expr);
-  if (node == NULL) {
-    dist_ctx = dist_ctx_alloc(self);
-    avl_insert(context->expr_ctx_map, expr, &dist_ctx->header.avl_elem);
-  } else {
-    dist_ctx = container_of(node, dist_ctx_s, header.avl_elem);
-  }
+  dist_ctx_t dist_ctx = dist_ctx_access(self, context);
 
   avl_insert(dist_ctx->prefix_cache, &prefix->pos, &prefix->embed.avl_elem);
 
@@ -116,7 +175,7 @@ static void suffix_match_prefix(avl_node_t node, void* arg) {
   pos_cache_t suffix = feed_arg->keyword;
   reg_ctx_t reg_ctx = feed_arg->context;
 
-  pos_cache_t keyword = dynapool_alloc_node(reg_ctx->pos_cache_pool);
+  pos_cache_t keyword = arena_pool_alloc_node(reg_ctx->pos_cache_pool);
   keyword->pos.so = prefix->pos.so;
   keyword->pos.eo = suffix->pos.eo;
   expr_feed_target(expr, keyword, reg_ctx);
@@ -130,13 +189,11 @@ static void suffix_match_prefix_check_num(avl_node_t node, void* arg) {
   pos_cache_t suffix = feed_arg->keyword;
   reg_ctx_t reg_ctx = feed_arg->context;
 
-  for (size_t i = prefix->pos.eo; i < suffix->pos.so; i++) {
-    if (!dec_number_bitmap[(unsigned char)reg_ctx->content.ptr[i]]) {
-      return;
-    }
+  if (!reg_ctx_is_number(reg_ctx, prefix->pos.eo, suffix->pos.so)) {
+    return;
   }
 
-  pos_cache_t keyword = dynapool_alloc_node(reg_ctx->pos_cache_pool);
+  pos_cache_t keyword = arena_pool_alloc_node(reg_ctx->pos_cache_pool);
   keyword->pos.so = prefix->pos.so;
   keyword->pos.eo = suffix->pos.eo;
   expr_feed_target(expr, keyword, reg_ctx);
@@ -148,14 +205,7 @@ static void expr_feed_dist_suffix0(expr_t expr,
                                    avl_walk_op_f suffix_match_prefix_func) {
   expr_dist_t self = container_of(expr, expr_dist_s, header);
 
-  dist_ctx_t dist_ctx;
-  avl_node_t node = avl_search(context->expr_ctx_map, expr);
-  if (node == NULL) {
-    dist_ctx = dist_ctx_alloc(self);
-    avl_insert(context->expr_ctx_map, expr, &dist_ctx->header.avl_elem);
-  } else {
-    dist_ctx = container_of(node, dist_ctx_s, header.avl_elem);
-  }
+  dist_ctx_t dist_ctx = dist_ctx_access(self, context);
 
   avl_insert(dist_ctx->suffix_cache, &suffix->pos, &suffix->embed.avl_elem);
 
@@ -14,10 +14,11 @@ extern "C" {
 
 typedef struct _regex_expression_distance_ {
   expr_s header;
+  size_t slot; /* index of expr_ctx_slot */
   uint32_t min, max;
 } expr_dist_s, *expr_dist_t;
 
-void expr_init_dist(expr_dist_t self, expr_t target, expr_feed_f feed, uint32_t min, uint32_t max);
+void expr_init_dist(expr_dist_t self, expr_t target, expr_feed_f feed, size_t slot, uint32_t min, uint32_t max);
 
 void expr_feed_dist_prefix(expr_t self, pos_cache_t prefix, reg_ctx_t context);
 void expr_feed_dist_suffix(expr_t self, pos_cache_t suffix, reg_ctx_t context);
@@ -56,22 +56,33 @@ typedef struct _expr_feed_arg_ {
 //
 // expression context
 
-typedef void (*expr_ctx_free_f)(expr_ctx_t expr_ctx, reg_ctx_t reg_ctx);
 typedef void (*expr_ctx_activate_f)(expr_ctx_t expr_ctx, reg_ctx_t reg_ctx);
 
 struct _expression_context_ {
   expr_t expr;
-  expr_ctx_free_f free_func;
   expr_ctx_activate_f activate_func;
-  avl_node_s avl_elem;
 };
 
-inline void expr_ctx_init(expr_ctx_t self, expr_t expr, expr_ctx_free_f free, expr_ctx_activate_f activate) {
+inline void expr_ctx_init(expr_ctx_t self, expr_t expr, expr_ctx_activate_f activate) {
   self->expr = expr;
-  self->free_func = free;
   self->activate_func = activate;
 }
 
+/**
+ * expr_ctx_access - get expression context of current document
+ * @return NULL if slot is not attached after last reset
+ */
+inline expr_ctx_t expr_ctx_access(reg_ctx_t context, size_t slot) {
+  expr_ctx_slot_t ctx_slot = &context->expr_ctx_slots[slot];
+  return ctx_slot->generation == context->generation ? ctx_slot->expr_ctx : NULL;
+}
+
+inline void expr_ctx_attach(reg_ctx_t context, size_t slot, expr_ctx_t expr_ctx) {
+  expr_ctx_slot_t ctx_slot = &context->expr_ctx_slots[slot];
+  ctx_slot->expr_ctx = expr_ctx;
+  ctx_slot->generation = context->generation;
+}
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -12,7 +12,12 @@ void expr_init_text(expr_text_t self, expr_t target, expr_feed_f feed, size_t le
 
 void expr_feed_text(expr_t expr, pos_cache_t keyword, void* context) {
   expr_text_t self = container_of(expr, expr_text_s, header);
+  reg_ctx_t reg_ctx = (reg_ctx_t)context;
   // calculate start offset
-  keyword->pos.so = keyword->pos.eo - self->len;
+  if (reg_ctx->start_pos_func != NULL) {
+    keyword->pos.so = reg_ctx->start_pos_func(keyword->pos.eo, self->len, reg_ctx->start_pos_arg);
+  } else {
+    keyword->pos.so = keyword->pos.eo - self->len;
+  }
   expr_feed_target(expr, keyword, context);
 }
@@ -0,0 +1,186 @@
+/**
+ * strpool.c
+ *
+ * @author James Yin <ywhjames@hotmail.com>
+ */
+#include "strpool.h"
+
+#include "image.h"
+
+#define STRPOOL_EMPTY_SLOT SIZE_MAX
+
+static uint64_t strpool_hash(const char* ptr, size_t len) {
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (unsigned char)ptr[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static bool strpool_rehash(strpool_t self, size_t slot_count) {
+  strpool_slot_t slots = amalloc(slot_count * sizeof(strpool_slot_s));
+  if (slots == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < slot_count; i++) {
+    slots[i].handle.offset = STRPOOL_EMPTY_SLOT;
+  }
+
+  size_t mask = slot_count - 1;
+  if (self->slots != NULL) {
+    for (size_t i = 0; i <= self->slot_mask; i++) {
+      strpool_slot_t slot = &self->slots[i];
+      if (slot->handle.offset != STRPOOL_EMPTY_SLOT) {
+        size_t pos = slot->hash & mask;
+        while (slots[pos].handle.offset != STRPOOL_EMPTY_SLOT) {
+          pos = (pos + 1) & mask;
+        }
+        slots[pos] = *slot;
+      }
+    }
+    afree(self->slots);
+  }
+
+  self->slots = slots;
+  self->slot_mask = mask;
+  return true;
+}
+
+strpool_t strpool_construct(bool deduplicate) {
+  strpool_t self = amalloc(sizeof(strpool_s));
+  if (self == NULL) {
+    return NULL;
+  }
+
+  self->buffer = NULL;
+  self->size = self->capacity = 0;
+  self->borrowed = false;
+  self->slots = NULL;
+  self->slot_mask = self->slot_used = 0;
+
+  if (deduplicate && !strpool_rehash(self, 1024)) {
+    afree(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+strpool_t strpool_construct_by_buffer(char* buffer, size_t size) {
+  strpool_t self = strpool_construct(false);
+  if (self == NULL) {
+    return NULL;
+  }
+
+  self->buffer = buffer;
+  self->size = self->capacity = size;
+  self->borrowed = true;
+
+  return self;
+}
+
+void strpool_destruct(strpool_t self) {
+  if (self != NULL) {
+    if (!self->borrowed) {
+      afree(self->buffer);
+    }
+    afree(self->slots);
+    afree(self);
+  }
+}
+
+static strhdl_s strpool_append(strpool_t self, strlen_t str) {
+  size_t need = self->size + str->len + 1;
+  if (need > self->capacity) {
+    size_t capacity = alib_max(need, alib_max(self->capacity * 2, 4096));
+    char* buffer = arealloc(self->buffer, capacity);
+    if (buffer == NULL) {
+      // alloc failed!!!
+      exit(-1);
+    }
+    self->buffer = buffer;
+    self->capacity = capacity;
+  }
+
+  strhdl_s handle = {.offset = self->size, .len = str->len};
+  memcpy(self->buffer + self->size, str->ptr, str->len);
+  self->buffer[self->size + str->len] = '\0';
+  self->size = need;
+  return handle;
+}
+
+strhdl_s strpool_add(strpool_t self, strlen_t str) {
+  if (str->len == 0) {
+    return (strhdl_s){.offset = 0, .len = 0};
+  }
+
+  if (self->slots == NULL) {
+    return strpool_append(self, str);
+  }
+
+  uint64_t hash = strpool_hash(str->ptr, str->len);
+  size_t pos = hash & self->slot_mask;
+  while (self->slots[pos].handle.offset != STRPOOL_EMPTY_SLOT) {
+    strpool_slot_t slot = &self->slots[pos];
+    if (slot->hash == hash && slot->handle.len == str->len &&
+        memcmp(self->buffer + slot->handle.offset, str->ptr, str->len) == 0) {
+      return slot->handle;
+    }
+    pos = (pos + 1) & self->slot_mask;
+  }
+
+  strhdl_s handle = strpool_append(self, str);
+  self->slots[pos] = (strpool_slot_s){.hash = hash, .handle = handle};
+  self->slot_used++;
+
+  // keep load factor under 1/2
+  if (self->slot_used * 2 > self->slot_mask + 1 && !strpool_rehash(self, (self->slot_mask + 1) * 2)) {
+    // alloc failed!!!
+    exit(-1);
+  }
+
+  return handle;
+}
+
+void strpool_seal(strpool_t self) {
+  afree(self->slots);
+  self->slots = NULL;
+  self->slot_mask = self->slot_used = 0;
+
+  if (!self->borrowed && self->size < self->capacity && self->size > 0) {
+    char* buffer = arealloc(self->buffer, self->size);
+    if (buffer != NULL) {
+      self->buffer = buffer;
+      self->capacity = self->size;
+    }
+  }
+}
+
+bool strpool_dump(strpool_t self, FILE* fp) {
+  return image_write_size(fp, self->size) && image_write(fp, self->buffer, self->size);
+}
+
+strpool_t strpool_load(FILE* fp) {
+  size_t size;
+  if (!image_read_size(fp, &size) || !image_fits(fp, size, 1)) {
+    return NULL;
+  }
+
+  strpool_t self = strpool_construct(false);
+  if (self == NULL) {
+    return NULL;
+  }
+
+  if (size > 0) {
+    self->buffer = amalloc(size);
+    if (self->buffer == NULL || !image_read(fp, self->buffer, size)) {
+      strpool_destruct(self);
+      return NULL;
+    }
+    self->size = self->capacity = size;
+  }
+
+  return self;
+}
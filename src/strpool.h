@@ -0,0 +1,63 @@
+/**
+ * strpool.h - contiguous arena of strings
+ *
+ * @author James Yin <ywhjames@hotmail.com>
+ */
+#ifndef __ACTRIE_STRPOOL_H__
+#define __ACTRIE_STRPOOL_H__
+
+#include <alib/acom.h>
+#include <alib/string/astr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * strhdl - handle of string in pool, it is position independent.
+ */
+typedef struct _string_handle_ {
+  size_t offset, len;
+} strhdl_s, *strhdl_t;
+
+typedef struct _string_pool_slot_ {
+  uint64_t hash;
+  strhdl_s handle;
+} strpool_slot_s, *strpool_slot_t;
+
+/**
+ * strpool - strings are appended to one buffer and terminated by '\0', so the buffer
+ * can be dumped or mapped as a whole. The hash index for deduplication only exists
+ * until sealed.
+ */
+typedef struct _string_pool_ {
+  char* buffer;
+  size_t size, capacity;
+  bool borrowed; /* buffer is not owned by pool */
+
+  strpool_slot_t slots; /* open addressing, NULL if not deduplicate */
+  size_t slot_mask, slot_used;
+} strpool_s, *strpool_t;
+
+strpool_t strpool_construct(bool deduplicate);
+strpool_t strpool_construct_by_buffer(char* buffer, size_t size);
+void strpool_destruct(strpool_t self);
+
+strhdl_s strpool_add(strpool_t self, strlen_t str);
+void strpool_seal(strpool_t self);
+
+bool strpool_dump(strpool_t self, FILE* fp);
+strpool_t strpool_load(FILE* fp);
+
+static inline strlen_s strpool_get(strpool_t self, strhdl_s handle) {
+  if (handle.len == 0) {
+    return strlen_empty;
+  }
+  return (strlen_s){.ptr = self->buffer + handle.offset, .len = handle.len};
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif  // __ACTRIE_STRPOOL_H__
@@ -8,6 +8,8 @@
 #include <alib/collections/list/segarray.h>
 #include <alib/object/list.h>
 
+#include "../image.h"
+
 /* Trie 内部接口，仅限 Double-Array Trie 使用 */
 size_t trie_size(trie_t self);
 
@@ -61,6 +63,57 @@ static dat_node_t dat_access_node_with_alloc(dat_t self, size_t index) {
   return node;
 }
 
+/**
+ * dat_find_base - find base for children by first fit on free list
+ */
+static size_t dat_find_base(dat_t self, const uint8_t child[], size_t len) {
+  size_t pos = self->_sentinel->dat_free_next;
+  while (1) {
+    size_t base, i;
+
+    /* 扩容 */
+    if (pos == 0) {
+      pos = self->_sentinel->dat_free_last;
+      if (segarray_extend(self->node_array, 256) != 256) {
+        fprintf(stderr, "alloc datnodepool failed: region full.\nexit.\n");
+        exit(-1);
+      }
+      pos = dat_access_node(self, pos)->dat_free_next;
+    }
+
+    /* 检查: pos容纳第一个子节点 */
+    base = pos - child[0];
+    for (i = 0; i < len; ++i) {
+      if (dat_access_node_with_alloc(self, base + child[i])->check.idx != 0) {
+        break;
+      }
+    }
+
+    /* base 分配成功 */
+    if (i >= len) {
+      if (base + child[len - 1] > TRIE_IDX_MAX) {
+        fprintf(stderr, "dat: index overflow.\nexit.\n");
+        exit(-1);
+      }
+      return base;
+    }
+
+    pos = dat_access_node(self, pos)->dat_free_next;
+  }
+}
+
+/**
+ * dat_take_node - remove the node from free list, and link it to parent
+ */
+static void dat_take_node(dat_t self, size_t index, size_t parent) {
+  dat_node_t node = dat_access_node(self, index);
+  dat_access_node(self, node->dat_free_next)->dat_free_last = node->dat_free_last;
+  dat_access_node(self, node->dat_free_last)->dat_free_next = node->dat_free_next;
+  // set fields
+  node->check.idx = parent;
+  node->value.raw = NULL;
+}
+
 typedef struct dat_ctor_dfs_ctx {
   trie_node_t pNode, pChild;
 } dat_ctor_dfs_ctx_s, *dat_ctor_dfs_ctx_t;
@@ -69,6 +122,13 @@ static void dat_construct_by_trie0(dat_t self, trie_t origin) {
   // set dat index of root
   origin->root->trie_datidx = DAT_ROOT_IDX;
 
+  // every node of trie takes one slot after root, reserve them at once
+  size_t reserved = segarray_size(self->node_array), need = DAT_ROOT_IDX + trie_size(origin);
+  if (need > reserved && segarray_extend(self->node_array, need - reserved) != need - reserved) {
+    fprintf(stderr, "dat: alloc nodepool failed.\nexit.\n");
+    exit(-1);
+  }
+
   segarray_t stack = segarray_construct_with_type(dat_ctor_dfs_ctx_s);
   if (segarray_extend(stack, 2) != 2) {
     fprintf(stderr, "dat: alloc ctor_dfs_ctx failed.\nexit.\n");
@@ -106,47 +166,13 @@ static void dat_construct_by_trie0(dat_t self, trie_t origin) {
         pChild = trie_access_node(origin, pChild->trie_brother);
       }
 
-      size_t pos = self->_sentinel->dat_free_next;
-      while (1) {
-        size_t base, i;
-
-        /* 扩容 */
-        if (pos == 0) {
-          pos = self->_sentinel->dat_free_last;
-          if (segarray_extend(self->node_array, 256) != 256) {
-            fprintf(stderr, "alloc datnodepool failed: region full.\nexit.\n");
-            exit(-1);
-          }
-          pos = dat_access_node(self, pos)->dat_free_next;
-        }
-
-        /* 检查: pos容纳第一个子节点 */
-        base = pos - child[0];
-        for (i = 0; i < len; ++i) {
-          if (dat_access_node_with_alloc(self, base + child[i])->check.idx != 0) {
-            break;
-          }
-        }
-
-        /* base 分配成功 */
-        if (i >= len) {
-          pDatNode->base.idx = base;
-          for (i = 0, pChild = trie_access_node(origin, pNode->trie_child); i < len;
-               ++i, pChild = trie_access_node(origin, pChild->trie_brother)) {
-            pChild->trie_datidx = base + child[i];
-            /* 分配子节点 */
-            dat_node_t pDatChild = dat_access_node(self, pChild->trie_datidx);
-            /* remove the node from free list */
-            dat_access_node(self, pDatChild->dat_free_next)->dat_free_last = pDatChild->dat_free_last;
-            dat_access_node(self, pDatChild->dat_free_last)->dat_free_next = pDatChild->dat_free_next;
-            // set fields
-            pDatChild->check.idx = pNode->trie_datidx;
-            pDatChild->value.raw = NULL;
-          }
-          break;
-        }
-
-        pos = dat_access_node(self, pos)->dat_free_next;
+      size_t base = dat_find_base(self, child, len);
+      pDatNode->base.idx = base;
+      pChild = trie_access_node(origin, pNode->trie_child);
+      for (size_t i = 0; i < len; ++i) {
+        pChild->trie_datidx = base + child[i];
+        dat_take_node(self, pChild->trie_datidx, pNode->trie_datidx);
+        pChild = trie_access_node(origin, pChild->trie_brother);
       }
 
       /* 构建子树 */
@@ -183,19 +209,28 @@ static void dat_construct_by_trie0(dat_t self, trie_t origin) {
   segarray_destruct(stack);
 }
 
+/**
+ * dat_index_to_pointer - convert index to pointer for used nodes, free and pad nodes are kept as index
+ */
+static void dat_index_to_pointer(dat_t self) {
+  size_t len = segarray_size(self->node_array);
+  for (size_t index = 0; index < len; index++) {
+    dat_node_t pDatNode = dat_access_node(self, index);
+    if (pDatNode->check.idx > 1) {
+      pDatNode->check.ptr = dat_access_node(self, pDatNode->check.idx);
+      pDatNode->base.ptr = dat_access_node(self, pDatNode->base.idx);
+      pDatNode->failed.ptr = dat_access_node(self, pDatNode->failed.idx);
+    }
+  }
+}
+
 static void dat_post_construct(dat_t self, trie_t origin) {
   /* 添加占位内存，防止匹配时出现非法访问 */
   // segarray_extend(self->node_array, 256);
 
-  // convert index to pointer
+  dat_index_to_pointer(self);
+
   size_t len = trie_size(origin);
-  for (size_t index = 0; index < len; index++) {
-    trie_node_t pNode = trie_access_node(origin, index);
-    dat_node_t pDatNode = dat_access_node(self, pNode->trie_datidx);
-    pDatNode->check.ptr = dat_access_node(self, pDatNode->check.idx);
-    pDatNode->base.ptr = dat_access_node(self, pDatNode->base.idx);
-    pDatNode->failed.ptr = dat_access_node(self, pDatNode->failed.idx);
-  }
 
   if (self->enable_automation) {
     // 回溯优化
@@ -329,6 +364,477 @@ dat_t dat_construct_by_trie(trie_t origin, bool enable_automation) {
   return dat;
 }
 
+// Construct by Builder
+// ========================================================
+
+typedef struct _datrie_builder_run_ {
+  trie_idx_t lo, hi; /* entries with common prefix */
+  trie_idx_t depth;
+  trie_idx_t datidx;
+} dat_builder_run_s, *dat_builder_run_t;
+
+static size_t dat_next_by_index(dat_t self, size_t index, uint8_t key) {
+  size_t next = dat_access_node(self, index)->base.idx + key;
+  if (next == DAT_ROOT_IDX) {  // check of root is itself
+    return 0;
+  }
+  dat_node_t pNext = segarray_access_s(self->node_array, next);
+  return pNext != NULL && pNext->check.idx == index ? next : 0;
+}
+
+static size_t dat_failed_by_index(dat_t self, size_t parent, uint8_t key) {
+  if (parent == DAT_ROOT_IDX) {
+    return DAT_ROOT_IDX;
+  }
+  // failed nodes are shallower than parent, their children are placed already
+  size_t iFailed = dat_access_node(self, parent)->failed.idx;
+  while (1) {
+    size_t match = dat_next_by_index(self, iFailed, key);
+    if (match != 0) {
+      return match;
+    }
+    if (iFailed == DAT_ROOT_IDX) {
+      return DAT_ROOT_IDX;
+    }
+    iFailed = dat_access_node(self, iFailed)->failed.idx;
+  }
+}
+
+static void dat_set_value(dat_t self, dat_node_t pDatNode, void* value) {
+  if (!self->enable_automation) {
+    pDatNode->value.raw = value;
+    return;
+  }
+
+  // nodes are visited by bfs, so values of failed node are linked already
+  dat_value_t next = pDatNode == self->root ? NULL : dat_access_node(self, pDatNode->failed.idx)->value.linked;
+  if (value != NULL) {
+    if (segarray_extend(self->value_array, 1) != 1) {
+      fprintf(stderr, "dat: alloc dat_value_s failed.\nexit.\n");
+      exit(-1);
+    }
+    dat_value_t linked = (dat_value_t)segarray_access(self->value_array, segarray_size(self->value_array) - 1);
+    linked->value = value;
+    linked->next = next;
+    pDatNode->value.linked = linked;
+  } else {
+    pDatNode->value.linked = next;
+  }
+}
+
+/**
+ * dat_split_run - split run by key at depth, keyword ends at depth is sorted first and taken as value
+ */
+static size_t dat_split_run(dat_builder_entry_t entries,
+                            size_t lo,
+                            size_t hi,
+                            size_t depth,
+                            void** value,
+                            uint8_t child[],
+                            size_t bound[]) {
+  *value = NULL;
+  if (lo < hi && entries[lo].len == depth) {
+    *value = entries[lo++].value;
+  }
+
+  size_t len = 0;
+  for (size_t i = lo; i < hi; i++) {
+    uint8_t key = entries[i].keyword.ptr[depth];
+    if (len == 0 || child[len - 1] != key) {
+      child[len] = key;
+      bound[len++] = i;
+    }
+  }
+  bound[len] = hi;
+
+  return len;
+}
+
+/**
+ * dat_builder_node_count - entries are sorted, each one adds nodes for its bytes after common prefix with previous.
+ */
+static size_t dat_builder_node_count(dat_builder_t builder) {
+  dat_builder_entry_t entries = builder->entries;
+  size_t count = 1;  // root
+  for (size_t i = 0; i < builder->count; i++) {
+    size_t common = 0;
+    if (i > 0) {
+      size_t len = alib_min(entries[i - 1].len, entries[i].len);
+      while (common < len && entries[i - 1].keyword.ptr[common] == entries[i].keyword.ptr[common]) {
+        common++;
+      }
+    }
+    count += entries[i].len - common;
+  }
+  return count;
+}
+
+static void dat_construct_by_builder0(dat_t self, dat_builder_t builder) {
+  dat_builder_entry_t entries = builder->entries;
+  if (builder->count >= TRIE_IDX_MAX) {
+    fprintf(stderr, "dat: index overflow.\nexit.\n");
+    exit(-1);
+  }
+
+  // every node of implied trie takes one slot after root, reserve them at once like dat_construct_by_trie0
+  size_t reserved = segarray_size(self->node_array), need = DAT_ROOT_IDX + dat_builder_node_count(builder);
+  if (need > reserved && segarray_extend(self->node_array, need - reserved) != need - reserved) {
+    fprintf(stderr, "dat: alloc nodepool failed.\nexit.\n");
+    exit(-1);
+  }
+
+  // runs in stack or in one level are disjoint, so they are bounded by count of entries
+  size_t capacity = builder->count + 1;
+  dat_builder_run_t level = amalloc(capacity * sizeof(dat_builder_run_s));
+  dat_builder_run_t next_level = amalloc(capacity * sizeof(dat_builder_run_s));
+  if (level == NULL || next_level == NULL) {
+    fprintf(stderr, "dat: alloc builder_run failed.\nexit.\n");
+    exit(-1);
+  }
+
+  uint8_t child[256];
+  size_t bound[257];
+  void* value;
+
+  // place nodes by dfs like dat_construct_by_trie0, bfs order leaves free list fragmented
+  dat_builder_run_t stack = level;
+  stack[0].lo = 0;
+  stack[0].hi = builder->count;
+  stack[0].depth = 0;
+  stack[0].datidx = DAT_ROOT_IDX;
+  size_t stack_top = 1;
+  while (stack_top > 0) {
+    dat_builder_run_s run = stack[--stack_top];
+    dat_node_t pDatNode = dat_access_node(self, run.datidx);
+
+    size_t len = dat_split_run(entries, run.lo, run.hi, run.depth, &value, child, bound);
+    if (len == 0) {  // leaf node
+      pDatNode->base.idx = 0;
+      continue;
+    }
+
+    size_t base = dat_find_base(self, child, len);
+    pDatNode->base.idx = base;
+    for (size_t i = 0; i < len; ++i) {
+      dat_take_node(self, base + child[i], run.datidx);
+    }
+
+    // push in reverse order, so that children are visited in order of key
+    for (size_t i = len; i > 0; --i) {
+      dat_builder_run_t sub = &stack[stack_top++];
+      sub->lo = bound[i - 1];
+      sub->hi = bound[i];
+      sub->depth = run.depth + 1;
+      sub->datidx = base + child[i - 1];
+    }
+  }
+
+  // set values and failed by bfs
+  level[0].lo = 0;
+  level[0].hi = builder->count;
+  level[0].depth = 0;
+  level[0].datidx = DAT_ROOT_IDX;
+  size_t width = 1;
+  while (width > 0) {
+    size_t next_width = 0;
+    for (size_t r = 0; r < width; r++) {
+      dat_builder_run_s run = level[r];
+      size_t len = dat_split_run(entries, run.lo, run.hi, run.depth, &value, child, bound);
+      dat_set_value(self, dat_access_node(self, run.datidx), value);
+
+      size_t base = dat_access_node(self, run.datidx)->base.idx;
+      for (size_t i = 0; i < len; ++i) {
+        if (self->enable_automation) {
+          dat_access_node(self, base + child[i])->failed.idx = dat_failed_by_index(self, run.datidx, child[i]);
+        }
+        dat_builder_run_t sub = &next_level[next_width++];
+        sub->lo = bound[i];
+        sub->hi = bound[i + 1];
+        sub->depth = run.depth + 1;
+        sub->datidx = base + child[i];
+      }
+    }
+    alib_swap(dat_builder_run_t, level, next_level);
+    width = next_width;
+  }
+
+  afree(level);
+  afree(next_level);
+}
+
+dat_t dat_construct_by_builder(dat_builder_t builder, dat_builder_merge_f merge_func, bool enable_automation) {
+  dat_t dat = dat_alloc();
+  if (dat == NULL) {
+    return NULL;
+  }
+
+  dat_builder_seal(builder, merge_func);
+  if (enable_automation) {
+    dat->enable_automation = true;
+    dat->value_array = segarray_construct(sizeof(dat_value_s), NULL, NULL);
+  }
+  dat_construct_by_builder0(dat, builder);
+  dat_index_to_pointer(dat);
+
+  return dat;
+}
+
+void dat_stats(dat_t self, dat_stats_t stats) {
+  stats->node_count = segarray_size(self->node_array);
+  stats->node_used = 0;
+  stats->node_pad = 0;
+  stats->value_count = self->enable_automation ? segarray_size(self->value_array) : 0;
+  stats->failed_chain_total = 0;
+  stats->failed_chain_max = 0;
+  if (stats->depth_histogram != NULL) {
+    memset(stats->depth_histogram, 0, sizeof(size_t) * stats->depth_buckets);
+  }
+
+  for (size_t i = 0; i < stats->node_count; i++) {
+    dat_node_t node = dat_access_node(self, i);
+    if (node->check.idx == 0) {  // free
+      continue;
+    } else if (node->check.idx == 1) {  // pad, never converted to pointer
+      stats->node_pad++;
+      continue;
+    }
+    stats->node_used++;
+
+    if (stats->depth_histogram != NULL && stats->depth_buckets > 0) {
+      size_t depth = 0;
+      for (dat_node_t p = node; p != self->root; p = p->check.ptr) {
+        depth++;
+      }
+      stats->depth_histogram[alib_min(depth, stats->depth_buckets - 1)]++;
+    }
+
+    if (self->enable_automation) {
+      size_t chain = 0;
+      for (dat_node_t p = node; p != self->root; p = p->failed.ptr) {
+        chain++;
+      }
+      stats->failed_chain_total += chain;
+      stats->failed_chain_max = alib_max(stats->failed_chain_max, chain);
+    }
+  }
+}
+
+// dat Image
+// ===================================================
+
+/* slot which is not a node of trie, its fields are kept as index */
+#define DAT_IMAGE_FREE UINT64_MAX
+
+typedef struct _datrie_image_node_ {
+  uint64_t check, base, failed;
+  uint64_t value; /* index of value_array plus 1, or DAT_IMAGE_FREE */
+} dat_image_node_s;
+
+bool dat_dump(dat_t self, FILE* fp) {
+  if (!self->enable_automation) {
+    return false;
+  }
+
+  ptridx_t nodes = ptridx_construct(self->node_array);
+  ptridx_t values = ptridx_construct(self->value_array);
+  bool succeed = nodes != NULL && values != NULL;
+
+  size_t node_count = segarray_size(self->node_array);
+  size_t value_count = segarray_size(self->value_array);
+  succeed = succeed && image_write_size(fp, node_count) && image_write_size(fp, value_count);
+
+  for (size_t i = 0; succeed && i < node_count; i++) {
+    dat_node_t node = dat_access_node(self, i);
+    dat_image_node_s image;
+    if (node->check.idx == 0 || node->check.idx == 1) {  // free or pad
+      image = (dat_image_node_s){node->check.idx, node->base.idx, node->failed.idx, DAT_IMAGE_FREE};
+    } else {
+      image.check = ptridx_index(nodes, node->check.ptr);
+      image.base = ptridx_index(nodes, node->base.ptr);
+      image.failed = ptridx_index(nodes, node->failed.ptr);
+      size_t value = node->value.linked == NULL ? 0 : ptridx_index(values, node->value.linked) + 1;
+      image.value = value;
+      succeed = image.check != (size_t)-1 && image.base != (size_t)-1 && image.failed != (size_t)-1 &&
+                (node->value.linked == NULL || value != 0);
+    }
+    succeed = succeed && image_write(fp, &image, sizeof(image));
+  }
+
+  for (size_t i = 0; succeed && i < value_count; i++) {
+    dat_value_t value = segarray_access(self->value_array, i);
+    size_t next = value->next == NULL ? 0 : ptridx_index(values, value->next) + 1;
+    succeed = (value->next == NULL || next != 0) && image_write_size(fp, next);
+  }
+
+  ptridx_destruct(nodes);
+  ptridx_destruct(values);
+  return succeed;
+}
+
+/**
+ * dat_image_check - every used node is a descendant of root and its failed node is shallower, failed of root is
+ * never followed. next of value is an earlier value as values are appended by bfs, so no walk on check, failed or
+ * next loops.
+ *
+ * a value is reached from nodes which link it and by next from deeper values, so it is checked with the least
+ * depth of them.
+ */
+static bool dat_image_check(dat_image_node_s* images,
+                            size_t node_count,
+                            size_t* nexts,
+                            void* value_list[],
+                            size_t value_count,
+                            dat_value_check_f check_func) {
+  if (node_count <= DAT_ROOT_IDX || images[DAT_ROOT_IDX].value == DAT_IMAGE_FREE ||
+      images[DAT_ROOT_IDX].check != DAT_ROOT_IDX) {
+    return false;
+  }
+  for (size_t i = 0; i < node_count; i++) {
+    dat_image_node_s* image = &images[i];
+    if (image->value != DAT_IMAGE_FREE &&
+        (image->check >= node_count || image->base >= node_count || image->failed >= node_count ||
+         image->value > value_count || images[image->check].value == DAT_IMAGE_FREE ||
+         (i != DAT_ROOT_IDX && images[image->failed].value == DAT_IMAGE_FREE))) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < value_count; i++) {
+    if (nexts[i] > i) {
+      return false;
+    }
+  }
+
+  size_t* depths = amalloc(node_count * sizeof(size_t));
+  size_t* value_depths = amalloc(alib_max(value_count, 1) * sizeof(size_t));
+  bool succeed = depths != NULL && value_depths != NULL;
+  for (size_t i = 0; succeed && i < node_count; i++) {
+    depths[i] = SIZE_MAX;
+  }
+  for (size_t i = 0; succeed && i < value_count; i++) {
+    value_depths[i] = SIZE_MAX;
+  }
+  if (succeed) {
+    depths[DAT_ROOT_IDX] = 0;
+  }
+
+  for (size_t i = 0; succeed && i < node_count; i++) {
+    if (images[i].value == DAT_IMAGE_FREE) {
+      continue;
+    }
+    // walk up to a node of known depth, then fill depths of the path
+    size_t steps = 0, j = i;
+    while (depths[j] == SIZE_MAX) {
+      j = images[j].check;
+      if (++steps > node_count) {
+        succeed = false;
+        break;
+      }
+    }
+    for (size_t k = steps, p = i, depth = succeed ? depths[j] : 0; succeed && k > 0; k--) {
+      depths[p] = depth + k;
+      p = images[p].check;
+    }
+  }
+  for (size_t i = 0; succeed && i < node_count; i++) {
+    if (images[i].value != DAT_IMAGE_FREE && i != DAT_ROOT_IDX) {
+      succeed = depths[images[i].failed] < depths[i];
+      if (images[i].value > 0) {
+        value_depths[images[i].value - 1] = alib_min(value_depths[images[i].value - 1], depths[i]);
+      }
+    }
+  }
+  for (size_t i = value_count; succeed && i > 0; i--) {
+    size_t depth = value_depths[i - 1];
+    if (depth != SIZE_MAX) {
+      if (nexts[i - 1] > 0) {
+        value_depths[nexts[i - 1] - 1] = alib_min(value_depths[nexts[i - 1] - 1], depth);
+      }
+      succeed = check_func == NULL || check_func(value_list[i - 1], depth);
+    }
+  }
+
+  afree(depths);
+  afree(value_depths);
+  return succeed;
+}
+
+dat_t dat_load(FILE* fp, void* value_list[], size_t value_count, dat_value_check_f check_func) {
+  size_t node_count, count;
+  if (!image_read_size(fp, &node_count) || !image_read_size(fp, &count) || count != value_count ||
+      !image_fits(fp, node_count, sizeof(dat_image_node_s))) {
+    return NULL;
+  }
+
+  dat_image_node_s* images = amalloc(alib_max(node_count, 1) * sizeof(dat_image_node_s));
+  size_t* nexts = amalloc(alib_max(value_count, 1) * sizeof(size_t));
+  bool succeed = images != NULL && nexts != NULL && image_read(fp, images, node_count * sizeof(dat_image_node_s));
+  for (size_t i = 0; succeed && i < value_count; i++) {
+    succeed = image_read_size(fp, &nexts[i]);
+  }
+  succeed = succeed && dat_image_check(images, node_count, nexts, value_list, value_count, check_func);
+
+  dat_t dat = succeed ? dat_alloc() : NULL;
+  do {
+    if (dat == NULL) {
+      break;
+    }
+
+    // children of node are addressed as base plus byte, slots after last node are free
+    size_t size = segarray_size(dat->node_array), extend = node_count + 255 - size;
+    if (node_count < size || segarray_extend(dat->node_array, extend) != extend) {
+      break;
+    }
+    dat->enable_automation = true;
+    dat->value_array = segarray_construct(sizeof(dat_value_s), NULL, NULL);
+    if (dat->value_array == NULL ||
+        (value_count > 0 && segarray_extend(dat->value_array, value_count) != value_count)) {
+      break;
+    }
+
+    size_t i;
+    for (i = 0; i < node_count; i++) {
+      dat_node_t node = dat_access_node(dat, i);
+      dat_image_node_s* image = &images[i];
+      if (image->value == DAT_IMAGE_FREE) {
+        node->check.idx = image->check;
+        node->base.idx = image->base;
+        node->failed.idx = image->failed;
+        node->value.raw = NULL;
+      } else {
+        node->check.ptr = dat_access_node(dat, image->check);
+        node->base.ptr = dat_access_node(dat, image->base);
+        node->failed.ptr = dat_access_node(dat, image->failed);
+        node->value.linked = image->value == 0 ? NULL : segarray_access(dat->value_array, image->value - 1);
+        // nodes are allocated by segments, children must not cross end of segment
+        if (node->base.ptr + 255 != dat_access_node(dat, (size_t)image->base + 255)) {
+          break;
+        }
+      }
+    }
+    if (i < node_count) {
+      break;
+    }
+
+    for (i = 0; i < value_count; i++) {
+      dat_value_t value = segarray_access(dat->value_array, i);
+      value->value = value_list[i];
+      value->next = nexts[i] == 0 ? NULL : segarray_access(dat->value_array, nexts[i] - 1);
+    }
+
+    afree(images);
+    afree(nexts);
+    return dat;
+  } while (0);
+
+  // values are owned by caller until loaded
+  afree(images);
+  afree(nexts);
+  if (dat != NULL) {
+    dat_destruct(dat, NULL);
+  }
+  return NULL;
+}
+
 // dat Context
 // ===================================================
 
@@ -363,6 +869,11 @@ void dat_reset_context(dat_ctx_t context, char content[], size_t len) {
   }
 }
 
+void dat_refill_context(dat_ctx_t context, char content[], size_t len) {
+  context->content = (strlen_s){.ptr = content, .len = len};
+  context->_read = 0;
+}
+
 bool dat_match_end(dat_ctx_t ctx) {
   return ctx->_read >= ctx->content.len;
 }
@@ -371,11 +882,18 @@ static inline dat_node_t dat_forward(dat_node_t cur, dat_ctx_t ctx) {
   return cur->base.ptr + ((uint8_t*)ctx->content.ptr)[ctx->_read];
 }
 
+/**
+ * dat_transit - check of root is itself, so forward to root is not a transition.
+ */
+static inline bool dat_transit(dat_node_t cur, dat_node_t next, dat_ctx_t ctx) {
+  return next->check.ptr == cur && next != ctx->trie->root;
+}
+
 bool dat_next_on_node(dat_ctx_t ctx) {
   dat_node_t pCursor = ctx->_cursor;
   for (; ctx->_read < ctx->content.len; ctx->_read++) {
     dat_node_t pNext = dat_forward(pCursor, ctx);
-    if (pNext->check.ptr != pCursor) {
+    if (!dat_transit(pCursor, pNext, ctx)) {
       break;
     }
     pCursor = pNext;
@@ -391,7 +909,7 @@ bool dat_next_on_node(dat_ctx_t ctx) {
     pCursor = ctx->trie->root;
     for (ctx->_read = ctx->_begin; ctx->_read < ctx->content.len; ctx->_read++) {
       dat_node_t pNext = dat_forward(pCursor, ctx);
-      if (pNext->check.ptr != pCursor) {
+      if (!dat_transit(pCursor, pNext, ctx)) {
         break;
       }
       pCursor = pNext;
@@ -412,7 +930,9 @@ bool dat_prefix_next_on_node(dat_ctx_t ctx) {
   dat_node_t pCursor = ctx->_cursor;
   for (; ctx->_read < ctx->content.len; ctx->_read++) {
     dat_node_t pNext = dat_forward(pCursor, ctx);
-    if (pNext->check.ptr != pCursor) {
+    if (!dat_transit(pCursor, pNext, ctx)) {
+      // keep cursor, prefix is broken and later calls must fail at the same place
+      ctx->_cursor = pCursor;
       return false;
     }
     pCursor = pNext;
@@ -466,7 +986,9 @@ bool dat_ac_prefix_next_on_node(dat_ctx_t ctx) {
   dat_node_t pCursor = ctx->_cursor;
   for (; ctx->_read < ctx->content.len; ctx->_read++) {
     dat_node_t pNext = dat_forward(pCursor, ctx);
-    if (pNext->check.ptr != pCursor) {
+    if (!dat_transit(pCursor, pNext, ctx)) {
+      // keep cursor, prefix is broken and later calls must fail at the same place
+      ctx->_cursor = pCursor;
       return false;
     }
     pCursor = pNext;
@@ -478,5 +1000,7 @@ bool dat_ac_prefix_next_on_node(dat_ctx_t ctx) {
     }
   }
 
+  // keep cursor, content may be refilled
+  ctx->_cursor = pCursor;
   return false;
 }
@@ -7,6 +7,7 @@
 #define __ACTRIE_ACDAT_H__
 
 #include "actrie.h"
+#include "datbuilder.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -66,12 +67,46 @@ typedef struct _datrie_context_ {
 
 typedef void (*dat_node_free_f)(dat_t dat, void* node);
 
+typedef struct _datrie_stats_ {
+  size_t node_count; /* slots of node_array */
+  size_t node_used;
+  size_t node_pad; /* slots reserved at head and tail of segments */
+  size_t value_count;
+  size_t failed_chain_total;
+  size_t failed_chain_max;
+  size_t* depth_histogram; /* provided by caller, the last bucket counts deeper nodes */
+  size_t depth_buckets;
+} dat_stats_s, *dat_stats_t;
+
 dat_t dat_construct_by_trie(trie_t origin, bool enable_automation);
+
+/**
+ * dat_construct_by_builder - build datrie from sorted keywords directly, builder is sealed and can be destructed after.
+ */
+dat_t dat_construct_by_builder(dat_builder_t builder, dat_builder_merge_f merge_func, bool enable_automation);
 void dat_destruct(dat_t datrie, dat_node_free_f node_free_func);
+void dat_stats(dat_t datrie, dat_stats_t stats);
+
+/**
+ * dat_dump - dump datrie with automation, values are dumped by caller in order of value_array.
+ */
+bool dat_dump(dat_t datrie, FILE* fp);
+
+/**
+ * dat_value_check_f - check value loaded from image, keyword of it ends at node of depth, and is not longer.
+ */
+typedef bool (*dat_value_check_f)(void* value, size_t depth);
+
+dat_t dat_load(FILE* fp, void* value_list[], size_t value_count, dat_value_check_f check_func);
 
 dat_ctx_t dat_alloc_context(dat_t datrie);
 bool dat_free_context(dat_ctx_t context);
 void dat_reset_context(dat_ctx_t context, char content[], size_t len);
+/**
+ * dat_refill_context - continue scanning on next chunk of content, the cursor is kept, so a keyword
+ * can span chunks. Only the automation is supported.
+ */
+void dat_refill_context(dat_ctx_t context, char content[], size_t len);
 
 bool dat_match_end(dat_ctx_t ctx);
 
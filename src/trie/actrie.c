@@ -8,16 +8,32 @@
 // Prime Trie
 // ========================================================
 
+#define TRIE_GROW_MIN 4096
+
 size_t trie_size(trie_t self) {
-  return segarray_size(self->node_array);
+  return self->size;
+}
+
+bool trie_reserve(trie_t self, size_t capacity) {
+  size_t reserved = segarray_size(self->node_array);
+  capacity = alib_min(capacity, (size_t)TRIE_IDX_MAX);
+  if (capacity > reserved) {
+    return segarray_extend(self->node_array, capacity - reserved) == capacity - reserved;
+  }
+  return true;
 }
 
 static size_t trie_alloc_node(trie_t self) {
-  if (1 == segarray_extend(self->node_array, 1)) {
-    return segarray_size(self->node_array) - 1;
-  } else {
+  if (self->size >= TRIE_IDX_MAX) {
     return (size_t)-1;
   }
+  if (self->size == segarray_size(self->node_array)) {
+    // grow by block, rather than node by node
+    if (!trie_reserve(self, self->size + alib_max(self->size >> 3, TRIE_GROW_MIN))) {
+      return (size_t)-1;
+    }
+  }
+  return self->size++;
 }
 
 void* trie_add_keyword(trie_t self, const char* keyword, size_t len, void* value) {
@@ -142,9 +158,9 @@ trie_node_t trie_next_node_by_binary(trie_t self, trie_node_t pNode, uint8_t key
 }
 
 void trie_swap_node_data(trie_node_t pa, trie_node_t pb) {
-  alib_swap(size_t, pa->trie_child, pb->trie_child);
-  alib_swap(size_t, pa->trie_brother, pb->trie_brother);
-  alib_swap(size_t, pa->trie_parent, pb->trie_parent);
+  alib_swap(trie_idx_t, pa->trie_child, pb->trie_child);
+  alib_swap(trie_idx_t, pa->trie_brother, pb->trie_brother);
+  alib_swap(trie_idx_t, pa->trie_parent, pb->trie_parent);
 
   // dict index
   alib_swap(void*, pa->value, pb->value);
@@ -247,6 +263,7 @@ trie_t trie_alloc() {
       break;
     }
 
+    trie->size = 0;
     trie->node_array = segarray_construct_with_type(trie_node_s);
     if (trie->node_array == NULL) {
       break;
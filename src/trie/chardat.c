@@ -0,0 +1,616 @@
+/**
+ * chardat.c - Double-Array Trie on characters
+ *
+ * @author James Yin <ywhjames@hotmail.com>
+ */
+#include "chardat.h"
+
+#define CHARDAT_ROOT_IDX 0
+#define CHARDAT_FREE UINT32_MAX
+#define CHARDAT_MULTI_SKIP 16 /* windows of 64 nodes tried before multi_start moves forward */
+#define CHARDAT_ROOT_CHECK (UINT32_MAX - 1) /* root is not child of any node, even by unknown character */
+
+// Alphabet
+// ========================================================
+
+static bool chardat_set_char_id(chardat_t self, uint32_t cp, uint32_t id) {
+  uint32_t** page = &self->pages[cp >> NORMALIZER_PAGE_SHIFT];
+  if (*page == NULL) {
+    *page = amalloc(NORMALIZER_PAGE_SIZE * sizeof(uint32_t));
+    if (*page == NULL) {
+      return false;
+    }
+    memset(*page, 0, NORMALIZER_PAGE_SIZE * sizeof(uint32_t));
+  }
+  (*page)[cp & (NORMALIZER_PAGE_SIZE - 1)] = id;
+  if (cp < 128) {
+    self->ascii[cp] = id;
+  }
+  return true;
+}
+
+static inline uint32_t chardat_char_id(chardat_t self, uint32_t cp) {
+  uint32_t* page = self->pages[cp >> NORMALIZER_PAGE_SHIFT];
+  return page != NULL ? page[cp & (NORMALIZER_PAGE_SIZE - 1)] : 0;
+}
+
+/**
+ * chardat_build_alphabet - number characters of keywords in order of codepoint, so that order of sorted keywords is
+ * also the order of their ids.
+ */
+static bool chardat_build_alphabet(chardat_t self, dat_builder_t builder) {
+  size_t word_count = NORMALIZER_RAW >> 6;
+  uint64_t* bitmap = amalloc(word_count * sizeof(uint64_t));
+  if (bitmap == NULL) {
+    return false;
+  }
+  memset(bitmap, 0, word_count * sizeof(uint64_t));
+
+  bool succeed = true;
+  for (size_t i = 0; succeed && i < builder->count; i++) {
+    dat_builder_entry_t entry = &builder->entries[i];
+    for (size_t offset = 0; offset < entry->len;) {
+      uint32_t cp;
+      offset += normalizer_decode(entry->keyword.ptr + offset, entry->len - offset, &cp);
+      if (cp >= NORMALIZER_RAW) {
+        // byte order of invalid sequence is not the order of characters
+        succeed = false;
+        break;
+      }
+      bitmap[cp >> 6] |= 1ULL << (cp & 63);
+    }
+  }
+
+  uint32_t id = 0;
+  for (size_t w = 0; succeed && w < word_count; w++) {
+    for (uint32_t bit = 0; bitmap[w] != 0 && bit < 64; bit++) {
+      if ((bitmap[w] >> bit) & 1) {
+        if (!chardat_set_char_id(self, (uint32_t)(w << 6) + bit, ++id)) {
+          succeed = false;
+          break;
+        }
+      }
+    }
+  }
+  self->alphabet_size = id;
+
+  afree(bitmap);
+  return succeed;
+}
+
+// Construct by Builder
+// ========================================================
+
+typedef struct _chardat_builder_run_ {
+  size_t lo, hi;   /* entries with common prefix */
+  size_t offset;   /* bytes of common prefix */
+  uint32_t datidx;
+} chardat_builder_run_s, *chardat_builder_run_t;
+
+typedef struct _chardat_build_context_ {
+  chardat_t trie;
+  uint64_t* used; /* bitmap of taken nodes, so that first fit skips 64 nodes per step */
+  size_t used_words;
+  size_t first_free;  /* nodes before it are all taken */
+  size_t multi_start; /* nodes before it are too dense for several children */
+  size_t base_max;
+  size_t index_max;
+} chardat_build_ctx_s, *chardat_build_ctx_t;
+
+static bool chardat_reserve(chardat_build_ctx_t build, size_t count) {
+  chardat_t self = build->trie;
+  if (count <= self->node_count) {
+    return true;
+  }
+  size_t capacity = alib_max(count, self->node_count * 2);
+  if (capacity >= CHARDAT_ROOT_CHECK) {
+    return false;
+  }
+  chardat_node_t node_array = arealloc(self->node_array, capacity * sizeof(chardat_node_s));
+  if (node_array == NULL) {
+    return false;
+  }
+  for (size_t i = self->node_count; i < capacity; i++) {
+    node_array[i] = (chardat_node_s){.check = CHARDAT_FREE, .base = 0, .failed = 0, .value = 0};
+  }
+  self->node_array = node_array;
+  self->node_count = capacity;
+
+  size_t used_words = capacity / 64 + 1;
+  uint64_t* used = arealloc(build->used, used_words * sizeof(uint64_t));
+  if (used == NULL) {
+    return false;
+  }
+  memset(used + build->used_words, 0, (used_words - build->used_words) * sizeof(uint64_t));
+  build->used = used;
+  build->used_words = used_words;
+  return true;
+}
+
+static void chardat_reserve_or_exit(chardat_build_ctx_t build, size_t count) {
+  if (!chardat_reserve(build, count)) {
+    fprintf(stderr, "chardat: alloc node_array failed.\nexit.\n");
+    exit(-1);
+  }
+}
+
+static void chardat_take_node(chardat_build_ctx_t build, size_t index, uint32_t parent) {
+  build->trie->node_array[index].check = parent;
+  build->used[index >> 6] |= 1ULL << (index & 63);
+  build->index_max = alib_max(build->index_max, index);
+}
+
+/**
+ * chardat_free_bits - bit i is set if node at pos + i is free, node_array must be reserved to pos + 128.
+ */
+static inline uint64_t chardat_free_bits(chardat_build_ctx_t build, size_t pos) {
+  size_t w = pos >> 6, shift = pos & 63;
+  uint64_t used = build->used[w] >> shift;
+  if (shift > 0) {
+    used |= build->used[w + 1] << (64 - shift);
+  }
+  return ~used;
+}
+
+static inline size_t chardat_lowest_bit(uint64_t bits) {
+  size_t bit = 0;
+  while (!((bits >> bit) & 1)) {
+    bit++;
+  }
+  return bit;
+}
+
+/**
+ * chardat_find_base - first fit, 64 bases are tested at once by bitmap of taken nodes
+ */
+static size_t chardat_find_base(chardat_build_ctx_t build, const uint32_t child[], size_t len) {
+  // skip the dense head, nodes before first_free are all taken
+  uint64_t bits;
+  while (1) {
+    chardat_reserve_or_exit(build, build->first_free + 128);
+    bits = chardat_free_bits(build, build->first_free);
+    if (bits != 0) {
+      break;
+    }
+    build->first_free += 64;
+  }
+  build->first_free += chardat_lowest_bit(bits);
+
+  // nodes with several children rarely fit in holes left by others, they start from later position
+  size_t start = len > 1 ? alib_max(build->first_free, build->multi_start) : build->first_free;
+  size_t base = alib_max(start, child[0]) - child[0];
+  for (size_t tried = 0;; tried++) {
+    chardat_reserve_or_exit(build, base + child[len - 1] + 128);
+    bits = ~0ULL;
+    for (size_t i = 0; i < len && bits != 0; i++) {
+      bits &= chardat_free_bits(build, base + child[i]);
+    }
+    if (bits != 0) {
+      base += chardat_lowest_bit(bits);
+      if (len > 1 && tried > CHARDAT_MULTI_SKIP) {
+        build->multi_start = base + child[0] - CHARDAT_MULTI_SKIP * 64;
+      }
+      build->base_max = alib_max(build->base_max, base);
+      return base;
+    }
+    base += 64;
+  }
+}
+
+/**
+ * chardat_split_run - split run by character at offset, keyword ends at offset is sorted first and taken as value
+ */
+static size_t chardat_split_run(chardat_t self,
+                                dat_builder_entry_t entries,
+                                size_t lo,
+                                size_t hi,
+                                size_t offset,
+                                void** value,
+                                uint32_t child[],
+                                size_t step[],
+                                size_t bound[]) {
+  *value = NULL;
+  if (lo < hi && entries[lo].len == offset) {
+    *value = entries[lo++].value;
+  }
+
+  size_t len = 0;
+  for (size_t i = lo; i < hi; i++) {
+    uint32_t cp;
+    size_t n = normalizer_decode(entries[i].keyword.ptr + offset, entries[i].len - offset, &cp);
+    uint32_t key = chardat_char_id(self, cp);
+    if (len == 0 || child[len - 1] != key) {
+      child[len] = key;
+      step[len] = n;
+      bound[len++] = i;
+    }
+  }
+  bound[len] = hi;
+
+  return len;
+}
+
+static uint32_t chardat_next_by_index(chardat_t self, uint32_t index, uint32_t key) {
+  uint32_t next = self->node_array[index].base + key;
+  return self->node_array[next].check == index ? next : CHARDAT_ROOT_IDX;
+}
+
+static uint32_t chardat_failed_by_index(chardat_t self, uint32_t parent, uint32_t key) {
+  if (parent == CHARDAT_ROOT_IDX) {
+    return CHARDAT_ROOT_IDX;
+  }
+  // failed nodes are shallower than parent, their children are placed already
+  uint32_t iFailed = self->node_array[parent].failed;
+  while (1) {
+    uint32_t match = chardat_next_by_index(self, iFailed, key);
+    if (match != CHARDAT_ROOT_IDX || iFailed == CHARDAT_ROOT_IDX) {
+      return match;
+    }
+    iFailed = self->node_array[iFailed].failed;
+  }
+}
+
+static void chardat_set_value(chardat_t self, uint32_t index, void* value) {
+  chardat_node_t node = &self->node_array[index];
+  // nodes are visited by bfs, so values of failed node are linked already
+  uint32_t next = index == CHARDAT_ROOT_IDX ? 0 : self->node_array[node->failed].value;
+  if (value != NULL) {
+    self->value_array[self->value_count] = (chardat_value_s){.value = value, .next = next};
+    node->value = (uint32_t)++self->value_count;
+  } else {
+    node->value = next;
+  }
+}
+
+static void chardat_construct_by_builder0(chardat_t self, dat_builder_t builder) {
+  dat_builder_entry_t entries = builder->entries;
+  size_t alphabet = self->alphabet_size;
+
+  // runs in stack or in one level are disjoint, so they are bounded by count of entries
+  size_t capacity = builder->count + 1;
+  chardat_builder_run_t level = amalloc(capacity * sizeof(chardat_builder_run_s));
+  chardat_builder_run_t next_level = amalloc(capacity * sizeof(chardat_builder_run_s));
+  uint32_t* child = amalloc((alphabet + 1) * sizeof(uint32_t));
+  size_t* step = amalloc((alphabet + 1) * sizeof(size_t));
+  size_t* bound = amalloc((alphabet + 2) * sizeof(size_t));
+  self->value_array = amalloc(alib_max(builder->count, 1) * sizeof(chardat_value_s));
+  if (level == NULL || next_level == NULL || child == NULL || step == NULL || bound == NULL ||
+      self->value_array == NULL) {
+    fprintf(stderr, "chardat: alloc builder_run failed.\nexit.\n");
+    exit(-1);
+  }
+
+  chardat_build_ctx_s build = {
+      .trie = self, .used = NULL, .used_words = 0, .first_free = 0, .multi_start = 0, .base_max = 0, .index_max = 0};
+  chardat_reserve_or_exit(&build, alphabet + 1);
+  chardat_take_node(&build, CHARDAT_ROOT_IDX, CHARDAT_ROOT_CHECK);
+  void* value;
+
+  // place nodes by dfs, same as dat_t
+  chardat_builder_run_t stack = level;
+  stack[0] = (chardat_builder_run_s){.lo = 0, .hi = builder->count, .offset = 0, .datidx = CHARDAT_ROOT_IDX};
+  size_t stack_top = 1;
+  while (stack_top > 0) {
+    chardat_builder_run_s run = stack[--stack_top];
+
+    size_t len = chardat_split_run(self, entries, run.lo, run.hi, run.offset, &value, child, step, bound);
+    if (len == 0) {  // leaf node
+      self->node_array[run.datidx].base = 0;
+      continue;
+    }
+
+    size_t base = chardat_find_base(&build, child, len);
+    self->node_array[run.datidx].base = (uint32_t)base;
+    for (size_t i = 0; i < len; ++i) {
+      chardat_take_node(&build, base + child[i], run.datidx);
+    }
+
+    // push in reverse order, so that children are visited in order of key
+    for (size_t i = len; i > 0; --i) {
+      chardat_builder_run_t sub = &stack[stack_top++];
+      sub->lo = bound[i - 1];
+      sub->hi = bound[i];
+      sub->offset = run.offset + step[i - 1];
+      sub->datidx = (uint32_t)(base + child[i - 1]);
+    }
+  }
+
+  // pad by alphabet, then transition from any node never overflows
+  size_t node_count = alib_max(build.index_max, build.base_max + alphabet) + 1;
+  chardat_reserve_or_exit(&build, node_count);
+  afree(build.used);
+
+  // set values and failed by bfs
+  level[0] = (chardat_builder_run_s){.lo = 0, .hi = builder->count, .offset = 0, .datidx = CHARDAT_ROOT_IDX};
+  size_t width = 1;
+  while (width > 0) {
+    size_t next_width = 0;
+    for (size_t r = 0; r < width; r++) {
+      chardat_builder_run_s run = level[r];
+      size_t len = chardat_split_run(self, entries, run.lo, run.hi, run.offset, &value, child, step, bound);
+      chardat_set_value(self, run.datidx, value);
+
+      uint32_t base = self->node_array[run.datidx].base;
+      for (size_t i = 0; i < len; ++i) {
+        self->node_array[base + child[i]].failed = chardat_failed_by_index(self, run.datidx, child[i]);
+        chardat_builder_run_t sub = &next_level[next_width++];
+        sub->lo = bound[i];
+        sub->hi = bound[i + 1];
+        sub->offset = run.offset + step[i];
+        sub->datidx = base + child[i];
+      }
+    }
+    alib_swap(chardat_builder_run_t, level, next_level);
+    width = next_width;
+  }
+
+  // drop slots after pad
+  chardat_node_t node_array = arealloc(self->node_array, node_count * sizeof(chardat_node_s));
+  if (node_array != NULL) {
+    self->node_array = node_array;
+    self->node_count = node_count;
+  }
+
+  afree(level);
+  afree(next_level);
+  afree(child);
+  afree(step);
+  afree(bound);
+}
+
+static chardat_t chardat_alloc() {
+  chardat_t chardat = amalloc(sizeof(chardat_s));
+  if (chardat == NULL) {
+    return NULL;
+  }
+  chardat->node_array = NULL;
+  chardat->node_count = 0;
+  chardat->value_array = NULL;
+  chardat->value_count = 0;
+  chardat->alphabet_size = 0;
+  memset(chardat->ascii, 0, sizeof(chardat->ascii));
+  memset(chardat->pages, 0, sizeof(chardat->pages));
+  return chardat;
+}
+
+chardat_t chardat_construct_by_builder(dat_builder_t builder, dat_builder_merge_f merge_func) {
+  chardat_t chardat = chardat_alloc();
+  if (chardat == NULL) {
+    return NULL;
+  }
+
+  dat_builder_seal(builder, merge_func);
+  if (builder->count >= CHARDAT_FREE / 2 || !chardat_build_alphabet(chardat, builder)) {
+    chardat_destruct(chardat, NULL);
+    return NULL;
+  }
+  chardat_construct_by_builder0(chardat, builder);
+
+  return chardat;
+}
+
+void chardat_destruct(chardat_t chardat, chardat_value_free_f value_free_func) {
+  if (chardat != NULL) {
+    if (value_free_func != NULL) {
+      for (size_t i = 0; i < chardat->value_count; i++) {
+        value_free_func(chardat, chardat->value_array[i].value);
+      }
+    }
+    for (size_t i = 0; i < CHARDAT_PAGE_COUNT; i++) {
+      afree(chardat->pages[i]);
+    }
+    afree(chardat->node_array);
+    afree(chardat->value_array);
+    afree(chardat);
+  }
+}
+
+void chardat_stats(chardat_t self, dat_stats_t stats) {
+  stats->node_count = self->node_count;
+  stats->node_used = 0;
+  stats->node_pad = 0;
+  stats->value_count = self->value_count;
+  stats->failed_chain_total = 0;
+  stats->failed_chain_max = 0;
+  if (stats->depth_histogram != NULL) {
+    memset(stats->depth_histogram, 0, sizeof(size_t) * stats->depth_buckets);
+  }
+
+  size_t last_used = 0;
+  for (size_t i = 0; i < self->node_count; i++) {
+    chardat_node_t node = &self->node_array[i];
+    if (node->check == CHARDAT_FREE) {
+      continue;
+    }
+    stats->node_used++;
+    last_used = i;
+
+    if (stats->depth_histogram != NULL && stats->depth_buckets > 0) {
+      size_t depth = 0;
+      for (uint32_t p = (uint32_t)i; p != CHARDAT_ROOT_IDX; p = self->node_array[p].check) {
+        depth++;
+      }
+      stats->depth_histogram[alib_min(depth, stats->depth_buckets - 1)]++;
+    }
+
+    size_t chain = 0;
+    for (uint32_t p = (uint32_t)i; p != CHARDAT_ROOT_IDX; p = self->node_array[p].failed) {
+      chain++;
+    }
+    stats->failed_chain_total += chain;
+    stats->failed_chain_max = alib_max(stats->failed_chain_max, chain);
+  }
+  // slots after the last node are reserved for transition by any character
+  stats->node_pad = self->node_count - (last_used + 1);
+}
+
+// Match
+// ========================================================
+
+chardat_ctx_t chardat_alloc_context(chardat_t chardat) {
+  chardat_ctx_t ctx = amalloc(sizeof(chardat_ctx_s));
+  if (ctx != NULL) {
+    ctx->trie = chardat;
+    chardat_reset_context(ctx, NULL, 0);
+  }
+  return ctx;
+}
+
+void chardat_free_context(chardat_ctx_t context) {
+  afree(context);
+}
+
+void chardat_reset_context(chardat_ctx_t context, char content[], size_t len) {
+  context->content = (strlen_s){.ptr = content, .len = len};
+  context->cesu = false;
+  context->_read = 0;
+  context->_cursor = CHARDAT_ROOT_IDX;
+  context->_matched = 0;
+}
+
+void chardat_reset_context_utf16(chardat_ctx_t context, const uint16_t content[], size_t len, bool cesu) {
+  chardat_reset_context(context, (char*)content, len);
+  context->cesu = cesu;
+}
+
+void chardat_refill_context(chardat_ctx_t context, char content[], size_t len) {
+  context->content = (strlen_s){.ptr = content, .len = len};
+  context->_read = 0;
+}
+
+bool chardat_match_end(chardat_ctx_t ctx) {
+  return ctx->_read >= ctx->content.len;
+}
+
+/**
+ * chardat_forward_char - decode one character at *read and return its id, ASCII and 3 bytes form are inlined.
+ */
+static inline uint32_t chardat_forward_char(chardat_t self, const uint8_t* content, size_t len, size_t* read) {
+  size_t i = *read;
+  uint8_t lead = content[i];
+  if (lead < 0x80) {
+    *read = i + 1;
+    return self->ascii[lead];
+  }
+
+  uint32_t cp;
+  if ((lead & 0xF0) == 0xE0 && i + 2 < len && (content[i + 1] & 0xC0) == 0x80 && (content[i + 2] & 0xC0) == 0x80 &&
+      (cp = ((lead & 0x0Fu) << 12) | ((content[i + 1] & 0x3Fu) << 6) | (content[i + 2] & 0x3Fu)) >= 0x800) {
+    *read = i + 3;
+  } else {
+    *read = i + normalizer_decode(content + i, len - i, &cp);
+  }
+  return chardat_char_id(self, cp);
+}
+
+/**
+ * chardat_forward_unit - unpaired surrogate is a character of its own, as it is transcoded to 3 bytes.
+ */
+static inline uint32_t chardat_forward_unit(chardat_t self,
+                                            const uint16_t* content,
+                                            size_t len,
+                                            size_t* read,
+                                            bool cesu) {
+  size_t i = *read;
+  uint32_t c = content[i];
+  *read = i + 1;
+  if (c < 0x80) {
+    return self->ascii[c];
+  }
+  if (!cesu && c >= 0xD800 && c < 0xDC00 && i + 1 < len && content[i + 1] >= 0xDC00 && content[i + 1] < 0xE000) {
+    c = 0x10000 + ((c - 0xD800) << 10) + (content[i + 1] - 0xDC00);
+    *read = i + 2;
+  }
+  return chardat_char_id(self, c);
+}
+
+static inline uint32_t chardat_forward(chardat_ctx_t ctx, size_t* read, bool units) {
+  if (units) {
+    return chardat_forward_unit(ctx->trie, (const uint16_t*)ctx->content.ptr, ctx->content.len, read, ctx->cesu);
+  }
+  return chardat_forward_char(ctx->trie, (const uint8_t*)ctx->content.ptr, ctx->content.len, read);
+}
+
+/**
+ * chardat_ac_next0 - units is constant at every call site, so scan on bytes and scan on units are two loops.
+ */
+static inline bool chardat_ac_next0(chardat_ctx_t ctx, bool units) {
+  chardat_t trie = ctx->trie;
+
+  /* 检查当前匹配点向树根的路径上是否还有匹配的词 */
+  if (ctx->_matched != 0) {
+    ctx->_matched = trie->value_array[ctx->_matched - 1].next;
+    if (ctx->_matched != 0) {
+      return true;
+    }
+  }
+
+  /* 执行匹配 */
+  chardat_node_t node_array = trie->node_array;
+  size_t len = ctx->content.len;
+  size_t read = ctx->_read;
+  uint32_t iCursor = ctx->_cursor;
+  while (read < len) {
+    uint32_t key = chardat_forward(ctx, &read, units);
+    uint32_t iNext = node_array[iCursor].base + key;
+    while (iCursor != CHARDAT_ROOT_IDX && node_array[iNext].check != iCursor) {
+      iCursor = node_array[iCursor].failed;
+      iNext = node_array[iCursor].base + key;
+    }
+    if (node_array[iNext].check == iCursor) {
+      iCursor = iNext;
+      if (node_array[iNext].value != 0) {
+        ctx->_cursor = iCursor;
+        ctx->_matched = node_array[iNext].value;
+        ctx->_read = read;
+        return true;
+      }
+    }
+  }
+
+  ctx->_cursor = iCursor;
+  ctx->_read = read;
+  return false;
+}
+
+static inline bool chardat_ac_prefix_next0(chardat_ctx_t ctx, bool units) {
+  chardat_node_t node_array = ctx->trie->node_array;
+  size_t len = ctx->content.len;
+  uint32_t iCursor = ctx->_cursor;
+  while (ctx->_read < len) {
+    size_t read = ctx->_read;
+    uint32_t iNext = node_array[iCursor].base + chardat_forward(ctx, &read, units);
+    if (node_array[iNext].check != iCursor) {
+      // keep cursor, prefix is broken and later calls must fail at the same place
+      ctx->_cursor = iCursor;
+      return false;
+    }
+    iCursor = iNext;
+    ctx->_read = read;
+    if (node_array[iNext].value != 0) {
+      ctx->_cursor = iCursor;
+      ctx->_matched = node_array[iNext].value;
+      return true;
+    }
+  }
+
+  // keep cursor, content may be refilled
+  ctx->_cursor = iCursor;
+  return false;
+}
+
+bool chardat_ac_next_on_char(chardat_ctx_t ctx) {
+  return chardat_ac_next0(ctx, false);
+}
+
+bool chardat_ac_prefix_next_on_char(chardat_ctx_t ctx) {
+  return chardat_ac_prefix_next0(ctx, false);
+}
+
+bool chardat_ac_next_on_unit(chardat_ctx_t ctx) {
+  return chardat_ac_next0(ctx, true);
+}
+
+bool chardat_ac_prefix_next_on_unit(chardat_ctx_t ctx) {
+  return chardat_ac_prefix_next0(ctx, true);
+}
@@ -0,0 +1,105 @@
+/**
+ * chardat.h - Double-Array Trie on characters
+ *
+ * @author James Yin <ywhjames@hotmail.com>
+ */
+#ifndef __ACTRIE_CHARDAT_H__
+#define __ACTRIE_CHARDAT_H__
+
+#include <alib/string/astr.h>
+
+#include "../normalizer.h"
+#include "acdat.h"
+#include "datbuilder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* pages of alphabet cover raw bytes after unicode */
+#define CHARDAT_PAGE_COUNT ((NORMALIZER_RAW + 256) >> NORMALIZER_PAGE_SHIFT)
+
+typedef struct _chardat_node_ {
+  uint32_t check;
+  uint32_t base;
+  uint32_t failed;
+  uint32_t value; /* index of value_array plus 1, 0 if no keyword ends here or at failed nodes */
+} chardat_node_s, *chardat_node_t;
+
+typedef struct _chardat_value_ {
+  void* value;
+  uint32_t next; /* index of value_array plus 1 */
+} chardat_value_s, *chardat_value_t;
+
+/**
+ * chardat - every transition consumes one UTF-8 character, which is mapped to id local to dictionary. ids are
+ * numbered in order of codepoint from 1, and 0 is for characters not in dictionary, so a CJK keyword takes one
+ * hop per character instead of three.
+ *
+ * node_array is padded by size of alphabet after the last base, so transition needs no bound check.
+ */
+typedef struct _chardat_ {
+  chardat_node_t node_array;
+  size_t node_count;
+  chardat_value_t value_array;
+  size_t value_count;
+  uint32_t alphabet_size;
+  uint32_t ascii[128];
+  uint32_t* pages[CHARDAT_PAGE_COUNT]; /* id of character by page, NULL if no character of page in dictionary */
+} chardat_s, *chardat_t;
+
+typedef struct _chardat_context_ {
+  strlen_s content; /* UTF-16 code units after chardat_reset_context_utf16, len and offsets are in units */
+  bool cesu;        /* surrogates of UTF-16 content are matched one by one */
+
+  chardat_t trie;
+
+  uint32_t _matched; /* index of value_array plus 1 */
+  uint32_t _cursor;
+  size_t _read;
+} chardat_ctx_s, *chardat_ctx_t;
+
+typedef void (*chardat_value_free_f)(chardat_t chardat, void* value);
+
+/**
+ * chardat_construct_by_builder - build automation on characters, builder is sealed and can be destructed after.
+ * NULL is returned if some keyword is not valid UTF-8, caller can fall back to dat_t.
+ */
+chardat_t chardat_construct_by_builder(dat_builder_t builder, dat_builder_merge_f merge_func);
+void chardat_destruct(chardat_t chardat, chardat_value_free_f value_free_func);
+
+/**
+ * chardat_stats - depth in histogram is counted by characters.
+ */
+void chardat_stats(chardat_t chardat, dat_stats_t stats);
+
+chardat_ctx_t chardat_alloc_context(chardat_t chardat);
+void chardat_free_context(chardat_ctx_t context);
+void chardat_reset_context(chardat_ctx_t context, char content[], size_t len);
+/**
+ * chardat_refill_context - continue scanning on next chunk of content, chunk must end at boundary of character.
+ */
+void chardat_refill_context(chardat_ctx_t context, char content[], size_t len);
+
+/**
+ * chardat_reset_context_utf16 - scan UTF-16 code units without transcoding. surrogate pair is one character, or two
+ * characters with cesu, same as they are transcoded to UTF-8 or CESU-8. refill is not supported.
+ */
+void chardat_reset_context_utf16(chardat_ctx_t context, const uint16_t content[], size_t len, bool cesu);
+
+bool chardat_match_end(chardat_ctx_t ctx);
+
+static inline void* chardat_matched_value(chardat_ctx_t ctx) {
+  return ctx->trie->value_array[ctx->_matched - 1].value;
+}
+
+bool chardat_ac_next_on_char(chardat_ctx_t ctx);
+bool chardat_ac_prefix_next_on_char(chardat_ctx_t ctx);
+bool chardat_ac_next_on_unit(chardat_ctx_t ctx);
+bool chardat_ac_prefix_next_on_unit(chardat_ctx_t ctx);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif  // __ACTRIE_CHARDAT_H__
@@ -0,0 +1,197 @@
+/**
+ * datbuilder.c
+ *
+ * @author James Yin <ywhjames@hotmail.com>
+ */
+#include "datbuilder.h"
+
+#define DAT_BUILDER_BUFFER_MIN 4096
+#define DAT_BUILDER_ENTRY_MIN 1024
+
+dat_builder_t dat_builder_construct() {
+  dat_builder_t builder = amalloc(sizeof(dat_builder_s));
+  if (builder == NULL) {
+    return NULL;
+  }
+
+  builder->buffer = amalloc(DAT_BUILDER_BUFFER_MIN);
+  builder->buffer_size = 0;
+  builder->buffer_capacity = DAT_BUILDER_BUFFER_MIN;
+  builder->entries = NULL;
+  builder->count = 0;
+  builder->capacity = 0;
+  builder->sealed = false;
+  if (builder->buffer == NULL) {
+    afree(builder);
+    return NULL;
+  }
+
+  return builder;
+}
+
+void dat_builder_destruct(dat_builder_t builder, dat_builder_free_f value_free_func) {
+  if (builder != NULL) {
+    if (value_free_func != NULL) {
+      for (size_t i = 0; i < builder->count; i++) {
+        value_free_func(builder, builder->entries[i].value);
+      }
+    }
+    afree(builder->entries);
+    afree(builder->buffer);
+    afree(builder);
+  }
+}
+
+bool dat_builder_reserve(dat_builder_t self, size_t capacity) {
+  if (capacity <= self->capacity) {
+    return true;
+  }
+  dat_builder_entry_t entries = arealloc(self->entries, capacity * sizeof(dat_builder_entry_s));
+  if (entries == NULL) {
+    return false;
+  }
+  self->entries = entries;
+  self->capacity = capacity;
+  return true;
+}
+
+bool dat_builder_add_keyword(dat_builder_t self, const char* keyword, size_t len, void* value) {
+  if (self->sealed) {
+    return false;
+  }
+
+  if (self->count >= self->capacity &&
+      !dat_builder_reserve(self, alib_max(self->capacity * 2, DAT_BUILDER_ENTRY_MIN))) {
+    return false;
+  }
+
+  size_t need = self->buffer_size + len;
+  if (need > self->buffer_capacity) {
+    size_t capacity = alib_max(self->buffer_capacity * 2, need);
+    char* buffer = arealloc(self->buffer, capacity);
+    if (buffer == NULL) {
+      return false;
+    }
+    self->buffer = buffer;
+    self->buffer_capacity = capacity;
+  }
+
+  dat_builder_entry_t entry = &self->entries[self->count++];
+  entry->keyword.offset = self->buffer_size;
+  entry->len = len;
+  entry->value = value;
+  memcpy(self->buffer + self->buffer_size, keyword, len);
+  self->buffer_size = need;
+
+  return true;
+}
+
+#define DAT_BUILDER_INSERTION_SORT 32
+
+typedef struct _datrie_builder_bucket_ {
+  size_t lo, hi;
+  size_t depth; /* entries in bucket have common prefix of depth bytes */
+} dat_builder_bucket_s, *dat_builder_bucket_t;
+
+static inline bool dat_builder_entry_less(dat_builder_entry_t x, dat_builder_entry_t y, size_t depth) {
+  size_t len = alib_min(x->len, y->len);
+  int r = memcmp(x->keyword.ptr + depth, y->keyword.ptr + depth, len - depth);
+  return r < 0 || (r == 0 && x->len < y->len);
+}
+
+/**
+ * dat_builder_sort - stable msd radix sort, same keywords are kept in order of adding
+ */
+static void dat_builder_sort(dat_builder_t self) {
+  if (self->count < 2) {
+    return;
+  }
+
+  // buckets in stack are disjoint and have two entries at least
+  dat_builder_entry_t temp = amalloc(self->count * sizeof(dat_builder_entry_s));
+  dat_builder_bucket_t stack = amalloc((self->count / 2 + 1) * sizeof(dat_builder_bucket_s));
+  if (temp == NULL || stack == NULL) {
+    fprintf(stderr, "dat_builder: alloc sort buffer failed.\nexit.\n");
+    exit(-1);
+  }
+
+  dat_builder_entry_t entries = self->entries;
+  size_t stack_top = 0;
+  stack[stack_top].lo = 0;
+  stack[stack_top].hi = self->count;
+  stack[stack_top].depth = 0;
+  stack_top++;
+  while (stack_top > 0) {
+    dat_builder_bucket_s bucket = stack[--stack_top];
+
+    if (bucket.hi - bucket.lo <= DAT_BUILDER_INSERTION_SORT) {
+      for (size_t i = bucket.lo + 1; i < bucket.hi; i++) {
+        dat_builder_entry_s entry = entries[i];
+        size_t j = i;
+        for (; j > bucket.lo && dat_builder_entry_less(&entry, &entries[j - 1], bucket.depth); j--) {
+          entries[j] = entries[j - 1];
+        }
+        entries[j] = entry;
+      }
+      continue;
+    }
+
+    // slot 0 is for keywords end at depth, they are sorted first
+    size_t count[257] = {0};
+    for (size_t i = bucket.lo; i < bucket.hi; i++) {
+      dat_builder_entry_t entry = &entries[i];
+      count[entry->len > bucket.depth ? entry->keyword.ptr[bucket.depth] + 1 : 0]++;
+    }
+
+    size_t offset[257];
+    offset[0] = bucket.lo;
+    for (size_t k = 1; k < 257; k++) {
+      offset[k] = offset[k - 1] + count[k - 1];
+    }
+    for (size_t i = bucket.lo; i < bucket.hi; i++) {
+      dat_builder_entry_t entry = &entries[i];
+      temp[offset[entry->len > bucket.depth ? entry->keyword.ptr[bucket.depth] + 1 : 0]++] = *entry;
+    }
+    memcpy(&entries[bucket.lo], &temp[bucket.lo], (bucket.hi - bucket.lo) * sizeof(dat_builder_entry_s));
+
+    // now, offset[k] is end of slot k
+    for (size_t k = 1; k < 257; k++) {
+      if (count[k] > 1) {
+        stack[stack_top].lo = offset[k] - count[k];
+        stack[stack_top].hi = offset[k];
+        stack[stack_top].depth = bucket.depth + 1;
+        stack_top++;
+      }
+    }
+  }
+
+  afree(stack);
+  afree(temp);
+}
+
+void dat_builder_seal(dat_builder_t self, dat_builder_merge_f merge_func) {
+  if (self->sealed) {
+    return;
+  }
+  self->sealed = true;
+
+  // buffer never grows from now on, convert offset to pointer
+  for (size_t i = 0; i < self->count; i++) {
+    self->entries[i].keyword.ptr = (const uint8_t*)self->buffer + self->entries[i].keyword.offset;
+  }
+
+  dat_builder_sort(self);
+
+  // merge values of same keyword, the older is merged first
+  size_t count = 0;
+  for (size_t i = 0; i < self->count; i++) {
+    dat_builder_entry_t last = count > 0 ? &self->entries[count - 1] : NULL;
+    dat_builder_entry_t entry = &self->entries[i];
+    if (last != NULL && last->len == entry->len && memcmp(last->keyword.ptr, entry->keyword.ptr, entry->len) == 0) {
+      last->value = merge_func(last->value, entry->value);
+    } else {
+      self->entries[count++] = *entry;
+    }
+  }
+  self->count = count;
+}
@@ -0,0 +1,62 @@
+/**
+ * datbuilder.h - collect keywords for building Double-Array Trie without linked trie
+ *
+ * @author James Yin <ywhjames@hotmail.com>
+ */
+#ifndef __ACTRIE_DATBUILDER_H__
+#define __ACTRIE_DATBUILDER_H__
+
+#include <alib/acom.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct _datrie_builder_entry_ {
+  union {
+    size_t offset; /* offset in buffer while adding */
+    const uint8_t* ptr;
+  } keyword;
+  size_t len;
+  void* value;
+} dat_builder_entry_s, *dat_builder_entry_t;
+
+/**
+ * dat_builder - keywords are stored in flat arrays instead of linked trie, which saves most of memory on large
+ * dictionary. After sealed, entries are sorted and unique, so every node of trie is a run of entries with common prefix.
+ */
+typedef struct _datrie_builder_ {
+  char* buffer;
+  size_t buffer_size, buffer_capacity;
+  dat_builder_entry_t entries;
+  size_t count, capacity;
+  bool sealed;
+} dat_builder_s, *dat_builder_t;
+
+typedef void (*dat_builder_free_f)(dat_builder_t builder, void* value);
+
+/**
+ * dat_builder_merge_f - merge values of same keyword, older is added before newer.
+ */
+typedef void* (*dat_builder_merge_f)(void* older, void* newer);
+
+dat_builder_t dat_builder_construct();
+void dat_builder_destruct(dat_builder_t builder, dat_builder_free_f value_free_func);
+
+/**
+ * dat_builder_reserve - reserve entries, so that array need not grow while adding keywords.
+ */
+bool dat_builder_reserve(dat_builder_t self, size_t capacity);
+
+bool dat_builder_add_keyword(dat_builder_t self, const char* keyword, size_t len, void* value);
+
+/**
+ * dat_builder_seal - sort entries and merge values of duplicate keywords, no keyword can be added after sealed.
+ */
+void dat_builder_seal(dat_builder_t self, dat_builder_merge_f merge_func);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif  // __ACTRIE_DATBUILDER_H__
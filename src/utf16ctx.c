@@ -0,0 +1,230 @@
+/**
+ * utf16ctx.c
+ *
+ * @author James Yin <ywhjames@hotmail.com>
+ */
+#include "utf16ctx.h"
+
+utf16ctx_t utf16ctx_alloc_context(matcher_t matcher, bool cesu) {
+  context_t context;
+  utf16ctx_t utf16ctx;
+
+  do {
+    // chars are transcoded to UTF-8, which legacy encodings can not match
+    if (matcher_encoding(matcher) != MATCHER_ENCODING_UTF8) {
+      return NULL;
+    }
+
+    context = matcher_alloc_context(matcher);
+    if (context == NULL) {
+      break;
+    }
+
+    utf16ctx = amalloc(sizeof(utf16ctx_s));
+    if (utf16ctx == NULL) {
+      break;
+    }
+
+    utf16ctx->units = NULL;
+    utf16ctx->unit_capacity = 0;
+    utf16ctx->buffer = NULL;
+    utf16ctx->len = 0;
+    utf16ctx->capacity = 0;
+    utf16ctx->pairs = NULL;
+    utf16ctx->pair_count = 0;
+    utf16ctx->pair_capacity = 0;
+    utf16ctx->cesu = cesu;
+    utf16ctx->native = matcher_scan_utf16(matcher);
+
+    utf16ctx->matcher_ctx = context;
+
+    utf16ctx->utf8_ctx.content = NULL;
+    utf16ctx->utf8_ctx.len = 0;
+    utf16ctx->utf8_ctx.encoding = utf16ctx->native ? UTF8_ENCODING_UTF16 : MATCHER_ENCODING_UTF8;
+    utf16ctx->utf8_ctx.next_lead = 0;
+    utf16ctx->utf8_ctx.blocks = NULL;
+    utf16ctx->utf8_ctx.built = 0;
+    utf16ctx->utf8_ctx.char_blocks = NULL;
+    utf16ctx->utf8_ctx.indexed = 0;
+    utf16ctx->utf8_ctx.capacity = 0;
+    // distance of pattern is counted by characters, same as utf8ctx. units are characters if native with cesu
+    if (utf16ctx->native && cesu) {
+      matcher_fix_pos(utf16ctx->matcher_ctx, NULL, NULL);
+    } else {
+      matcher_fix_pos(utf16ctx->matcher_ctx, fix_utf8_pos, &utf16ctx->utf8_ctx);
+    }
+
+    return utf16ctx;
+  } while (0);
+
+  matcher_free_context(context);
+
+  return NULL;
+}
+
+void utf16ctx_free_context(utf16ctx_t utf16ctx) {
+  if (utf16ctx != NULL) {
+    matcher_free_context(utf16ctx->matcher_ctx);
+    afree(utf16ctx->utf8_ctx.blocks);
+    afree(utf16ctx->utf8_ctx.char_blocks);
+    afree(utf16ctx->pairs);
+    afree(utf16ctx->buffer);
+    afree(utf16ctx->units);
+    afree(utf16ctx);
+  }
+}
+
+static bool utf16ctx_copy(utf16ctx_t utf16ctx, const uint16_t* content, size_t len) {
+  if (len > utf16ctx->unit_capacity) {
+    void* ptr = arealloc(utf16ctx->units, len * sizeof(uint16_t));
+    if (ptr == NULL) {
+      return false;
+    }
+    utf16ctx->units = ptr;
+    utf16ctx->unit_capacity = len;
+  }
+  if (len > 0) {
+    memcpy(utf16ctx->units, content, len * sizeof(uint16_t));
+  }
+  return true;
+}
+
+/**
+ * utf16ctx_transcode - three bytes per unit at most, a surrogate pair takes four bytes for two units, or six
+ * bytes with cesu.
+ *
+ * content is transcoded in one pass, the automaton only consumes bytes. runs of ASCII are copied by four units.
+ */
+static bool utf16ctx_transcode(utf16ctx_t utf16ctx, const uint16_t* content, size_t len) {
+  size_t capacity = len * 3 + 1;
+  if (capacity > utf16ctx->capacity) {
+    void* ptr = arealloc(utf16ctx->buffer, capacity);
+    if (ptr == NULL) {
+      return false;
+    }
+    utf16ctx->buffer = ptr;
+    utf16ctx->capacity = capacity;
+  }
+
+  uint8_t* out = (uint8_t*)utf16ctx->buffer;
+  size_t w = 0;
+  utf16ctx->pair_count = 0;
+  for (size_t i = 0; i < len; i++) {
+    uint32_t c = content[i];
+    if (c < 0x80) {
+      out[w++] = (uint8_t)c;
+      // run of ASCII, high byte and bit 7 of next four units are clear
+      while (i + 4 < len) {
+        uint64_t units;
+        memcpy(&units, content + i + 1, sizeof(units));
+        if ((units & 0xFF80FF80FF80FF80ULL) != 0) {
+          break;
+        }
+        out[w] = (uint8_t)content[i + 1];
+        out[w + 1] = (uint8_t)content[i + 2];
+        out[w + 2] = (uint8_t)content[i + 3];
+        out[w + 3] = (uint8_t)content[i + 4];
+        w += 4;
+        i += 4;
+      }
+    } else if (c < 0x800) {
+      out[w++] = (uint8_t)(0xC0 | (c >> 6));
+      out[w++] = (uint8_t)(0x80 | (c & 0x3F));
+    } else if (!utf16ctx->cesu && c >= 0xD800 && c < 0xDC00 && i + 1 < len && content[i + 1] >= 0xDC00 &&
+               content[i + 1] < 0xE000) {
+      if (utf16ctx->pair_count == utf16ctx->pair_capacity) {
+        size_t pair_capacity = alib_max(utf16ctx->pair_capacity * 2, 16);
+        void* ptr = arealloc(utf16ctx->pairs, pair_capacity * sizeof(size_t));
+        if (ptr == NULL) {
+          return false;
+        }
+        utf16ctx->pairs = ptr;
+        utf16ctx->pair_capacity = pair_capacity;
+      }
+      utf16ctx->pairs[utf16ctx->pair_count++] = w;
+
+      c = 0x10000 + ((c - 0xD800) << 10) + (content[++i] - 0xDC00);
+      out[w++] = (uint8_t)(0xF0 | (c >> 18));
+      out[w++] = (uint8_t)(0x80 | ((c >> 12) & 0x3F));
+      out[w++] = (uint8_t)(0x80 | ((c >> 6) & 0x3F));
+      out[w++] = (uint8_t)(0x80 | (c & 0x3F));
+    } else {
+      out[w++] = (uint8_t)(0xE0 | (c >> 12));
+      out[w++] = (uint8_t)(0x80 | ((c >> 6) & 0x3F));
+      out[w++] = (uint8_t)(0x80 | (c & 0x3F));
+    }
+  }
+  utf16ctx->len = w;
+
+  return true;
+}
+
+bool utf16ctx_reset_context(utf16ctx_t utf16ctx, const uint16_t* content, size_t len) {
+  if (utf16ctx == NULL || !utf16ctx_copy(utf16ctx, content, len)) {
+    return false;
+  }
+
+  if (utf16ctx->native) {
+    // map of chars is built lazily, only for distance of patterns
+    if (!utf16ctx->cesu && !reset_utf8_context(&utf16ctx->utf8_ctx, (char*)utf16ctx->units, len)) {
+      return false;
+    }
+    return matcher_reset_context_utf16(utf16ctx->matcher_ctx, utf16ctx->units, len, utf16ctx->cesu);
+  }
+
+  if (!utf16ctx_transcode(utf16ctx, utf16ctx->units, len) ||
+      !reset_utf8_context(&utf16ctx->utf8_ctx, utf16ctx->buffer, utf16ctx->len)) {
+    return false;
+  }
+
+  return matcher_reset_context(utf16ctx->matcher_ctx, utf16ctx->buffer, utf16ctx->len);
+}
+
+/**
+ * map_utf16_pos - units before byte pos are characters before it plus surrogate pairs before it.
+ */
+static inline size_t map_utf16_pos(utf16ctx_t utf16ctx, size_t pos) {
+  size_t units = map_utf8_pos(&utf16ctx->utf8_ctx, pos);
+  if (utf16ctx->pair_count > 0) {
+    // count of pairs start before pos
+    size_t lo = 0, hi = utf16ctx->pair_count;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (utf16ctx->pairs[mid] < pos) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    units += lo;
+  }
+  return units;
+}
+
+static word_t utf16ctx_output(utf16ctx_t utf16ctx, word_t matched_word) {
+  if (matched_word != NULL) {
+    if (!utf16ctx->native) {
+      matched_word->pos.so = map_utf16_pos(utf16ctx, matched_word->pos.so);
+      matched_word->pos.eo = map_utf16_pos(utf16ctx, matched_word->pos.eo);
+    }
+    matched_word->keyword = (strlen_s){.ptr = (char*)(utf16ctx->units + matched_word->pos.so),
+                                       .len = (matched_word->pos.eo - matched_word->pos.so) * sizeof(uint16_t)};
+  }
+  return matched_word;
+}
+
+word_t utf16ctx_next(utf16ctx_t utf16ctx) {
+  if (utf16ctx == NULL) {
+    return NULL;
+  }
+
+  return utf16ctx_output(utf16ctx, matcher_next(utf16ctx->matcher_ctx));
+}
+
+word_t utf16ctx_next_prefix(utf16ctx_t utf16ctx) {
+  if (utf16ctx == NULL) {
+    return NULL;
+  }
+
+  return utf16ctx_output(utf16ctx, matcher_next_prefix(utf16ctx->matcher_ctx));
+}
@@ -22,12 +22,25 @@ utf8ctx_t utf8ctx_alloc_context(matcher_t matcher) {
 
     utf8ctx->content.ptr = NULL;
     utf8ctx->content.len = 0;
+    utf8ctx->buffer = NULL;
 
     utf8ctx->matcher_ctx = context;
 
-    utf8ctx->utf8_ctx.pos = NULL;
+    utf8ctx->utf8_ctx.content = NULL;
     utf8ctx->utf8_ctx.len = 0;
-    matcher_fix_pos(utf8ctx->matcher_ctx, fix_utf8_pos, &utf8ctx->utf8_ctx);
+    utf8ctx->utf8_ctx.encoding = MATCHER_ENCODING_UTF8;
+    utf8ctx->utf8_ctx.next_lead = 0;
+    utf8ctx->utf8_ctx.blocks = NULL;
+    utf8ctx->utf8_ctx.built = 0;
+    utf8ctx->utf8_ctx.char_blocks = NULL;
+    utf8ctx->utf8_ctx.indexed = 0;
+    utf8ctx->utf8_ctx.capacity = 0;
+    // matcher context splits chars of legacy encoding already, share its map
+    utf8ctx->char_map = matcher_char_map(context);
+    if (utf8ctx->char_map == NULL) {
+      utf8ctx->char_map = &utf8ctx->utf8_ctx;
+    }
+    matcher_fix_pos(utf8ctx->matcher_ctx, fix_utf8_pos, utf8ctx->char_map);
 
     utf8ctx->return_byte_pos = false;
 
@@ -42,35 +55,32 @@ utf8ctx_t utf8ctx_alloc_context(matcher_t matcher) {
 void utf8ctx_free_context(utf8ctx_t utf8ctx) {
   if (utf8ctx != NULL) {
     matcher_free_context(utf8ctx->matcher_ctx);
-    afree(utf8ctx->utf8_ctx.pos);
-    afree(utf8ctx->content.ptr);
+    afree(utf8ctx->utf8_ctx.blocks);
+    afree(utf8ctx->utf8_ctx.char_blocks);
+    afree(utf8ctx->buffer);
     afree(utf8ctx);
   }
 }
 
-bool utf8ctx_reset_context(utf8ctx_t utf8ctx, char* content, int len, bool return_byte_pos) {
+bool utf8ctx_reset_context_borrowed(utf8ctx_t utf8ctx, char* content, int len, bool return_byte_pos) {
   do {
     if (utf8ctx == NULL) {
       break;
     }
 
-    // copy content
-    void* ptr = arealloc(utf8ctx->content.ptr, len);
-    if (ptr == NULL) {
-      break;
-    }
-    memcpy(ptr, content, len);
-
-    utf8ctx->content.ptr = ptr;
+    utf8ctx->content.ptr = content;
     utf8ctx->content.len = len;
 
     utf8ctx->return_byte_pos = return_byte_pos;
 
-    if (!reset_utf8_context(&utf8ctx->utf8_ctx, utf8ctx->content.ptr, utf8ctx->content.len)) {
+    if (utf8ctx->char_map == &utf8ctx->utf8_ctx &&
+        !reset_utf8_context(&utf8ctx->utf8_ctx, utf8ctx->content.ptr, utf8ctx->content.len)) {
       break;
     }
 
-    matcher_reset_context(utf8ctx->matcher_ctx, utf8ctx->content.ptr, utf8ctx->content.len);
+    if (!matcher_reset_context(utf8ctx->matcher_ctx, utf8ctx->content.ptr, utf8ctx->content.len)) {
+      break;
+    }
 
     return true;
   } while (0);
@@ -78,6 +88,22 @@ bool utf8ctx_reset_context(utf8ctx_t utf8ctx, char* content, int len, bool retur
   return false;
 }
 
+bool utf8ctx_reset_context(utf8ctx_t utf8ctx, char* content, int len, bool return_byte_pos) {
+  if (utf8ctx == NULL) {
+    return false;
+  }
+
+  // copy content
+  void* ptr = arealloc(utf8ctx->buffer, len);
+  if (ptr == NULL) {
+    return false;
+  }
+  memcpy(ptr, content, len);
+  utf8ctx->buffer = ptr;
+
+  return utf8ctx_reset_context_borrowed(utf8ctx, utf8ctx->buffer, len, return_byte_pos);
+}
+
 word_t utf8ctx_next(utf8ctx_t utf8ctx) {
   if (utf8ctx == NULL) {
     return NULL;
@@ -86,8 +112,8 @@ word_t utf8ctx_next(utf8ctx_t utf8ctx) {
   word_t matched_word = matcher_next(utf8ctx->matcher_ctx);
 
   if (matched_word != NULL && !utf8ctx->return_byte_pos) {
-    matched_word->pos.so = utf8ctx->utf8_ctx.pos[matched_word->pos.so];
-    matched_word->pos.eo = utf8ctx->utf8_ctx.pos[matched_word->pos.eo];
+    matched_word->pos.so = map_utf8_pos(utf8ctx->char_map, matched_word->pos.so);
+    matched_word->pos.eo = map_utf8_pos(utf8ctx->char_map, matched_word->pos.eo);
   }
 
   return matched_word;
@@ -101,8 +127,8 @@ word_t utf8ctx_next_prefix(utf8ctx_t utf8ctx) {
   word_t matched_word = matcher_next_prefix(utf8ctx->matcher_ctx);
 
   if (matched_word != NULL && !utf8ctx->return_byte_pos) {
-    matched_word->pos.so = utf8ctx->utf8_ctx.pos[matched_word->pos.so];
-    matched_word->pos.eo = utf8ctx->utf8_ctx.pos[matched_word->pos.eo];
+    matched_word->pos.so = map_utf8_pos(utf8ctx->char_map, matched_word->pos.so);
+    matched_word->pos.eo = map_utf8_pos(utf8ctx->char_map, matched_word->pos.eo);
   }
 
   return matched_word;
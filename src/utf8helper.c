@@ -5,61 +5,164 @@
  */
 #include "utf8helper.h"
 
-#include <alib/string/utf8.h>
+#include "matcher.h"
 
 utf8_ctx_t alloc_utf8_context(void) {
   utf8_ctx_t utf8_ctx = amalloc(sizeof(utf8_ctx_s));
   if (utf8_ctx != NULL) {
-    utf8_ctx->pos = NULL;
+    utf8_ctx->content = NULL;
     utf8_ctx->len = 0;
+    utf8_ctx->encoding = MATCHER_ENCODING_UTF8;
+    utf8_ctx->next_lead = 0;
+    utf8_ctx->blocks = NULL;
+    utf8_ctx->built = 0;
+    utf8_ctx->char_blocks = NULL;
+    utf8_ctx->indexed = 0;
+    utf8_ctx->capacity = 0;
   }
   return utf8_ctx;
 }
 
 void free_utf8_context(utf8_ctx_t context) {
   if (context != NULL) {
-    afree(context->pos);
+    afree(context->blocks);
+    afree(context->char_blocks);
     afree(context);
   }
 }
 
 bool reset_utf8_context(utf8_ctx_t context, char content[], size_t len) {
-  void* ptr = arealloc(context->pos, (len + 1) * sizeof(size_t));
-  if (ptr == NULL) {
-    return false;
+  // block of offset len is needed too
+  size_t count = (len >> UTF8_BLOCK_SHIFT) + 1;
+  if (count > context->capacity) {
+    void* ptr = arealloc(context->blocks, count * sizeof(utf8_block_s));
+    if (ptr == NULL) {
+      return false;
+    }
+    context->blocks = ptr;
+    // chars are no more than bytes, so are slots of char index
+    ptr = arealloc(context->char_blocks, count * sizeof(size_t));
+    if (ptr == NULL) {
+      return false;
+    }
+    context->char_blocks = ptr;
+    context->capacity = count;
   }
 
-  context->pos = ptr;
+  // map is built on demand, document without match costs nothing
+  context->content = content;
   context->len = len;
-  utf8_word_pos(content, context->len, context->pos);
+  context->built = 0;
+  context->indexed = 0;
+  context->next_lead = 0;
 
   return true;
 }
 
+/**
+ * mbcs_char_len - bytes of char at s, malformed byte is a char of its own.
+ */
+static inline size_t mbcs_char_len(unsigned encoding, const uint8_t* s, size_t len) {
+  if (s[0] < 0x81 || s[0] == 0xFF || len < 2) {
+    return 1;
+  }
+  if (encoding == MATCHER_ENCODING_GBK) {
+    // GB18030 four-byte form is lead, digit, lead, digit
+    if (s[1] >= 0x30 && s[1] <= 0x39) {
+      return len >= 4 && s[2] >= 0x81 && s[2] <= 0xFE && s[3] >= 0x30 && s[3] <= 0x39 ? 4 : 1;
+    }
+    return s[1] >= 0x40 && s[1] <= 0xFE && s[1] != 0x7F ? 2 : 1;
+  }
+  // Big5
+  return (s[1] >= 0x40 && s[1] <= 0x7E) || (s[1] >= 0xA1 && s[1] <= 0xFE) ? 2 : 1;
+}
+
+#define UTF8_BUILD_CHUNK 64 /* blocks */
+
+void build_utf8_pos(utf8_ctx_t context, size_t block) {
+  const uint8_t* content = (const uint8_t*)context->content;
+  size_t count = (context->len >> UTF8_BLOCK_SHIFT) + 1;
+  // build by chunk, so that most of lookups hit built range
+  size_t b = context->built, end = alib_min(alib_max(block + 1, b + UTF8_BUILD_CHUNK), count);
+  size_t chars = b > 0 ? context->blocks[b - 1].chars + utf8_popcount(context->blocks[b - 1].leads) : 0;
+
+  for (; b < end; b++) {
+    size_t start = b << UTF8_BLOCK_SHIFT, stop = alib_min(start + UTF8_BLOCK_SIZE, context->len);
+    uint64_t leads = 0;
+    if (context->encoding == MATCHER_ENCODING_UTF8) {
+      for (size_t i = start; i < stop; i++) {
+        leads |= (uint64_t)((content[i] & 0xC0) != 0x80) << (i - start);
+      }
+    } else if (context->encoding == UTF8_ENCODING_UTF16) {
+      // low surrogate after high surrogate is trail of pair, same as pairing forward
+      const uint16_t* units = (const uint16_t*)context->content;
+      for (size_t i = start; i < stop; i++) {
+        bool trail =
+            units[i] >= 0xDC00 && units[i] < 0xE000 && i > 0 && units[i - 1] >= 0xD800 && units[i - 1] < 0xDC00;
+        leads |= (uint64_t)!trail << (i - start);
+      }
+    } else {
+      // trail byte of legacy encoding may look like ASCII, so chars are walked from the start of content
+      size_t i = context->next_lead;
+      for (; i < stop; i += mbcs_char_len(context->encoding, content + i, context->len - i)) {
+        leads |= (uint64_t)1 << (i - start);
+      }
+      context->next_lead = i;
+    }
+    context->blocks[b].chars = chars;
+    context->blocks[b].leads = leads;
+    chars += utf8_popcount(leads);
+    while ((context->indexed << UTF8_BLOCK_SHIFT) < chars) {
+      context->char_blocks[context->indexed++] = b;
+    }
+  }
+
+  context->built = end;
+}
+
+/**
+ * utf8_select - offset of the (rank+1)-th set bit
+ */
+static inline size_t utf8_select(uint64_t x, size_t rank) {
+  while (rank-- > 0) {
+    x &= x - 1;
+  }
+  return utf8_popcount((x & (~x + 1)) - 1);
+}
+
+size_t seek_utf8_pos(utf8_ctx_t context, size_t chars) {
+  size_t count = (context->len >> UTF8_BLOCK_SHIFT) + 1;
+  size_t j = chars >> UTF8_BLOCK_SHIFT;
+  while (j >= context->indexed && context->built < count) {
+    build_utf8_pos(context, context->built);
+  }
+  if (j >= context->indexed) {
+    return context->len;
+  }
+
+  // char 64*j starts in this block, and char is at most 64 chars later
+  size_t b = context->char_blocks[j];
+  while (chars >= context->blocks[b].chars + utf8_popcount(context->blocks[b].leads)) {
+    if (++b >= count) {
+      return context->len;
+    }
+    if (b >= context->built) {
+      build_utf8_pos(context, b);
+    }
+  }
+
+  return (b << UTF8_BLOCK_SHIFT) + utf8_select(context->blocks[b].leads, chars - context->blocks[b].chars);
+}
+
 size_t fix_utf8_pos(size_t pos, size_t diff, bool plus_or_subtract, void* arg) {
   if (diff == 0) {
     return pos;
   }
   utf8_ctx_t utf8_ctx = (utf8_ctx_t)arg;
-  size_t diff_pos;
+  size_t char_pos = map_utf8_pos(utf8_ctx, pos);
   if (plus_or_subtract) {
-    if (utf8_ctx->len - pos <= diff * 3) {
-      diff_pos = utf8_ctx->len;
-    } else {
-      diff_pos = pos + diff * 3;
-    }
-    while (utf8_ctx->pos[diff_pos] - utf8_ctx->pos[pos] > diff) {
-      diff_pos--;
-    }
+    return seek_utf8_pos(utf8_ctx, char_pos + diff);
   } else {
-    if (diff * 3 >= pos) {
-      diff_pos = 0;
-    } else {
-      diff_pos = pos - diff * 3;
-    }
-    while (utf8_ctx->pos[pos] - utf8_ctx->pos[diff_pos] > diff) {
-      diff_pos++;
-    }
+    return seek_utf8_pos(utf8_ctx, char_pos > diff ? char_pos - diff : 0);
   }
-  return diff_pos;
 }
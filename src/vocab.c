@@ -5,8 +5,24 @@
  */
 #include "vocab.h"
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 vocab_t vocab_alloc() {
-  return amalloc(sizeof(vocab_s));
+  vocab_t vocab = amalloc(sizeof(vocab_s));
+  if (vocab != NULL) {
+    vocab->_stream = NULL;
+    vocab->_content = strlen_empty;
+    vocab->_cursor = 0;
+    vocab->_mapped = false;
+    vocab->_keywords = NULL;
+    vocab->_extras = NULL;
+  }
+  return vocab;
 }
 
 bool vocab_free(vocab_t self) {
@@ -17,31 +33,108 @@ bool vocab_free(vocab_t self) {
   return true;
 }
 
-vocab_t vocab_construct(stream_type_e type, void* src) {
+/**
+ * map regular file into memory, the pages are read only and never be written.
+ */
+static bool vocab_map_file(vocab_t self, const char* path) {
+#ifndef _WIN32
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return false;
+  }
+
+  if (st.st_size > 0) {
+    void* addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      close(fd);
+      return false;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(addr, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+    self->_content = (strlen_s){.ptr = addr, .len = (size_t)st.st_size};
+    self->_mapped = true;
+  }
+
+  close(fd);
+  return true;
+#else
+  return false;
+#endif
+}
+
+static void vocab_unmap_file(vocab_t self) {
+#ifndef _WIN32
+  if (self->_mapped) {
+    munmap(self->_content.ptr, self->_content.len);
+    self->_content = strlen_empty;
+    self->_mapped = false;
+  }
+#endif
+}
+
+static void vocab_count_in_place(vocab_t self) {
+  // memchr is vectorized by libc
+  const char* ptr = self->_content.ptr;
+  const char* end = ptr + self->_content.len;
+  self->count = 0;
+  while (ptr < end) {
+    const char* eol = memchr(ptr, '\n', end - ptr);
+    if (eol == NULL) {
+      self->count++;
+      break;
+    }
+    if (eol > ptr) {
+      self->count++;
+    }
+    ptr = eol + 1;
+  }
+  self->length = self->_content.len;
+}
+
+static void vocab_count_by_stream(vocab_t self) {
   int ch, ch0;
+
+  // get line number and file size
+  self->count = self->length = 0;
+  ch0 = '\n';
+  while ((ch = stream_getc(self->_stream)) != EOF) {
+    if (ch == '\n' && ch0 != '\n') {
+      self->count++;
+    }
+    self->length++;
+    ch0 = ch;
+  }
+  if (ch0 != '\n') {
+    self->count++;
+  }
+}
+
+vocab_t vocab_construct(stream_type_e type, void* src) {
   vocab_t vocab = vocab_alloc();
   do {
     if (src == NULL) {
       break;
     }
 
-    vocab->_stream = stream_construct(type, src);
-    if (vocab->_stream == NULL) {
-      break;
-    }
-
-    // get line number and file size
-    vocab->count = vocab->length = 0;
-    ch0 = '\n';
-    while ((ch = stream_getc(vocab->_stream)) != EOF) {
-      if (ch == '\n' && ch0 != '\n') {
-        vocab->count++;
+    if (type == stream_type_string) {
+      // split string in place
+      vocab->_content = *(strlen_t)src;
+      vocab_count_in_place(vocab);
+    } else if (type == stream_type_file && vocab_map_file(vocab, (const char*)src)) {
+      vocab_count_in_place(vocab);
+    } else {
+      vocab->_stream = stream_construct(type, src);
+      if (vocab->_stream == NULL) {
+        break;
       }
-      vocab->length++;
-      ch0 = ch;
-    }
-    if (ch0 != '\n') {
-      vocab->count++;
+      vocab_count_by_stream(vocab);
     }
 
     dynabuf_init(&vocab->_buf, 200);
@@ -53,11 +146,43 @@ vocab_t vocab_construct(stream_type_e type, void* src) {
   return NULL;
 }
 
+/**
+ * vocab_construct_by_array - words are not copied, and extras can be NULL.
+ */
+vocab_t vocab_construct_by_array(const strlen_s* keywords, const strlen_s* extras, size_t n) {
+  if (keywords == NULL && n > 0) {
+    return NULL;
+  }
+
+  vocab_t vocab = vocab_alloc();
+  if (vocab == NULL) {
+    return NULL;
+  }
+
+  vocab->_keywords = keywords;
+  vocab->_extras = extras;
+  vocab->count = n;
+  vocab->length = 0;
+  for (size_t i = 0; i < n; i++) {
+    vocab->length += keywords[i].len;
+    if (extras != NULL) {
+      vocab->length += extras[i].len;
+    }
+  }
+
+  dynabuf_init(&vocab->_buf, 200);
+
+  return vocab;
+}
+
 bool vocab_destruct(vocab_t self) {
   if (self == NULL) {
     return false;
   }
-  stream_destruct(self->_stream);
+  if (self->_stream != NULL) {
+    stream_destruct(self->_stream);
+  }
+  vocab_unmap_file(self);
   dynabuf_clean(&self->_buf);
   afree(self);
   return true;
@@ -71,21 +196,86 @@ size_t vocab_length(vocab_t self) {
   return self ? self->length : 0;
 }
 
+size_t vocab_split(vocab_t self, strlen_s parts[], size_t n) {
+  if (self == NULL || self->_stream != NULL || self->_keywords != NULL || n == 0) {
+    return 0;
+  }
+
+  char* ptr = self->_content.ptr;
+  char* end = ptr + self->_content.len;
+  size_t count = 0;
+  for (size_t i = 1; i <= n && ptr < end; i++) {
+    char* next = i == n ? end : self->_content.ptr + self->_content.len / n * i;
+    if (next < ptr) {
+      next = ptr;
+    }
+    if (next < end) {
+      // move to beginning of next line
+      char* eol = memchr(next, '\n', end - next);
+      next = eol != NULL ? eol + 1 : end;
+    }
+    parts[count++] = (strlen_s){.ptr = ptr, .len = next - ptr};
+    ptr = next;
+  }
+  return count;
+}
+
 // iterator
 bool vocab_reset(vocab_t self) {
   if (self == NULL) {
     return false;
   }
-  stream_rewind(self->_stream);
+  if (self->_stream != NULL) {
+    stream_rewind(self->_stream);
+  } else {
+    self->_cursor = 0;
+  }
   return true;
 }
 
-bool vocab_next_word(vocab_t self, strlen_t keyword, strlen_t extra) {
-  strpos_s keyword_pos, extra_pos;
-  int ch;
-  if (self == NULL) {
+/**
+ * keyword and extra are slices of content, they are not terminated by '\0'.
+ */
+static bool vocab_next_word_in_place(vocab_t self, strlen_t keyword, strlen_t extra) {
+  if (self->_cursor >= self->_content.len) {
     return false;
   }
+
+  char* line = self->_content.ptr + self->_cursor;
+  size_t rest = self->_content.len - self->_cursor;
+  char* eol = memchr(line, '\n', rest);
+  size_t len = eol != NULL ? (size_t)(eol - line) : rest;
+  self->_cursor += eol != NULL ? len + 1 : len;
+
+  if (len > 0 && line[len - 1] == '\r') {  // EOL is '\r\n'
+    len -= 1;
+  }
+
+  char* tab = memchr(line, '\t', len);
+  if (tab != NULL) {
+    *keyword = (strlen_s){.ptr = line, .len = tab - line};
+    *extra = (strlen_s){.ptr = tab + 1, .len = len - (tab + 1 - line)};
+  } else {
+    *keyword = (strlen_s){.ptr = line, .len = len};
+    *extra = strlen_empty;
+  }
+  return true;
+}
+
+static bool vocab_next_word_in_array(vocab_t self, strlen_t keyword, strlen_t extra) {
+  if (self->_cursor >= self->count) {
+    return false;
+  }
+
+  *keyword = self->_keywords[self->_cursor];
+  *extra = self->_extras != NULL ? self->_extras[self->_cursor] : strlen_empty;
+  self->_cursor++;
+  return true;
+}
+
+static bool vocab_next_word_by_stream(vocab_t self, strlen_t keyword, strlen_t extra) {
+  strpos_s keyword_pos, extra_pos;
+  int ch;
   dynabuf_reset(&self->_buf);
   ch = dynabuf_consume_until(&self->_buf, self->_stream, "\n\t", &keyword_pos);
   if (ch == EOF && dynabuf_empty(&self->_buf)) {
@@ -111,3 +301,15 @@ bool vocab_next_word(vocab_t self, strlen_t keyword, strlen_t extra) {
   }
   return true;
 }
+
+bool vocab_next_word(vocab_t self, strlen_t keyword, strlen_t extra) {
+  if (self == NULL) {
+    return false;
+  }
+  if (self->_stream != NULL) {
+    return vocab_next_word_by_stream(self, keyword, extra);
+  } else if (self->_keywords != NULL) {
+    return vocab_next_word_in_array(self, keyword, extra);
+  }
+  return vocab_next_word_in_place(self, keyword, extra);
+}
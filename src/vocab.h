@@ -14,19 +14,38 @@
 extern "C" {
 #endif /* __cplusplus */
 
+/**
+ * vocab - lines of vocabulary are split in place if content is in memory (string,
+ * or mapped file), otherwise they are read from stream through buffer. And words
+ * can be given by array directly.
+ */
 typedef struct vocab {
   stream_t _stream;
   size_t count, length;
 
   dynabuf_s _buf;
+
+  strlen_s _content;
+  size_t _cursor;
+  bool _mapped;
+
+  const strlen_s* _keywords;
+  const strlen_s* _extras;
 } vocab_s, *vocab_t;
 
 vocab_t vocab_construct(stream_type_e type, void* src);
+vocab_t vocab_construct_by_array(const strlen_s* keywords, const strlen_s* extras, size_t n);
 bool vocab_destruct(vocab_t self);
 
 size_t vocab_count(vocab_t self);
 size_t vocab_length(vocab_t self);
 
+/**
+ * vocab_split - split in-place vocabulary into at most n parts at line boundary.
+ * @return count of parts, or 0 if vocabulary is read by stream
+ */
+size_t vocab_split(vocab_t self, strlen_s parts[], size_t n);
+
 // iterator
 bool vocab_reset(vocab_t self);
 bool vocab_next_word(vocab_t self, strlen_t keyword, strlen_t extra);
@@ -4,9 +4,95 @@
  * @author James Yin <ywhjames@hotmail.com>
  */
 #include <matcher.h>
+#include <utf16ctx.h>
+#include <utf8ctx.h>
 #include <utf8helper.h>
 
-int main() {
+#include "../src/charclass.h"
+#include "../src/image.h"
+#include "../src/trie/acdat.h"
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static int failures = 0;
+
+#define EXPECT(cond)                                           \
+  do {                                                         \
+    if (!(cond)) {                                             \
+      printf("%s:%d: expect %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                              \
+    }                                                          \
+  } while (0)
+
+static int match_compare(const void* a, const void* b) {
+  return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+typedef word_t (*next_f)(utf8ctx_t utf8ctx);
+
+/**
+ * match_all_by - matches of content as "so-eo:extra" sorted and joined by ' ', positions are counted in
+ * characters, or in bytes if return_byte_pos.
+ */
+static const char* match_all_by(matcher_t matcher,
+                                const char* content,
+                                size_t len,
+                                bool return_byte_pos,
+                                next_f next) {
+  static char result[1024];
+  char items[32][64];
+  char* sorted[32];
+  size_t count = 0;
+
+  utf8ctx_t context = utf8ctx_alloc_context(matcher);
+  if (context == NULL || !utf8ctx_reset_context(context, (char*)content, (int)len, return_byte_pos)) {
+    utf8ctx_free_context(context);
+    return "<reset failed>";
+  }
+  for (word_t matched = next(context); matched != NULL && count < 32; matched = next(context)) {
+    snprintf(items[count], sizeof(items[count]), "%zu-%zu:%.*s", matched->pos.so, matched->pos.eo,
+             (int)matched->extra.len, matched->extra.ptr);
+    sorted[count] = items[count];
+    count++;
+  }
+  utf8ctx_free_context(context);
+
+  qsort(sorted, count, sizeof(char*), match_compare);
+  result[0] = '\0';
+  for (size_t i = 0; i < count; i++) {
+    if (i > 0) {
+      strcat(result, " ");
+    }
+    strcat(result, sorted[i]);
+  }
+  return result;
+}
+
+static const char* match_all(matcher_t matcher, const char* content, size_t len, bool return_byte_pos) {
+  return match_all_by(matcher, content, len, return_byte_pos, utf8ctx_next);
+}
+
+static matcher_t build_by_lines(const char* dict, matcher_options_t options) {
+  strlen_s string = {.ptr = (char*)dict, .len = strlen(dict)};
+  return matcher_construct_by_string_with_options(&string, options);
+}
+
+#define EXPECT_MATCH_POS(matcher, content, len, return_byte_pos, expected)                 \
+  do {                                                                                     \
+    const char* _result = match_all(matcher, content, len, return_byte_pos);               \
+    if (strcmp(_result, expected) != 0) {                                                  \
+      printf("%s:%d: expect \"%s\", got \"%s\"\n", __FILE__, __LINE__, expected, _result); \
+      failures++;                                                                          \
+    }                                                                                      \
+  } while (0)
+
+#define EXPECT_MATCH(matcher, content, len, expected) EXPECT_MATCH_POS(matcher, content, len, false, expected)
+
+static void demo() {
   char* str = "不(好|会)好";
   strlen_s pattern = {.ptr = str, .len = strlen(str)};
 
@@ -15,9 +101,19 @@ int main() {
   printf("use memory: %zu\n", amalloc_used_memory());
   if (matcher == NULL) {
     printf("build matcher failed!");
-    return -1;
+    failures++;
+    return;
   }
 
+  matcher_stats_s stats;
+  matcher_stats(matcher, &stats);
+  printf("nodes: %zu/%zu (%.2f%%), pad: %zu, values: %zu, failed chain: avg %.2f max %zu, exprs: %zu bytes\n",
+         stats.node_used, stats.node_count, stats.fill_ratio * 100, stats.node_pad, stats.value_count,
+         stats.failed_chain_avg, stats.failed_chain_max, stats.expr_bytes);
+  printf("build memory: %zu bytes, peak: %zu bytes\n", stats.build_memory, stats.build_peak_memory);
+  // peak is sampled after datrie is built too
+  EXPECT(stats.build_memory > 0 && stats.build_peak_memory >= stats.build_memory);
+
   utf8_ctx_t utf8_ctx = alloc_utf8_context();
   context_t context = matcher_alloc_context(matcher);
   matcher_fix_pos(context, fix_utf8_pos, utf8_ctx);
@@ -40,6 +136,690 @@ int main() {
 
   matcher_destruct(matcher);
   printf("use memory: %zu\n", amalloc_used_memory());
+}
+
+static void* keep_newer(void* older, void* newer) {
+  return newer;
+}
+
+/**
+ * dat_match_all - matches of content as "eo:value" sorted and joined by ' '.
+ */
+static const char* dat_match_all(dat_t dat, const char* content) {
+  static char result[1024];
+  char items[64][16];
+  char* sorted[64];
+  size_t count = 0;
+
+  dat_ctx_t ctx = dat_alloc_context(dat);
+  if (ctx == NULL) {
+    return "<alloc failed>";
+  }
+  dat_reset_context(ctx, (char*)content, strlen(content));
+  while (dat_ac_next_on_node(ctx) && count < 64) {
+    snprintf(items[count], sizeof(items[count]), "%zu:%zu", ctx->_read, (size_t)(uintptr_t)dat_matched_value(ctx));
+    sorted[count] = items[count];
+    count++;
+  }
+  dat_free_context(ctx);
+
+  qsort(sorted, count, sizeof(char*), match_compare);
+  size_t w = 0;
+  result[0] = '\0';
+  for (size_t i = 0; i < count; i++) {
+    w += snprintf(result + w, sizeof(result) - w, i == 0 ? "%s" : " %s", sorted[i]);
+  }
+  return result;
+}
+
+/**
+ * test_dat_builder - datrie built from sorted keywords must be the same trie as one built from linked trie.
+ */
+static void test_dat_builder() {
+  const char* keywords[] = {"he", "she", "his", "hers", "a", "ab", "abc", "bc", "c", "中国", "中国人", "国人", "人"};
+  const size_t count = sizeof(keywords) / sizeof(keywords[0]);
+  const char* content = "ushers abcd 我是中国人";
+
+  trie_t trie = trie_alloc();
+  dat_builder_t builder = dat_builder_construct();
+  EXPECT(trie != NULL && builder != NULL);
+  if (trie == NULL || builder == NULL) {
+    trie_free(trie, NULL);
+    dat_builder_destruct(builder, NULL);
+    return;
+  }
+
+  // keywords are added out of order, builder sorts them when sealed
+  for (size_t i = count; i > 0; i--) {
+    void* value = (void*)(uintptr_t)i;
+    trie_add_keyword(trie, keywords[i - 1], strlen(keywords[i - 1]), value);
+    EXPECT(dat_builder_add_keyword(builder, keywords[i - 1], strlen(keywords[i - 1]), value));
+  }
+  trie_sort_to_bfs(trie);
+  size_t trie_nodes = trie->size;
+
+  dat_t by_trie = dat_construct_by_trie(trie, true);
+  dat_t by_builder = dat_construct_by_builder(builder, keep_newer, true);
+  trie_free(trie, NULL);
+  dat_builder_destruct(builder, NULL);
+  EXPECT(by_trie != NULL && by_builder != NULL);
+  if (by_trie == NULL || by_builder == NULL) {
+    dat_destruct(by_trie, NULL);
+    dat_destruct(by_builder, NULL);
+    return;
+  }
+
+  dat_stats_s trie_stats = {0}, builder_stats = {0};
+  dat_stats(by_trie, &trie_stats);
+  dat_stats(by_builder, &builder_stats);
+  EXPECT(trie_stats.node_used == trie_nodes);
+  EXPECT(builder_stats.node_used == trie_stats.node_used);
+  EXPECT(builder_stats.value_count == trie_stats.value_count);
+  EXPECT(builder_stats.failed_chain_max == trie_stats.failed_chain_max);
+  EXPECT(builder_stats.failed_chain_total == trie_stats.failed_chain_total);
+
+  const char* expected = "10:7 10:8 10:9 24:10 27:11 27:12 27:13 4:1 4:2 6:4 8:5 9:6";
+  EXPECT(strcmp(dat_match_all(by_trie, content), expected) == 0);
+  EXPECT(strcmp(dat_match_all(by_builder, content), expected) == 0);
+
+  dat_destruct(by_trie, NULL);
+  dat_destruct(by_builder, NULL);
+}
+
+/**
+ * test_stats - shape of automaton and expressions of a small dictionary, the char automaton takes one node per
+ * character, so "中国" is two levels deep instead of six.
+ */
+static void test_stats() {
+  // keywords: ab abc bc 中国 x y p q r s m n
+  const char* dict = "ab\tA\nabc\tB\nbc\tC\n中国\tD\nx.{0,2}y\tE\np(?&!q)\tF\n(?<!r)s\tG\nm|n\tH\n";
+  const size_t byte_depths[] = {1, 11, 3, 2, 1, 1, 1};
+  const size_t char_depths[] = {1, 11, 3, 1};
+
+  for (int char_automaton = 0; char_automaton <= 1; char_automaton++) {
+    matcher_options_s options = {.char_automaton = char_automaton};
+    matcher_t matcher = build_by_lines(dict, &options);
+    EXPECT(matcher != NULL);
+    if (matcher == NULL) {
+      continue;
+    }
+
+    const size_t* depths = char_automaton ? char_depths : byte_depths;
+    size_t levels = char_automaton ? sizeof(char_depths) / sizeof(size_t) : sizeof(byte_depths) / sizeof(size_t);
+    size_t nodes = 0;
+    for (size_t i = 0; i < levels; i++) {
+      nodes += depths[i];
+    }
+
+    matcher_stats_s stats;
+    matcher_stats(matcher, &stats);
+    EXPECT(stats.node_used == nodes);
+    EXPECT(stats.value_count == 12);
+    EXPECT(stats.fill_ratio > 0 && stats.fill_ratio <= 1);
+    for (size_t i = 0; i < MATCHER_STATS_DEPTH_BUCKETS; i++) {
+      EXPECT(stats.depth_histogram[i] == (i < levels ? depths[i] : 0));
+    }
+    // abc fails to bc, then to root
+    EXPECT(stats.failed_chain_max == 2);
+
+#ifdef EXPR_PASS_FOR_ALTER
+    EXPECT(stats.expr_pass == 1);
+#else
+    EXPECT(stats.expr_pass == 0);
+#endif
+    EXPECT(stats.expr_text == 12);
+    EXPECT(stats.expr_dist == 1);
+    EXPECT(stats.expr_ambi == 1);
+    EXPECT(stats.expr_anto == 1);
+    EXPECT(stats.expr_output == 8);
+
+    matcher_destruct(matcher);
+  }
+}
+
+/**
+ * test_legacy_encoding - trail bytes in ASCII range must not start a match, and positions count characters.
+ */
+static void test_legacy_encoding() {
+  matcher_options_s options = {.bad_as_plain = true, .encoding = MATCHER_ENCODING_GBK};
+  matcher_t matcher = build_by_lines("@a\tat\n0\tzero\na.{0,1}b\tdist\n", &options);
+  EXPECT(matcher != NULL);
+  if (matcher != NULL) {
+    // "丂" is 81 40 in GBK, its trail byte is '@'
+    EXPECT_MATCH(matcher, "\x81\x40" "a", 3, "");
+    EXPECT_MATCH(matcher, "\x81\x40@a", 4, "1-3:at");
+    // 4-byte sequence of GB18030, trail bytes are '0'
+    EXPECT_MATCH(matcher, "\x81\x30\x81\x30", 4, "");
+    EXPECT_MATCH(matcher, "\x81\x30\x81\x30" "0", 5, "1-2:zero");
+    // distance is counted by characters of document
+    EXPECT_MATCH(matcher, "a\x81\x40" "b", 4, "0-3:dist");
+    EXPECT_MATCH(matcher, "a\x81\x40\x81\x40" "b", 6, "");
+    matcher_destruct(matcher);
+  }
+
+  options.encoding = MATCHER_ENCODING_BIG5;
+  matcher = build_by_lines("@\tat\n", &options);
+  EXPECT(matcher != NULL);
+  if (matcher != NULL) {
+    // "一" is A4 40 in Big5
+    EXPECT_MATCH(matcher, "\xA4\x40", 2, "");
+    EXPECT_MATCH(matcher, "\xA4\x40@", 3, "1-2:at");
+    matcher_destruct(matcher);
+  }
+}
+
+/**
+ * test_char_automaton - automaton on characters matches same as automaton on bytes, and it falls back to bytes
+ * if some keyword is not valid UTF-8.
+ */
+static void test_char_automaton() {
+  const char* dict =
+      "中国\tA\n中国人\tB\n国人\tC\nabc\tD\nb\tE\n北京.{0,2}欢迎\tF\n(?<!不)喜欢\tG\n人(?&!人民)\tH\n"
+      "\xc3\xa9t\xc3\xa9\tI\n";
+  const char* texts[] = {
+      "中国人喜欢北京人欢迎abc", "不喜欢中国人民", "国人中国人", "été abcb", "中国\xff中国\xe4人", "", "中",
+  };
+  matcher_options_s options = {.bad_as_plain = true};
+  matcher_t byte_matcher = build_by_lines(dict, &options);
+  options.char_automaton = true;
+  matcher_t char_matcher = build_by_lines(dict, &options);
+  EXPECT(byte_matcher != NULL && char_matcher != NULL);
+  if (byte_matcher == NULL || char_matcher == NULL) {
+    matcher_destruct(byte_matcher);
+    matcher_destruct(char_matcher);
+    return;
+  }
+
+  EXPECT_MATCH(char_matcher, texts[0], strlen(texts[0]), "0-2:A 0-3:B 1-3:C 10-13:D 11-12:E 2-3:H 3-5:G 5-10:F 7-8:H");
+  char expected[1024];
+  for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+    for (int pos = 0; pos < 2; pos++) {
+      snprintf(expected, sizeof(expected), "%s",
+               match_all_by(byte_matcher, texts[i], strlen(texts[i]), pos, utf8ctx_next));
+      EXPECT_MATCH_POS(char_matcher, texts[i], strlen(texts[i]), pos, expected);
+      snprintf(expected, sizeof(expected), "%s",
+               match_all_by(byte_matcher, texts[i], strlen(texts[i]), pos, utf8ctx_next_prefix));
+      const char* result = match_all_by(char_matcher, texts[i], strlen(texts[i]), pos, utf8ctx_next_prefix);
+      if (strcmp(result, expected) != 0) {
+        printf("%s:%d: prefix of \"%s\": expect \"%s\", got \"%s\"\n", __FILE__, __LINE__, texts[i], expected,
+               result);
+        failures++;
+      }
+    }
+  }
+  matcher_destruct(byte_matcher);
+  matcher_destruct(char_matcher);
+
+  // prefix stays broken after output of deferred pattern, "a1" is not prefix of "a国1"
+  for (int automaton = 0; automaton < 2; automaton++) {
+    options.char_automaton = automaton;
+    matcher_t matcher = build_by_lines("a(?&!b)\tA\na1\tB\na国中\tC\n", &options);
+    EXPECT(matcher != NULL);
+    if (matcher != NULL) {
+      const char* result = match_all_by(matcher, "a国1", strlen("a国1"), false, utf8ctx_next_prefix);
+      EXPECT(strcmp(result, "0-1:A") == 0);
+      matcher_destruct(matcher);
+    }
+  }
+
+  // fallback to bytes
+  matcher_t matcher = build_by_lines("\xff\xfe\tX\n中国\tA\n", &options);
+  EXPECT(matcher != NULL);
+  if (matcher != NULL) {
+    EXPECT_MATCH_POS(matcher, "中国\xff\xfe", 8, true, "0-6:A 6-8:X");
+    matcher_destruct(matcher);
+  }
+}
+
+typedef word_t (*utf16_next_f)(utf16ctx_t utf16ctx);
+
+/**
+ * match_all_utf16 - same as match_all_by, positions are counted in units, and "!" marks word whose keyword is
+ * not the units of content between its positions.
+ */
+static const char* match_all_utf16(matcher_t matcher,
+                                   const uint16_t* content,
+                                   size_t len,
+                                   bool cesu,
+                                   utf16_next_f next) {
+  static char result[1024];
+  char items[32][64];
+  char* sorted[32];
+  size_t count = 0;
+
+  utf16ctx_t context = utf16ctx_alloc_context(matcher, cesu);
+  if (context == NULL || !utf16ctx_reset_context(context, content, len)) {
+    utf16ctx_free_context(context);
+    return "<reset failed>";
+  }
+  for (word_t matched = next(context); matched != NULL && count < 32; matched = next(context)) {
+    bool keyword = matched->keyword.len == (matched->pos.eo - matched->pos.so) * sizeof(uint16_t) &&
+                   memcmp(matched->keyword.ptr, content + matched->pos.so, matched->keyword.len) == 0;
+    snprintf(items[count], sizeof(items[count]), "%zu-%zu:%.*s%s", matched->pos.so, matched->pos.eo,
+             (int)matched->extra.len, matched->extra.ptr, keyword ? "" : "!");
+    sorted[count] = items[count];
+    count++;
+  }
+  utf16ctx_free_context(context);
+
+  qsort(sorted, count, sizeof(char*), match_compare);
+  result[0] = '\0';
+  for (size_t i = 0; i < count; i++) {
+    if (i > 0) {
+      strcat(result, " ");
+    }
+    strcat(result, sorted[i]);
+  }
+  return result;
+}
+
+#define EXPECT_MATCH_UTF16(matcher, content, len, cesu, next, expected)                    \
+  do {                                                                                     \
+    const char* _result = match_all_utf16(matcher, content, len, cesu, next);              \
+    if (strcmp(_result, expected) != 0) {                                                  \
+      printf("%s:%d: expect \"%s\", got \"%s\"\n", __FILE__, __LINE__, expected, _result); \
+      failures++;                                                                          \
+    }                                                                                      \
+  } while (0)
+
+/**
+ * test_utf16 - char automaton scans units in place, and it matches same as bytes transcoded from units. surrogate
+ * pair is one character unless cesu, unpaired surrogate is a character of its own.
+ */
+static void test_utf16() {
+  // U+1F601 is D83D DE01, CESU-8 of it is two 3-byte surrogates
+  const char* dict =
+      "\xf0\x9f\x98\x81\tP\n\xed\xa0\xbd\xed\xb8\x81\tQ\n\xed\xa0\xbd\tR\n中国\tA\n国.{0,1}人\tB\n"
+      "\xf0\x9f\x98\x81.{0,1}中\tC\n人\\d{1,2}a\tD\n";
+  const uint16_t texts[][12] = {
+      {'a', 0xD83D, 0xDE01, 0x4E2D, 0x56FD, 0xD83D, 0xDE01, 0x4EBA, '1', '2', 'a', 0},  // pairs
+      {0xD83D, 0x4E2D, 0x56FD, 0xDE01, 0x4EBA, 0xDE01, 0xD83D, 0},                      // unpaired surrogates
+      {0xD83D, 0xDE01, 0xD83D, 0xDE01, 0x4E2D, 0x56FD, 0x4EBA, 0xD83D, 0},
+  };
+  matcher_options_s options = {.bad_as_plain = true};
+  matcher_t byte_matcher = build_by_lines(dict, &options);
+  options.char_automaton = true;
+  matcher_t char_matcher = build_by_lines(dict, &options);
+  EXPECT(byte_matcher != NULL && char_matcher != NULL);
+  if (byte_matcher == NULL || char_matcher == NULL) {
+    matcher_destruct(byte_matcher);
+    matcher_destruct(char_matcher);
+    return;
+  }
+  EXPECT(!matcher_scan_utf16(byte_matcher) && matcher_scan_utf16(char_matcher));
+
+  // pair is one character for distance, and it matches keyword of standard UTF-8 only
+  EXPECT_MATCH_UTF16(char_matcher, texts[0], 11, false, utf16ctx_next, "1-3:P 1-4:C 3-5:A 4-8:B 5-7:P 7-11:D");
+  // pair is two characters, and it matches keyword of CESU-8 only
+  EXPECT_MATCH_UTF16(char_matcher, texts[0], 11, true, utf16ctx_next, "1-2:R 1-3:Q 3-5:A 5-6:R 5-7:Q 7-11:D");
+  // unpaired surrogate takes its unit
+  EXPECT_MATCH_UTF16(char_matcher, texts[1], 7, false, utf16ctx_next, "0-1:R 1-3:A 2-5:B 6-7:R");
+  // slice of array, positions are relative to it
+  EXPECT_MATCH_UTF16(char_matcher, texts[0] + 3, 8, false, utf16ctx_next, "0-2:A 1-5:B 2-4:P 4-8:D");
+  EXPECT_MATCH_UTF16(char_matcher, texts[0] + 2, 2, false, utf16ctx_next, "");
+
+  char expected[1024];
+  for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+    size_t len = 0;
+    while (texts[i][len] != 0) {
+      len++;
+    }
+    for (int cesu = 0; cesu < 2; cesu++) {
+      for (size_t offset = 0; offset < len; offset++) {
+        snprintf(expected, sizeof(expected), "%s",
+                 match_all_utf16(byte_matcher, texts[i] + offset, len - offset, cesu, utf16ctx_next));
+        EXPECT_MATCH_UTF16(char_matcher, texts[i] + offset, len - offset, cesu, utf16ctx_next, expected);
+        snprintf(expected, sizeof(expected), "%s",
+                 match_all_utf16(byte_matcher, texts[i] + offset, len - offset, cesu, utf16ctx_next_prefix));
+        EXPECT_MATCH_UTF16(char_matcher, texts[i] + offset, len - offset, cesu, utf16ctx_next_prefix, expected);
+      }
+    }
+  }
+  matcher_destruct(byte_matcher);
+  matcher_destruct(char_matcher);
+}
+
+static bool charclass_is(const char* spec, const char* members, const char* others) {
+  strlen_s string = {.ptr = (char*)spec, .len = strlen(spec)};
+  charclass_t chars = charclass_construct(&string);
+  if (chars == NULL) {
+    return false;
+  }
+  bool succeed = true;
+  for (const char* c = members; *c != '\0'; c++) {
+    succeed = succeed && charclass_contains(chars, (uint8_t)*c);
+  }
+  for (const char* c = others; *c != '\0'; c++) {
+    succeed = succeed && !charclass_contains(chars, (uint8_t)*c);
+  }
+  charclass_destruct(chars);
+  return succeed;
+}
+
+/**
+ * test_word_boundary - '-' at head or tail of spec is itself, and only sides of keyword that are word characters
+ * are anchored.
+ */
+static void test_word_boundary() {
+  EXPECT(charclass_is("-a-c", "-abc", "d"));
+  EXPECT(charclass_is("a-c-", "-abc", "d"));
+  EXPECT(charclass_is("a-", "-a", "b"));
+  EXPECT(charclass_is("-", "-", "a"));
+  EXPECT(charclass_is("0-9A-Za-z_", "09AZaz_", "-+ "));
+
+  strlen_s spec = {.ptr = "α-ω", .len = strlen("α-ω")};
+  charclass_t chars = charclass_construct(&spec);
+  EXPECT(chars != NULL && charclass_contains(chars, 0x3B2) && !charclass_contains(chars, 0x391));
+  charclass_destruct(chars);
+
+  // reversed range, and invalid UTF-8
+  spec = (strlen_s){.ptr = "z-a", .len = 3};
+  EXPECT(charclass_construct(&spec) == NULL);
+  spec = (strlen_s){.ptr = "\xff", .len = 1};
+  EXPECT(charclass_construct(&spec) == NULL);
+
+  matcher_options_s options = {.bad_as_plain = true, .word_boundary = true};
+  matcher_t matcher = build_by_lines("c++\tC\ncat\tT\n学\tX\n", &options);
+  EXPECT(matcher != NULL);
+  if (matcher != NULL) {
+    EXPECT_MATCH(matcher, "c++11 cats cat", 14, "0-3:C 11-14:T");
+    EXPECT_MATCH(matcher, "xc++ concat", 11, "");
+    // CJK is not word character by default
+    EXPECT_MATCH(matcher, "学习", strlen("学习"), "0-1:X");
+    matcher_destruct(matcher);
+  }
+
+  spec = (strlen_s){.ptr = "z-a", .len = 3};
+  options.word_chars = &spec;
+  matcher = build_by_lines("cat\tT\n", &options);
+  EXPECT(matcher == NULL);
+  matcher_destruct(matcher);
+}
+
+#define NORMALIZE_CHUNK 4096 /* MATCHER_NORMALIZE_CHUNK of matcher.c */
 
+/**
+ * test_normalize - keywords and documents are folded alike, and positions refer to the original document.
+ */
+static void test_normalize() {
+  matcher_options_s options = {.bad_as_plain = true, .normalize = MATCHER_NORMALIZE_CASE | MATCHER_NORMALIZE_WIDTH};
+  matcher_t matcher = build_by_lines("hello\tH\nＡＢ\tW\nx y\tS\n", &options);
+  EXPECT(matcher != NULL);
+  if (matcher != NULL) {
+    EXPECT_MATCH(matcher, "HeLLo ｈＥｌｌＯ", strlen("HeLLo ｈＥｌｌＯ"), "0-5:H 6-11:H");
+    EXPECT_MATCH(matcher, "ab Ａｂ", strlen("ab Ａｂ"), "0-2:W 3-5:W");
+    EXPECT_MATCH(matcher, "X　Y", strlen("X　Y"), "0-3:S");
+    EXPECT_MATCH_POS(matcher, "X　Y", strlen("X　Y"), true, "0-5:S");
+
+    // match crosses chunk of normalized text, 3 bytes of full-width form are folded to 1 byte
+    static char content[3 * NORMALIZE_CHUNK + 16];
+    size_t len = 0;
+    for (size_t i = 0; i < NORMALIZE_CHUNK - 2; i++, len += 3) {
+      memcpy(content + len, "０", 3);
+    }
+    memcpy(content + len, "ＨＥＬＬＯ", 15);
+    len += 15;
+    EXPECT_MATCH(matcher, content, len, "4094-4099:H");
+    EXPECT_MATCH_POS(matcher, content, len, true, "12282-12297:H");
+    matcher_destruct(matcher);
+  }
+
+  // table of one character per side, target is folded too
+  strlen_s table = {.ptr = "國\t国\r\n學\t学\n甲\tA\n", .len = strlen("國\t国\r\n學\t学\n甲\tA\n")};
+  options = (matcher_options_s){.bad_as_plain = true, .normalize = MATCHER_NORMALIZE_CASE, .normalize_table = &table};
+  matcher = build_by_lines("国学\tG\na\tA\n", &options);
+  EXPECT(matcher != NULL);
+  if (matcher != NULL) {
+    EXPECT_MATCH(matcher, "國學 国学 國学", strlen("國學 国学 國学"), "0-2:G 3-5:G 6-8:G");
+    EXPECT_MATCH(matcher, "甲A", strlen("甲A"), "0-1:A 1-2:A");
+    matcher_destruct(matcher);
+  }
+
+  // malformed table
+  const char* malformed[] = {"國国\n", "國\t", "國\t国国\n", "\t国\n", "國 国\n"};
+  for (size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+    table = (strlen_s){.ptr = (char*)malformed[i], .len = strlen(malformed[i])};
+    matcher = build_by_lines("国学\tG\n", &options);
+    if (matcher != NULL) {
+      printf("%s:%d: malformed table \"%s\" is accepted\n", __FILE__, __LINE__, malformed[i]);
+      failures++;
+      matcher_destruct(matcher);
+    }
+  }
+}
+
+/**
+ * test_ignore_chars - ignored characters are dropped from keywords and documents, also after table maps to them.
+ */
+static void test_ignore_chars() {
+  strlen_s ignore = {.ptr = " .-", .len = 3};
+  strlen_s table = {.ptr = "。\t.\n", .len = strlen("。\t.\n")};
+  matcher_options_s options = {.bad_as_plain = true, .ignore_chars = &ignore, .normalize_table = &table};
+  // "--" and "。" are empty after normalization, they are dropped and never match
+  matcher_t matcher = build_by_lines("ab\tE1\n--\tE2\n。\tE3\nc。d\tE4\n", &options);
+  EXPECT(matcher != NULL);
+  if (matcher == NULL) {
+    return;
+  }
+
+  EXPECT_MATCH(matcher, "-- 。", strlen("-- 。"), "");
+  EXPECT_MATCH(matcher, "a b a-.b", 8, "0-3:E1 4-8:E1");
+  // target of table is ignored, so is source
+  EXPECT_MATCH(matcher, "a。b c.d cd", strlen("a。b c.d cd"), "0-3:E1 4-7:E4 8-10:E4");
+  // match starts and ends at characters that are not ignored
+  EXPECT_MATCH(matcher, " -ab- ", 6, "2-4:E1");
+
+  // match crosses chunk of normalized text
+  static char content[3 * NORMALIZE_CHUNK];
+  memset(content, 'x', NORMALIZE_CHUNK - 1);
+  memcpy(content + NORMALIZE_CHUNK - 1, "a          b", 12);
+  EXPECT_MATCH(matcher, content, NORMALIZE_CHUNK + 11, "4095-4107:E1");
+  // ignored characters span more than one chunk
+  content[0] = 'a';
+  memset(content + 1, ' ', 2 * NORMALIZE_CHUNK);
+  content[2 * NORMALIZE_CHUNK + 1] = 'b';
+  EXPECT_MATCH(matcher, content, 2 * NORMALIZE_CHUNK + 2, "0-8194:E1");
+
+  matcher_destruct(matcher);
+}
+
+#ifndef _WIN32
+
+static bool write_file(const char* path, const char* content, size_t len) {
+  FILE* fp = fopen(path, "wb");
+  if (fp == NULL) {
+    return false;
+  }
+  bool succeed = fwrite(content, 1, len, fp) == len;
+  return fclose(fp) == 0 && succeed;
+}
+
+static bool copy_file(const char* from, const char* to) {
+  char buffer[1 << 16];
+  FILE* fp = fopen(from, "rb");
+  if (fp == NULL) {
+    return false;
+  }
+  size_t len = fread(buffer, 1, sizeof(buffer), fp);
+  fclose(fp);
+  return len < sizeof(buffer) && write_file(to, buffer, len);
+}
+
+static size_t read_file(const char* path, char* buffer, size_t len) {
+  FILE* fp = fopen(path, "rb");
+  if (fp == NULL) {
+    return 0;
+  }
+  size_t size = fread(buffer, 1, len, fp);
+  fclose(fp);
+  return size;
+}
+
+/* header of image: magic, version, node_size, key, body_len, checksum */
+#define IMAGE_HEADER_SIZE 40
+#define IMAGE_CHECKSUM_OFFSET 32
+
+/**
+ * reseal_image - checksum of header is computed again, so that a changed body passes it.
+ */
+static void reseal_image(char* image, size_t len) {
+  uint64_t checksum = image_hash(IMAGE_HASH_SEED, image + IMAGE_HEADER_SIZE, len - IMAGE_HEADER_SIZE);
+  memcpy(image + IMAGE_CHECKSUM_OFFSET, &checksum, sizeof(checksum));
+}
+
+/**
+ * find_image - path of the only image in cache_dir, temporary files must be removed or renamed.
+ */
+static bool find_image(const char* cache_dir, char* path, size_t len) {
+  DIR* dir = opendir(cache_dir);
+  if (dir == NULL) {
+    return false;
+  }
+  size_t count = 0;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    snprintf(path, len, "%s/%s", cache_dir, entry->d_name);
+    count++;
+  }
+  closedir(dir);
+  return count == 1 && strstr(path, ".actrie") == path + strlen(path) - strlen(".actrie");
+}
+
+static matcher_t load_cached(const char* path, const char* cache_dir, bool* hit) {
+  matcher_t matcher = matcher_construct_by_file_with_cache(path, cache_dir, false, false, true, true);
+  *hit = matcher != NULL && matcher_loaded_from_image(matcher);
+  return matcher;
+}
+
+/**
+ * test_cache - image is written on miss and loaded on hit with same matches, and image of other dictionary or
+ * broken image is dropped and rebuilt.
+ */
+static void test_cache() {
+  char root[] = "/tmp/test_matcher.XXXXXX";
+  if (mkdtemp(root) == NULL) {
+    EXPECT(!"mkdtemp");
+    return;
+  }
+
+  char dict_a[256], dict_b[256], cache_a[256], cache_b[256], image_a[512], image_b[512];
+  snprintf(dict_a, sizeof(dict_a), "%s/a.txt", root);
+  snprintf(dict_b, sizeof(dict_b), "%s/b.txt", root);
+  snprintf(cache_a, sizeof(cache_a), "%s/cache_a", root);
+  snprintf(cache_b, sizeof(cache_b), "%s/cache_b", root);
+  const char* text = "abc abd 北京人欢迎";
+  const char* dict = "abc\tA\n北京.{0,2}欢迎\tA2\n";
+  EXPECT(write_file(dict_a, dict, strlen(dict)));
+  dict = "abd\tB\n";
+  EXPECT(write_file(dict_b, dict, strlen(dict)));
+  EXPECT(mkdir(cache_a, 0700) == 0 && mkdir(cache_b, 0700) == 0);
+
+  bool hit;
+  char expected[1024];
+
+  // miss, then hit
+  matcher_t matcher = load_cached(dict_a, cache_a, &hit);
+  EXPECT(matcher != NULL && !hit);
+  if (matcher != NULL) {
+    snprintf(expected, sizeof(expected), "%s", match_all(matcher, text, strlen(text), false));
+    EXPECT(strcmp(expected, "0-3:A 8-13:A2") == 0);
+    matcher_destruct(matcher);
+  }
+  EXPECT(find_image(cache_a, image_a, sizeof(image_a)));
+  matcher = load_cached(dict_a, cache_a, &hit);
+  EXPECT(matcher != NULL && hit);
+  if (matcher != NULL) {
+    EXPECT(matcher_build_peak_memory(matcher) == 0);
+    EXPECT_MATCH(matcher, text, strlen(text), expected);
+    matcher_destruct(matcher);
+  }
+
+  // image of dictionary a in place of image of b
+  matcher = load_cached(dict_b, cache_b, &hit);
+  EXPECT(matcher != NULL && !hit);
+  matcher_destruct(matcher);
+  EXPECT(find_image(cache_b, image_b, sizeof(image_b)));
+  EXPECT(copy_file(image_a, image_b));
+  matcher = load_cached(dict_b, cache_b, &hit);
+  EXPECT(matcher != NULL && !hit);
+  if (matcher != NULL) {
+    EXPECT_MATCH(matcher, text, strlen(text), "4-7:B");
+    matcher_destruct(matcher);
+  }
+  matcher = load_cached(dict_b, cache_b, &hit);
+  EXPECT(matcher != NULL && hit);
+  matcher_destruct(matcher);
+
+  // truncated image
+  struct stat st;
+  EXPECT(stat(image_a, &st) == 0 && truncate(image_a, st.st_size / 2) == 0);
+  matcher = load_cached(dict_a, cache_a, &hit);
+  EXPECT(matcher != NULL && !hit);
+  if (matcher != NULL) {
+    EXPECT_MATCH(matcher, text, strlen(text), expected);
+    matcher_destruct(matcher);
+  }
+  EXPECT(find_image(cache_a, image_a, sizeof(image_a)));
+
+  // changed body is dropped by checksum, and loading a resealed one stays in bounds, which is checked by sanitizer
+  static char image[1 << 16], broken[1 << 16];
+  size_t image_len = read_file(image_a, image, sizeof(image));
+  EXPECT(image_len > IMAGE_HEADER_SIZE && image_len < sizeof(image));
+  size_t hits = 0;
+  for (size_t i = IMAGE_HEADER_SIZE; image_len < sizeof(image) && i < image_len; i += i < 1024 ? 1 : 13) {
+    memcpy(broken, image, image_len);
+    broken[i] ^= (i & 1) ? 0x01 : 0xFF;
+    if (i == IMAGE_HEADER_SIZE) {
+      EXPECT(write_file(image_a, broken, image_len));
+      matcher = load_cached(dict_a, cache_a, &hit);
+      EXPECT(matcher != NULL && !hit);
+      matcher_destruct(matcher);
+    }
+    reseal_image(broken, image_len);
+    EXPECT(write_file(image_a, broken, image_len));
+    matcher = load_cached(dict_a, cache_a, &hit);
+    EXPECT(matcher != NULL);
+    if (matcher != NULL) {
+      match_all(matcher, text, strlen(text), false);
+      hits += hit;
+      matcher_destruct(matcher);
+    }
+  }
+  printf("resealed images loaded: %zu\n", hits);
+
+  remove(image_a);
+  remove(image_b);
+  rmdir(cache_a);
+  rmdir(cache_b);
+  remove(dict_a);
+  remove(dict_b);
+  rmdir(root);
+}
+
+#endif
+
+int main() {
+  demo();
+  test_dat_builder();
+  test_stats();
+  test_legacy_encoding();
+  test_char_automaton();
+  test_utf16();
+  test_word_boundary();
+  test_normalize();
+  test_ignore_chars();
+#ifndef _WIN32
+  test_cache();
+#endif
+
+  EXPECT(amalloc_used_memory() == 0);
+  if (failures > 0) {
+    printf("%d failures\n", failures);
+    return 1;
+  }
+  printf("all passed\n");
   return 0;
 }